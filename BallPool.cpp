@@ -0,0 +1,46 @@
+#include <Urho3D/Scene/Node.h>
+#include <Urho3D/Scene/Scene.h>
+
+#include "Ball.h"
+#include "BallPool.h"
+
+using namespace Urho3D;
+
+BallPool::BallPool() :
+	numShown_(0)
+{
+}
+
+void BallPool::Create(Scene* scene, unsigned capacity, float radius)
+{
+	nodes_.Reserve(capacity);
+	for (unsigned i = 0; i < capacity; ++i)
+	{
+		Node* node = scene->CreateChild("PooledBall");
+		node->CreateComponent<Ball>()->SetRadius(radius);
+		node->SetEnabledRecursive(false);
+		nodes_.Push(SharedPtr<Node>(node));
+	}
+	numShown_ = 0;
+}
+
+void BallPool::Update(const float* x, const float* y, unsigned numBalls)
+{
+	numBalls = Min(numBalls, nodes_.Size());
+
+	for (unsigned i = 0; i < numBalls; ++i)
+	{
+		nodes_[i]->SetPosition2D(Vector2(x[i], y[i]));
+	}
+
+	// Only the nodes at the end of the shown range change state.
+	for (unsigned i = numShown_; i < numBalls; ++i)
+	{
+		nodes_[i]->SetEnabledRecursive(true);
+	}
+	for (unsigned i = numBalls; i < numShown_; ++i)
+	{
+		nodes_[i]->SetEnabledRecursive(false);
+	}
+	numShown_ = numBalls;
+}
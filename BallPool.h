@@ -0,0 +1,35 @@
+#pragma once
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D
+{
+	class Node;
+	class Scene;
+}
+
+using namespace Urho3D;
+
+/// Ball nodes for the multi-ball mode, all created up front. Each frame the
+/// first so many are moved to where the simulation's balls are and the rest
+/// are disabled, so balls coming and going never create or destroy a node or
+/// component. Which node shows which ball does not matter, as they all look
+/// the same.
+class BallPool
+{
+public:
+
+	BallPool();
+
+	void Create(Scene* scene, unsigned capacity, float radius);
+	unsigned GetCapacity() const { return nodes_.Size(); }
+	/// Show the given number of balls at these positions.
+	void Update(const float* x, const float* y, unsigned numBalls);
+
+private:
+
+	Vector<SharedPtr<Node> > nodes_;
+	// Nodes enabled by the last update.
+	unsigned numShown_;
+};
@@ -0,0 +1,214 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Graphics/GraphicsEvents.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/Log.h>
+
+#include "FrameProfiler.h"
+
+using namespace Urho3D;
+
+// Frames kept in the ring buffer. The HUD's statistics and the trace are both
+// taken from it.
+const unsigned PROFILER_HISTORY = 1024;
+
+// The trace is written this many frames at a time, well before the ring
+// buffer wraps round.
+const unsigned TRACE_FLUSH_FRAMES = 256;
+
+// Identifies a binary trace, followed by the section count and record size.
+const char TRACE_MAGIC[4] = { 'P', 'F', 'T', '1' };
+
+const char* SECTION_NAMES[NUM_PROFILE_SECTIONS] =
+{
+	"Input",
+	"Simulation",
+	"Events",
+	"Scene",
+	"UI",
+	"Render",
+	"Frame"
+};
+
+FrameProfiler::FrameProfiler(Context* context) : Object(context),
+	numFrames_(0),
+	traceCsv_(false),
+	numFramesTraced_(0)
+{
+	samples_.Resize(PROFILER_HISTORY);
+	scratch_.Resize(PROFILER_HISTORY);
+	memset(&current_, 0, sizeof current_);
+	memset(sectionStart_, 0, sizeof sectionStart_);
+
+	SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(FrameProfiler, HandleBeginFrame));
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(FrameProfiler, HandleEndFrame));
+	SubscribeToEvent(E_BEGINRENDERING, URHO3D_HANDLER(FrameProfiler, HandleBeginRendering));
+	SubscribeToEvent(E_ENDRENDERING, URHO3D_HANDLER(FrameProfiler, HandleEndRendering));
+}
+
+FrameProfiler::~FrameProfiler()
+{
+	CloseTrace();
+}
+
+bool FrameProfiler::OpenTrace(const String& fileName)
+{
+	CloseTrace();
+
+	traceFile_ = new File(context_, fileName, FILE_WRITE);
+	if (!traceFile_->IsOpen())
+	{
+		URHO3D_LOGERROR("Could not open profiler trace " + fileName);
+		traceFile_.Reset();
+		return false;
+	}
+
+	// Only frames from now on are traced.
+	numFramesTraced_ = numFrames_;
+	traceCsv_ = fileName.ToLower().EndsWith(".csv");
+	if (traceCsv_)
+	{
+		String header = "frame";
+		for (int i = 0; i < NUM_PROFILE_SECTIONS; ++i)
+		{
+			header += String(",") + SECTION_NAMES[i];
+		}
+		header += "\n";
+		traceFile_->Write(header.CString(), header.Length());
+	}
+	else
+	{
+		unsigned numSections = NUM_PROFILE_SECTIONS;
+		unsigned recordSize = sizeof(FrameSample);
+		traceFile_->Write(TRACE_MAGIC, sizeof TRACE_MAGIC);
+		traceFile_->WriteUInt(numSections);
+		traceFile_->WriteUInt(recordSize);
+	}
+
+	return true;
+}
+
+void FrameProfiler::CloseTrace()
+{
+	if (!traceFile_)
+	{
+		return;
+	}
+
+	FlushTrace();
+	traceFile_->Close();
+	traceFile_.Reset();
+}
+
+void FrameProfiler::BeginSection(ProfileSection section)
+{
+	sectionStart_[section] = timer_.GetUSec(false);
+}
+
+void FrameProfiler::EndSection(ProfileSection section)
+{
+	current_.time_[section] += (timer_.GetUSec(false) - sectionStart_[section]) / 1000.0f;
+}
+
+unsigned FrameProfiler::GetNumSamples() const
+{
+	return Min(numFrames_, PROFILER_HISTORY);
+}
+
+const FrameSample& FrameProfiler::GetSample(unsigned age) const
+{
+	return samples_[(numFrames_ - 1 - age) % PROFILER_HISTORY];
+}
+
+void FrameProfiler::GetStats(ProfileSection section, unsigned numFrames, SectionStats& stats)
+{
+	unsigned count = Min(numFrames, GetNumSamples());
+	if (!count)
+	{
+		stats.median_ = stats.p99_ = stats.max_ = 0.0f;
+		return;
+	}
+
+	float* times = &scratch_[0];
+	for (unsigned i = 0; i < count; ++i)
+	{
+		times[i] = GetSample(i).time_[section];
+	}
+
+	// The percentiles are picked out in increasing order, so each search only
+	// has to look above the last one.
+	unsigned median = (count - 1) / 2;
+	unsigned p99 = (count - 1) * 99 / 100;
+	std::nth_element(times, times + median, times + count);
+	stats.median_ = times[median];
+	std::nth_element(times + median, times + p99, times + count);
+	stats.p99_ = times[p99];
+	stats.max_ = *std::max_element(times + p99, times + count);
+}
+
+const char* FrameProfiler::GetSectionName(ProfileSection section)
+{
+	return SECTION_NAMES[section];
+}
+
+void FrameProfiler::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+	memset(current_.time_, 0, sizeof current_.time_);
+	current_.frame_ = numFrames_;
+	BeginSection(PROFILE_FRAME);
+}
+
+void FrameProfiler::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	EndSection(PROFILE_FRAME);
+	samples_[numFrames_ % PROFILER_HISTORY] = current_;
+	++numFrames_;
+
+	if (traceFile_ && numFrames_ - numFramesTraced_ >= TRACE_FLUSH_FRAMES)
+	{
+		FlushTrace();
+	}
+}
+
+void FrameProfiler::HandleBeginRendering(StringHash eventType, VariantMap& eventData)
+{
+	BeginSection(PROFILE_RENDER);
+}
+
+void FrameProfiler::HandleEndRendering(StringHash eventType, VariantMap& eventData)
+{
+	EndSection(PROFILE_RENDER);
+}
+
+/// Write the frames completed since the last flush.
+void FrameProfiler::FlushTrace()
+{
+	// Should flushing ever fall behind, frames already overwritten in the
+	// ring buffer are skipped.
+	if (numFrames_ - numFramesTraced_ > PROFILER_HISTORY)
+	{
+		numFramesTraced_ = numFrames_ - PROFILER_HISTORY;
+	}
+
+	for (; numFramesTraced_ < numFrames_; ++numFramesTraced_)
+	{
+		const FrameSample& sample = samples_[numFramesTraced_ % PROFILER_HISTORY];
+		if (!traceCsv_)
+		{
+			traceFile_->Write(&sample, sizeof sample);
+			continue;
+		}
+
+		char line[256];
+		int length = snprintf(line, sizeof line, "%u", sample.frame_);
+		for (int i = 0; i < NUM_PROFILE_SECTIONS; ++i)
+		{
+			length += snprintf(line + length, sizeof line - length, ",%.4f", sample.time_[i]);
+		}
+		line[length++] = '\n';
+		traceFile_->Write(line, (unsigned)length);
+	}
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+#include "PongSim/AllocationTracker.h"
+
+namespace Urho3D
+{
+	class File;
+}
+
+using namespace Urho3D;
+
+/// Parts of a frame that are timed. Contacts are resolved inside the
+/// simulation step, so their cost is part of PROFILE_SIMULATION; reacting to
+/// what the step reported is PROFILE_EVENTS. PROFILE_FRAME is the whole frame.
+enum ProfileSection
+{
+	PROFILE_INPUT = 0,
+	PROFILE_SIMULATION,
+	PROFILE_EVENTS,
+	PROFILE_SCENE,
+	PROFILE_UI,
+	PROFILE_RENDER,
+	PROFILE_FRAME,
+	NUM_PROFILE_SECTIONS
+};
+
+/// Milliseconds spent in each section during one frame.
+struct FrameSample
+{
+	unsigned frame_;
+	float time_[NUM_PROFILE_SECTIONS];
+};
+
+/// One section over a number of recent frames, in milliseconds.
+struct SectionStats
+{
+	float median_;
+	float p99_;
+	float max_;
+};
+
+/// Records per frame section timings into a fixed size ring buffer, and can
+/// stream them to a trace file. Nothing is allocated after construction.
+class FrameProfiler : public Object
+{
+	URHO3D_OBJECT(FrameProfiler, Object);
+
+public:
+
+	FrameProfiler(Context* context);
+	virtual ~FrameProfiler();
+
+	/// Stream every frame's sample to a file. Names ending in .csv are
+	/// written as text, anything else as a header followed by raw
+	/// FrameSample records.
+	bool OpenTrace(const String& fileName);
+	void CloseTrace();
+
+	/// Sections may be entered several times a frame; the times add up.
+	void BeginSection(ProfileSection section);
+	void EndSection(ProfileSection section);
+
+	/// Number of completed frames still held in the ring buffer.
+	unsigned GetNumSamples() const;
+	/// A completed frame's sample, 0 being the most recent.
+	const FrameSample& GetSample(unsigned age) const;
+	/// Statistics of a section over the last numFrames completed frames.
+	void GetStats(ProfileSection section, unsigned numFrames, SectionStats& stats);
+	static const char* GetSectionName(ProfileSection section);
+
+private:
+
+	void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+	void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+	void HandleBeginRendering(StringHash eventType, VariantMap& eventData);
+	void HandleEndRendering(StringHash eventType, VariantMap& eventData);
+	void FlushTrace();
+
+	HiresTimer timer_;
+	long long sectionStart_[NUM_PROFILE_SECTIONS];
+	FrameSample current_;
+	PODVector<FrameSample> samples_;
+	// Completed frames, including those overwritten in the ring buffer.
+	unsigned numFrames_;
+	// Room for sorting a section's times without allocating.
+	PODVector<float> scratch_;
+	SharedPtr<File> traceFile_;
+	bool traceCsv_;
+	// Completed frames already written to the trace.
+	unsigned numFramesTraced_;
+};
+
+/// Times a section for as long as it is in scope, and attributes what it
+/// allocates to the section in builds that track allocations.
+class ProfileScope
+{
+public:
+
+	ProfileScope(FrameProfiler* profiler, ProfileSection section) :
+		profiler_(profiler),
+		section_(section),
+		allocationScope_(FrameProfiler::GetSectionName(section))
+	{
+		profiler_->BeginSection(section_);
+	}
+
+	~ProfileScope()
+	{
+		profiler_->EndSection(section_);
+	}
+
+private:
+
+	FrameProfiler* profiler_;
+	ProfileSection section_;
+	AllocationScope allocationScope_;
+};
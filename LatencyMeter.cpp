@@ -0,0 +1,100 @@
+#include <Urho3D/Core/CoreEvents.h>
+
+#include "LatencyMeter.h"
+
+using namespace Urho3D;
+
+LatencyMeter::LatencyMeter(Context* context) : Object(context),
+	frameStart_(0),
+	totalTicks_(0),
+	totalMilliseconds_(0.0)
+{
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		presses_[i].direction_ = 0;
+		presses_[i].pending_ = false;
+	}
+	stats_.presses_ = 0;
+	stats_.meanTicks_ = 0.0f;
+	stats_.maxTicks_ = 0;
+	stats_.meanMilliseconds_ = 0.0f;
+	stats_.maxMilliseconds_ = 0.0f;
+
+	SubscribeToEvent(E_BEGINFRAME, URHO3D_HANDLER(LatencyMeter, HandleBeginFrame));
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(LatencyMeter, HandleEndFrame));
+}
+
+void LatencyMeter::SetKeys(SimPlayer player, signed char direction, float batY, unsigned tick)
+{
+	Press& press = presses_[player];
+	if (direction == press.direction_)
+	{
+		return;
+	}
+
+	// A press released or reversed before the bat was drawn moving is not
+	// measured.
+	press.direction_ = direction;
+	press.pending_ = direction != 0;
+	press.startY_ = batY;
+	press.startTick_ = tick;
+	press.startTime_ = frameStart_;
+	press.movedTick_ = 0;
+	press.drawn_ = false;
+}
+
+void LatencyMeter::TickStepped(unsigned tick, const float* batY)
+{
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		Press& press = presses_[i];
+		if (press.pending_ && !press.movedTick_ && (batY[i] - press.startY_) * press.direction_ > 0.0f)
+		{
+			press.movedTick_ = tick;
+		}
+	}
+}
+
+void LatencyMeter::BatsDrawn(const float* batY)
+{
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		Press& press = presses_[i];
+		if (press.pending_ && press.movedTick_ && (batY[i] - press.startY_) * press.direction_ > 0.0f)
+		{
+			press.drawn_ = true;
+		}
+	}
+}
+
+void LatencyMeter::HandleBeginFrame(StringHash eventType, VariantMap& eventData)
+{
+	frameStart_ = timer_.GetUSec(false);
+}
+
+/// The frame has been presented, so any press drawn in it is complete.
+void LatencyMeter::HandleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	long long now = timer_.GetUSec(false);
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		Press& press = presses_[i];
+		if (!press.pending_ || !press.drawn_)
+		{
+			continue;
+		}
+
+		unsigned ticks = press.movedTick_ - press.startTick_;
+		float milliseconds = (now - press.startTime_) / 1000.0f;
+		++stats_.presses_;
+		totalTicks_ += ticks;
+		totalMilliseconds_ += milliseconds;
+		stats_.meanTicks_ = (float)((double)totalTicks_ / stats_.presses_);
+		stats_.maxTicks_ = Max(stats_.maxTicks_, ticks);
+		stats_.meanMilliseconds_ = (float)(totalMilliseconds_ / stats_.presses_);
+		stats_.maxMilliseconds_ = Max(stats_.maxMilliseconds_, milliseconds);
+
+		// Holding the key down is not another press.
+		press.pending_ = false;
+	}
+}
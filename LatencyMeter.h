@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Urho3D/Core/Object.h>
+#include <Urho3D/Core/Timer.h>
+
+#include "PongSim/PongSim.h"
+
+using namespace Urho3D;
+
+/// Key press to bat movement latency over every measured press.
+struct LatencyStats
+{
+	unsigned presses_;
+	float meanTicks_;
+	unsigned maxTicks_;
+	float meanMilliseconds_;
+	float maxMilliseconds_;
+};
+
+/// Measures how long a bat key press takes to show as the bat moving. Each
+/// press is timed in ticks, from the last tick before the key was seen to
+/// the tick the bat first moved, and in milliseconds, from the start of the
+/// frame the key was seen in to the end of the frame that first drew the bat
+/// moved. The operating system's own delay before the engine sees the key is
+/// not included. A press the bat never answers, such as against a wall, is
+/// dropped when the key is let go.
+class LatencyMeter : public Object
+{
+	URHO3D_OBJECT(LatencyMeter, Object);
+
+public:
+
+	LatencyMeter(Context* context);
+
+	/// The direction a player's keys ask for this frame, before any tick.
+	void SetKeys(SimPlayer player, signed char direction, float batY, unsigned tick);
+	/// Call after every tick with where the simulation has put the bats.
+	void TickStepped(unsigned tick, const float* batY);
+	/// Call once the scene has been updated with where the bats are drawn.
+	void BatsDrawn(const float* batY);
+	const LatencyStats& GetStats() const { return stats_; }
+
+private:
+
+	struct Press
+	{
+		signed char direction_;
+		// Until the press has been measured or let go.
+		bool pending_;
+		float startY_;
+		unsigned startTick_;
+		long long startTime_;
+		// Zero until the bat moves in the simulation, then the tick it did.
+		unsigned movedTick_;
+		bool drawn_;
+	};
+
+	void HandleBeginFrame(StringHash eventType, VariantMap& eventData);
+	void HandleEndFrame(StringHash eventType, VariantMap& eventData);
+
+	HiresTimer timer_;
+	long long frameStart_;
+	Press presses_[NUM_PLAYERS];
+	LatencyStats stats_;
+	unsigned long long totalTicks_;
+	double totalMilliseconds_;
+};
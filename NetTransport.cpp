@@ -0,0 +1,193 @@
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+typedef SOCKET SocketHandle;
+#else
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SocketHandle;
+#endif
+
+#include "NetTransport.h"
+#include "PongSim/PongSim.h"
+
+// Packets that can be held back at once by the simulated latency.
+const unsigned MAX_DELAYED_PACKETS = 256;
+
+const long long NO_SOCKET = -1;
+
+NetTransport::NetTransport() :
+	socket_(NO_SOCKET),
+	remoteAddressSize_(0),
+	loss_(0.0f),
+	latency_(0),
+	jitter_(0),
+	randomSeed_(1),
+	numDelayed_(0)
+{
+	delayed_.resize(MAX_DELAYED_PACKETS);
+}
+
+NetTransport::~NetTransport()
+{
+	Close();
+}
+
+bool NetTransport::Open(unsigned short localPort, const char* remoteHost, unsigned short remotePort)
+{
+	Close();
+
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data))
+	{
+		return false;
+	}
+#endif
+
+	char port[8];
+	snprintf(port, sizeof port, "%u", remotePort);
+	addrinfo hints;
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo* remote = 0;
+	if (getaddrinfo(remoteHost, port, &hints, &remote) || !remote || remote->ai_addrlen > sizeof remoteAddress_)
+	{
+		if (remote)
+		{
+			freeaddrinfo(remote);
+		}
+		return false;
+	}
+	memcpy(remoteAddress_, remote->ai_addr, remote->ai_addrlen);
+	remoteAddressSize_ = (unsigned)remote->ai_addrlen;
+	freeaddrinfo(remote);
+
+	socket_ = (long long)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (socket_ == NO_SOCKET)
+	{
+		return false;
+	}
+
+	sockaddr_in local;
+	memset(&local, 0, sizeof local);
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(localPort);
+	if (bind((SocketHandle)socket_, (sockaddr*)&local, sizeof local))
+	{
+		Close();
+		return false;
+	}
+
+	// Never block the frame waiting for the peer.
+#ifdef _WIN32
+	u_long nonBlocking = 1;
+	ioctlsocket((SocketHandle)socket_, FIONBIO, &nonBlocking);
+#else
+	fcntl((SocketHandle)socket_, F_SETFL, fcntl((SocketHandle)socket_, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+	return true;
+}
+
+void NetTransport::Close()
+{
+	if (socket_ == NO_SOCKET)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	closesocket((SocketHandle)socket_);
+	WSACleanup();
+#else
+	close((SocketHandle)socket_);
+#endif
+	socket_ = NO_SOCKET;
+	numDelayed_ = 0;
+}
+
+bool NetTransport::IsOpen() const
+{
+	return socket_ != NO_SOCKET;
+}
+
+void NetTransport::SetConditions(float loss, unsigned latency, unsigned jitter)
+{
+	loss_ = loss;
+	latency_ = latency;
+	jitter_ = jitter;
+}
+
+void NetTransport::Send(const void* data, unsigned size, unsigned now)
+{
+	if (size > MAX_PACKET_SIZE)
+	{
+		return;
+	}
+
+	// Random numbers from 0 to 32767.
+	if (loss_ > 0.0f && PongSim::NextRandom(randomSeed_) < loss_ * 32768.0f)
+	{
+		return;
+	}
+
+	if (!latency_ && !jitter_)
+	{
+		SendNow(data, size);
+		return;
+	}
+
+	if (numDelayed_ < delayed_.size())
+	{
+		DelayedPacket& packet = delayed_[numDelayed_++];
+		packet.due_ = now + latency_ + (jitter_ ? PongSim::NextRandom(randomSeed_) % (jitter_ + 1) : 0);
+		packet.size_ = size;
+		memcpy(packet.data_, data, size);
+	}
+}
+
+void NetTransport::Update(unsigned now)
+{
+	for (unsigned i = 0; i < numDelayed_;)
+	{
+		DelayedPacket& packet = delayed_[i];
+		if ((int)(now - packet.due_) >= 0)
+		{
+			SendNow(packet.data_, packet.size_);
+			// Order does not matter, so fill the gap from the end.
+			packet = delayed_[--numDelayed_];
+		}
+		else
+		{
+			++i;
+		}
+	}
+}
+
+unsigned NetTransport::Receive(void* buffer, unsigned size)
+{
+	if (socket_ == NO_SOCKET)
+	{
+		return 0;
+	}
+
+	int received = (int)recvfrom((SocketHandle)socket_, (char*)buffer, (int)size, 0, 0, 0);
+	return received > 0 ? (unsigned)received : 0;
+}
+
+void NetTransport::SendNow(const void* data, unsigned size)
+{
+	if (socket_ != NO_SOCKET)
+	{
+		sendto((SocketHandle)socket_, (const char*)data, (int)size, 0, (const sockaddr*)remoteAddress_, (socklen_t)remoteAddressSize_);
+	}
+}
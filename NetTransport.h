@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vector>
+
+/// Unreliable, unordered datagrams to and from a single peer over UDP, for
+/// the rollback session, which resends until acknowledged, and for playing
+/// on a PongServer, which sends every tick. Outgoing packets can be dropped
+/// and delayed on purpose, to try out bad connections between two instances
+/// on one machine. Times are in milliseconds.
+class NetTransport
+{
+public:
+
+	NetTransport();
+	~NetTransport();
+
+	/// Bind the local port and resolve the peer. Returns false on failure.
+	bool Open(unsigned short localPort, const char* remoteHost, unsigned short remotePort);
+	void Close();
+	bool IsOpen() const;
+
+	/// Drop this fraction of outgoing packets, and hold the rest back for the
+	/// latency plus up to the jitter.
+	void SetConditions(float loss, unsigned latency, unsigned jitter);
+	void Send(const void* data, unsigned size, unsigned now);
+	/// Send held back packets that are now due.
+	void Update(unsigned now);
+	/// Returns the size of the next packet from the peer, or 0 if there is
+	/// none waiting.
+	unsigned Receive(void* buffer, unsigned size);
+
+	static const unsigned MAX_PACKET_SIZE = 512;
+
+private:
+
+	struct DelayedPacket
+	{
+		unsigned due_;
+		unsigned size_;
+		unsigned char data_[MAX_PACKET_SIZE];
+	};
+
+	// A socket handle on every platform fits in this.
+	long long socket_;
+	// sockaddr_storage of the peer, kept opaque here.
+	unsigned char remoteAddress_[128];
+	unsigned remoteAddressSize_;
+	float loss_;
+	unsigned latency_;
+	unsigned jitter_;
+	unsigned randomSeed_;
+	// Held back packets, allocated up front; packets beyond it are dropped.
+	std::vector<DelayedPacket> delayed_;
+	unsigned numDelayed_;
+
+	void SendNow(const void* data, unsigned size);
+};
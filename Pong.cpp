@@ -1,6 +1,8 @@
+#include <cstdio>
 #include <string>
 
 #include <Urho3D/Core/CoreEvents.h>
+#include <Urho3D/Core/ProcessUtils.h>
 #include <Urho3D/Engine/Engine.h>
 #include <Urho3D/Graphics/Camera.h>
 #include <Urho3D/Graphics/Graphics.h>
@@ -9,6 +11,8 @@
 #include <Urho3D/Input/Input.h>
 #include <Urho3D/Input/InputEvents.h> 
 #include <Urho3D/Resource/ResourceCache.h>
+#include <Urho3D/IO/File.h>
+#include <Urho3D/IO/FileSystem.h>
 #include <Urho3D/IO/Log.h>
 #include <Urho3D/UI/UI.h>
 #include <Urho3D/UI/Text.h>
@@ -17,60 +21,781 @@
 #include <Urho3D/Scene/Scene.h>
 #include <Urho3D/Scene/SceneEvents.h>
 #include <Urho3D/Urho2D/Drawable2D.h>
-#include <Urho3D/Urho2D/PhysicsEvents2D.h>
-#include <Urho3D/Urho2D/PhysicsWorld2D.h>
-#include <Urho3D/Urho2D/RigidBody2D.h>
+#include <Urho3D/Urho2D/SpriteSheet2D.h>
+
+#include <SDL/SDL.h>
 
 #include "Ball.h"
 #include "Bat.h"
-#include "EndZone.h"
+#include "FrameProfiler.h"
+#include "LatencyMeter.h"
 #include "Wall.h"
 #include "Pong.h"
+#include "PongSim/BatchSim.h"
+#include "PongSim/MultiBallSim.h"
+#include "PongSim/ProcessStats.h"
+#include "PongSim/RollbackSession.h"
+#include "PongSim/ServerProtocol.h"
+#include "PongSim/SimParamsFile.h"
 
 using namespace Urho3D;
 
-const float BAT_SPEED = 4.0f;
-const float BAT_OFFSET = 4.0f;
+// The arena's layout, as a SimParamsFile resource, unless -arena names
+// another.
+const char DEFAULT_ARENA[] = "Arena.params";
+
+// The camera shows this much more than the arena, leaving room around it for
+// the HUD.
+const float ARENA_VIEW_MARGIN = 1.5f;
+
+// Size of the check run by -verifybatch.
+const unsigned VERIFY_MATCHES = 256;
+const unsigned VERIFY_STEPS = 20000;
+
+// Local play ticks this often a second unless -tickrate or -timestep say
+// otherwise, so that a key press reaches the bat within a few milliseconds
+// whatever the frame rate. Online play keeps the 60 Hz default, as input
+// delay and the rollback window are counted in ticks.
+const float DEFAULT_TICK_RATE = 240.0f;
+
+// Most simulated time stepped in one frame. After a longer stall the
+// simulation falls behind rather than trying to catch up all at once.
+const float MAX_CATCH_UP_TIME = 0.125f;
+
+// Multi-ball mode serves this many balls a tick until they are all in play,
+// so that they stream out of the centre rather than all appearing at once.
+const unsigned MULTI_BALL_SERVES_PER_TICK = 20;
+
+// Online play defaults: frames of input delay, the most frames that can be
+// rolled back, and the seed both peers share unless -seed says otherwise.
+const unsigned DEFAULT_INPUT_DELAY = 2;
+const unsigned DEFAULT_MAX_ROLLBACK = 8;
+const unsigned DEFAULT_NET_SEED = 1;
+
+// Inputs that carry a press of Enter to a server, so that one lost packet
+// does not lose the press.
+const unsigned SERVER_START_SENDS = 4;
+
+// Local play is stepped at 240 Hz, but spectators are sent a quarter of the
+// ticks and draw between them.
+const float BROADCAST_RATE = 60.0f;
+const unsigned MAX_SPECTATORS = 64;
+// A spectator renews its subscription this often, well inside the
+// broadcaster's timeout, so that a few lost renewals do not end it.
+const float SPECTATE_SUBSCRIBE_INTERVAL = 1.0f;
+
+// Frames of a running match -allocationcheck lets pass before counting, for
+// buffers to grow to the sizes they keep.
+const unsigned ALLOCATION_WARM_UP_FRAMES = 120;
+
+// Simulated time each frame of a -soak steps, whatever the frame took, so
+// that matches go by faster than real time.
+const float SOAK_FRAME_TIME = 0.1f;
+// Width of a bin of the soak's frame times, in milliseconds. The last bin
+// takes every frame slower than the rest cover.
+const float SOAK_FRAME_BIN_TIME = 0.01f;
+// Resident memory a soak may end up above its first sample without failing,
+// for the allocator settling and caches filling.
+const unsigned long long SOAK_MEMORY_TOLERANCE = 4 * 1024 * 1024;
+// A soak fails if frames have become this much slower than at its first
+// sample, and by at least the floor in milliseconds, judged by the fastest
+// of its last few samples so that one stall is not taken for drift.
+const float SOAK_FRAME_DRIFT = 1.5f;
+const float SOAK_FRAME_DRIFT_FLOOR = 0.25f;
+const unsigned SOAK_DRIFT_SAMPLES = 3;
+
+// Longest an idle frame sleeps without input, in milliseconds, so that the
+// engine still gets to run now and then.
+const unsigned IDLE_WAKE_INTERVAL = 1000;
+
+// Every piece of text is drawn from the pre-baked distance field font, which
+// scales to any size without rasterizing glyphs again.
+const char HUD_FONT[] = "Fonts/Anonymous Pro.sdf";
+
+// The build packs bin/Data into this LZ4 compressed package next to the
+// executable. One file opened once starts faster than many loose ones.
+const char DATA_PACKAGE[] = "Data.pak";
+
+/// A resource the scene or HUD will need, loaded in the background at
+/// startup so that building them never waits on the disk.
+struct PreloadResource
+{
+	StringHash type_;
+	const char* name_;
+};
+
+// The sprite sheet brings its texture in with it.
+const PreloadResource PRELOAD_RESOURCES[] =
+{
+	{ SpriteSheet2D::GetTypeStatic(), "Urho2D/Sprites.xml" },
+	{ Font::GetTypeStatic(), HUD_FONT }
+};
+
+const char* STARTUP_STAGE_NAMES[NUM_STARTUP_STAGES] =
+{
+	"setup",
+	"engine",
+	"preload",
+	"scene",
+	"first frame"
+};
+
+// The profiler HUD shows statistics over this many frames, refreshed this
+// often in seconds.
+const unsigned PROFILER_HUD_FRAMES = 600;
+const float PROFILER_HUD_REFRESH = 0.5f;
 
-Pong::Pong(Context * context) : Application(context), framecount_(0), time_(0)
+Pong::Pong(Context * context) : Application(context), framecount_(0), time_(0),
+	headless_(false),
+	fixedTimeStep_(1.0f / 60.0f),
+	stepsPerFrame_(1000),
+	matchesToPlay_(100),
+	matchesPlayed_(0),
+	matchesTimedOut_(0),
+	maxMatchTime_(300.0f),
+	simulatedTime_(0.0),
+	batchSize_(0),
+	matchesStarted_(0),
+	batchSim_(0),
+	verifyBatch_(false),
+	timeStepGiven_(false),
+	tickAccumulator_(0.0f),
+	ticks_(0),
+	startPending_(false),
+	matchTelemetry_(telemetry_),
+	arenaFile_(DEFAULT_ARENA),
+	fixedPoint_(false),
+	multiBallCount_(0),
+	multiBallSim_(0),
+	multiBallRunning_(false),
+	netSession_(0),
+	netPort_(0),
+	netPlayer_(PLAYER_ONE),
+	netSeed_(DEFAULT_NET_SEED),
+	inputDelay_(DEFAULT_INPUT_DELAY),
+	maxRollback_(DEFAULT_MAX_ROLLBACK),
+	netLoss_(0.0f),
+	netLatency_(0),
+	netJitter_(0),
+	netGameRunning_(false),
+	serverClient_(false),
+	serverSequence_(0),
+	serverTick_(0),
+	serverUpdates_(0),
+	serverMatch_(0),
+	serverSendTimer_(0.0f),
+	serverStartSends_(0),
+	broadcastPort_(0),
+	broadcastTimer_(0.0f),
+	broadcastEvents_(SIM_EVENT_NONE),
+	spectating_(false),
+	spectateSequence_(0),
+	spectatePackets_(0),
+	spectateSubscribeTimer_(0.0f),
+	allocationCheckFrames_(0),
+	checkedFrames_(0),
+	allocatingFrames_(0),
+	soakMatches_(0),
+	soakInterval_(0),
+	soakFrames_(0),
+	numSoakSamples_(0),
+	idleEnabled_(true),
+	idle_(false),
+	idleFrames_(0),
+	idleStartCpuTime_(0.0),
+	idleTime_(0.0),
+	idleCpuTime_(0.0),
+	showProfiler_(false),
+	profilerRefreshTimer_(0.0f),
+	usePackage_(true)
 {
 	context->RegisterFactory<Ball>();
 	context->RegisterFactory<Bat>();
 	context->RegisterFactory<Wall>();
-	context->RegisterFactory<EndZone>();
-	gameRunning_ = false;
-	SetRandomSeed(Time::GetSystemTime());
+	sim_.SetRandomSeed(Time::GetSystemTime());
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		wins_[i] = 0;
+		aiPlayers_[i] = false;
+	}
+	for (int i = 0; i < NUM_STARTUP_STAGES; ++i)
+	{
+		startupTimes_[i] = 0;
+	}
+	for (unsigned i = 0; i < SOAK_FRAME_BINS; ++i)
+	{
+		soakFrameBins_[i] = 0;
+	}
+}
+
+Pong::~Pong()
+{
+	delete batchSim_;
+	delete multiBallSim_;
+	delete netSession_;
 }
 
 void Pong::Setup()
 {
     engineParameters_["FullScreen"] = false;
 	engineParameters_["WindowTitle"] = "Pong";
+
+	// The engine has already parsed "-headless" into the engine parameters.
+	headless_ = engineParameters_["Headless"].GetBool();
+	ParseArguments();
+
+	// Use the packaged data if the build made it, unless -nopackage asks for
+	// the loose files, e.g. while editing them.
+	FileSystem* fileSystem = GetSubsystem<FileSystem>();
+	if (usePackage_ && fileSystem->FileExists(fileSystem->GetProgramDir() + DATA_PACKAGE))
+	{
+		engineParameters_["ResourcePaths"] = "CoreData";
+		engineParameters_["ResourcePackages"] = DATA_PACKAGE;
+	}
+	MarkStartup(STARTUP_SETUP);
+}
+
+/// Read the Pong specific command line options. Options the engine
+/// understands are ignored here.
+void Pong::ParseArguments()
+{
+	const Vector<String>& arguments = GetArguments();
+
+	for (unsigned i = 0; i < arguments.Size(); ++i)
+	{
+		String argument = arguments[i].ToLower();
+		bool hasValue = i + 1 < arguments.Size();
+
+		if (argument == "-matches" && hasValue)
+		{
+			matchesToPlay_ = Max(ToUInt(arguments[++i]), 1U);
+		}
+		else if (argument == "-timestep" && hasValue)
+		{
+			fixedTimeStep_ = Max(ToFloat(arguments[++i]), 0.0001f);
+			timeStepGiven_ = true;
+		}
+		else if (argument == "-tickrate" && hasValue)
+		{
+			fixedTimeStep_ = 1.0f / Clamp(ToFloat(arguments[++i]), 1.0f, 10000.0f);
+			timeStepGiven_ = true;
+		}
+		else if (argument == "-stepsperframe" && hasValue)
+		{
+			stepsPerFrame_ = Max(ToUInt(arguments[++i]), 1U);
+		}
+		else if (argument == "-maxmatchtime" && hasValue)
+		{
+			maxMatchTime_ = ToFloat(arguments[++i]);
+		}
+		else if (argument == "-batch" && hasValue)
+		{
+			batchSize_ = ToUInt(arguments[++i]);
+		}
+		else if (argument == "-verifybatch")
+		{
+			verifyBatch_ = true;
+		}
+		else if (argument == "-seed" && hasValue)
+		{
+			netSeed_ = ToUInt(arguments[++i]);
+			sim_.SetRandomSeed(netSeed_);
+		}
+		else if (argument == "-netport" && hasValue)
+		{
+			netPort_ = (unsigned short)ToUInt(arguments[++i]);
+		}
+		else if (argument == "-netpeer" && hasValue)
+		{
+			netPeer_ = arguments[++i];
+		}
+		else if (argument == "-netplayer" && hasValue)
+		{
+			netPlayer_ = ToUInt(arguments[++i]) == 2 ? PLAYER_TWO : PLAYER_ONE;
+		}
+		else if (argument == "-server" && hasValue)
+		{
+			serverAddress_ = arguments[++i];
+		}
+		else if (argument == "-broadcast" && hasValue)
+		{
+			broadcastPort_ = (unsigned short)ToUInt(arguments[++i]);
+		}
+		else if (argument == "-spectate" && hasValue)
+		{
+			spectateAddress_ = arguments[++i];
+		}
+		else if (argument == "-inputdelay" && hasValue)
+		{
+			inputDelay_ = ToUInt(arguments[++i]);
+		}
+		else if (argument == "-rollback" && hasValue)
+		{
+			maxRollback_ = Max(ToUInt(arguments[++i]), 1U);
+		}
+		else if (argument == "-netloss" && hasValue)
+		{
+			netLoss_ = Clamp(ToFloat(arguments[++i]), 0.0f, 1.0f);
+		}
+		else if (argument == "-netlatency" && hasValue)
+		{
+			netLatency_ = ToUInt(arguments[++i]);
+		}
+		else if (argument == "-netjitter" && hasValue)
+		{
+			netJitter_ = ToUInt(arguments[++i]);
+		}
+		else if (argument == "-ai" && hasValue)
+		{
+			String players = arguments[++i].ToLower();
+			aiPlayers_[PLAYER_ONE] = players == "one" || players == "1" || players == "both";
+			aiPlayers_[PLAYER_TWO] = players == "two" || players == "2" || players == "both";
+		}
+		else if (argument == "-aireaction" && hasValue)
+		{
+			aiParams_.reactionTime_ = Max(ToFloat(arguments[++i]), 0.0f);
+		}
+		else if (argument == "-ainoise" && hasValue)
+		{
+			aiParams_.noise_ = Max(ToFloat(arguments[++i]), 0.0f);
+		}
+		else if (argument == "-arena" && hasValue)
+		{
+			arenaFile_ = arguments[++i];
+		}
+		else if (argument == "-params" && hasValue)
+		{
+			paramsFile_ = arguments[++i];
+		}
+		else if (argument == "-fixedpoint")
+		{
+			fixedPoint_ = true;
+		}
+		else if (argument == "-balls" && hasValue)
+		{
+			multiBallCount_ = ToUInt(arguments[++i]);
+		}
+		else if (argument == "-record" && hasValue)
+		{
+			recordFile_ = arguments[++i];
+		}
+		else if (argument == "-telemetry" && hasValue)
+		{
+			telemetryFile_ = arguments[++i];
+		}
+		else if (argument == "-replay" && hasValue)
+		{
+			replayFiles_.Push(arguments[++i]);
+		}
+		else if (argument == "-allocationcheck" && hasValue)
+		{
+			allocationCheckFrames_ = Max(ToUInt(arguments[++i]), 1U);
+		}
+		else if (argument == "-soak" && hasValue)
+		{
+			soakMatches_ = Max(ToUInt(arguments[++i]), NUM_SOAK_SAMPLES);
+		}
+		else if (argument == "-noidle")
+		{
+			idleEnabled_ = false;
+		}
+		else if (argument == "-profile")
+		{
+			showProfiler_ = true;
+		}
+		else if (argument == "-trace" && hasValue)
+		{
+			profilerTraceFile_ = arguments[++i];
+		}
+		else if (argument == "-nopackage")
+		{
+			usePackage_ = false;
+		}
+	}
 }
 
 void Pong::Start()
 {
+	MarkStartup(STARTUP_ENGINE);
+
 	// The game of Pong does not begin until Enter is pressed.
-	gameRunning_ = false;
+	sim_.StopGame();
+	if (!SetupSimulation())
+	{
+		ErrorExit("Could not set up the arena");
+		return;
+	}
+	previousState_ = sim_.GetState();
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		ai_[i] = InterceptAi((SimPlayer)i, aiParams_, sim_.GetState().randomSeed_ + i);
+	}
+
+	profiler_ = new FrameProfiler(context_);
+	if (!profilerTraceFile_.Empty())
+	{
+		profiler_->OpenTrace(profilerTraceFile_);
+	}
+	if (!telemetryFile_.Empty() && !telemetry_.Open(telemetryFile_.CString()))
+	{
+		ErrorExit("Could not create " + telemetryFile_);
+		return;
+	}
+	if (allocationCheckFrames_)
+	{
+#ifdef PONG_TRACK_ALLOCATIONS
+		// The computer plays both sides, and restarts each game, so that the
+		// check runs unattended.
+		aiPlayers_[PLAYER_ONE] = true;
+		aiPlayers_[PLAYER_TWO] = true;
+#else
+		ErrorExit("-allocationcheck needs a build with PONG_TRACK_ALLOCATIONS");
+		return;
+#endif
+	}
+	if (soakMatches_)
+	{
+		// The computer plays both sides and restarts each game, and frames are
+		// not held back for the display.
+		aiPlayers_[PLAYER_ONE] = true;
+		aiPlayers_[PLAYER_TWO] = true;
+		engine_->SetMaxFps(0);
+		engine_->SetMaxInactiveFps(0);
+		soakInterval_ = soakMatches_ / NUM_SOAK_SAMPLES;
+	}
+
+	if (!replayFiles_.Empty())
+	{
+		ReplayRecordings();
+		return;
+	}
+
+	if (headless_ && !soakMatches_)
+	{
+		// Run as fast as possible. Without a window the input never has
+		// focus, so the inactive limit has to be lifted too.
+		engine_->SetMaxFps(0);
+		engine_->SetMaxInactiveFps(0);
 
+		if (verifyBatch_)
+		{
+			VerifyBatchKernels();
+			return;
+		}
+
+		// Nothing is rendered, so the simulation is all there is.
+		batchTimer_.Reset();
+		if (batchSize_)
+		{
+			batchSim_ = new BatchSim(batchSize_, sim_.GetParams());
+			for (unsigned i = 0; i < batchSize_; ++i)
+			{
+				batchSim_->SetRandomSeed(i, PongSim::MixSeed(sim_.GetState().randomSeed_, i));
+			}
+			PrintLine(ToString("Stepping %u matches at a time with the %s kernel", batchSize_,
+				BatchSim::GetKernelName(batchSim_->GetKernel())));
+			SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(Pong, HandleBatchUpdate));
+		}
+		else
+		{
+			SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(Pong, HandleHeadlessUpdate));
+		}
+		return;
+	}
+
+	if (!timeStepGiven_ && !netPort_ && serverAddress_.Empty() && spectateAddress_.Empty())
+	{
+		fixedTimeStep_ = 1.0f / DEFAULT_TICK_RATE;
+	}
+	latencyMeter_ = new LatencyMeter(context_);
+
+	// The window is up, so frames are shown while the resources load, and
+	// the game is built once they have.
+	ResourceCache* cache = GetSubsystem<ResourceCache>();
+	for (unsigned i = 0; i < sizeof PRELOAD_RESOURCES / sizeof PRELOAD_RESOURCES[0]; ++i)
+	{
+		cache->BackgroundLoadResource(PRELOAD_RESOURCES[i].type_, PRELOAD_RESOURCES[i].name_);
+	}
+	SubscribeToEvent(E_UPDATE, URHO3D_HANDLER(Pong, HandlePreloadUpdate));
+}
+
+void Pong::HandlePreloadUpdate(StringHash eventType, VariantMap& eventData)
+{
+	if (GetSubsystem<ResourceCache>()->GetNumBackgroundLoadResources())
+	{
+		return;
+	}
+	UnsubscribeFromEvent(E_UPDATE);
+	MarkStartup(STARTUP_PRELOAD);
+	CreateGame();
+}
+
+/// Build the scene and HUD from the preloaded resources, and start whichever
+/// mode of play was asked for.
+void Pong::CreateGame()
+{
+	hudFont_ = GetSubsystem<ResourceCache>()->GetResource<Font>(HUD_FONT);
 	CreateWelcomeText();
+	CreateGameOverText();
+	CreateHudText();
+	CreateProfilerText();
 	CreateScene();
 	SetupViewport();
+
+	if (netPort_)
+	{
+		if (!StartNetSession())
+		{
+			ErrorExit(ToString("Could not open port %u to %s", netPort_, netPeer_.CString()));
+			return;
+		}
+	}
+	else if (!serverAddress_.Empty())
+	{
+		if (!StartServerClient())
+		{
+			ErrorExit("Could not reach the server at " + serverAddress_);
+			return;
+		}
+	}
+	else if (!spectateAddress_.Empty())
+	{
+		if (!StartSpectating())
+		{
+			ErrorExit("Could not reach the broadcast at " + spectateAddress_);
+			return;
+		}
+	}
+	else if (multiBallCount_)
+	{
+		multiBallSim_ = new MultiBallSim(multiBallCount_, sim_.GetParams());
+		multiBallSim_->SetRandomSeed(sim_.GetState().randomSeed_);
+		ballPool_.Create(scene_, multiBallCount_, sim_.GetParams().ballRadius_);
+		UpdateSceneFromSim();
+	}
+	else if (!recordFile_.Empty())
+	{
+		recording_.Begin(sim_, fixedTimeStep_);
+	}
+
+	if (broadcastPort_ && !netPort_ && serverAddress_.Empty() && spectateAddress_.Empty() && !multiBallCount_)
+	{
+		if (!broadcast_.Open(broadcastPort_, MAX_SPECTATORS))
+		{
+			ErrorExit(ToString("Could not open port %u to broadcast on", broadcastPort_));
+			return;
+		}
+		PrintLine(ToString("Broadcasting to spectators on port %u", broadcastPort_));
+	}
 		
     SubscribeToEvent(E_UPDATE,URHO3D_HANDLER(Pong,HandleUpdate));
+
+	MarkStartup(STARTUP_SCENE);
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(Pong, HandleFirstFrame));
+}
+
+/// The first frame with the game in it has been presented.
+void Pong::HandleFirstFrame(StringHash eventType, VariantMap& eventData)
+{
+	SubscribeToEvent(E_ENDFRAME, URHO3D_HANDLER(Pong, HandleIdleEndFrame));
+	MarkStartup(STARTUP_FIRST_FRAME);
+	ReportStartup();
+}
+
+/// An idle frame has been presented, and there is nothing to draw until
+/// something happens, so wait for the next input event rather than starting
+/// another frame straight away. The event is left for Input to handle.
+void Pong::HandleIdleEndFrame(StringHash eventType, VariantMap& eventData)
+{
+	if (idle_)
+	{
+		++idleFrames_;
+		SDL_WaitEventTimeout(0, IDLE_WAKE_INTERVAL);
+	}
+}
+
+/// Local play is idle while no game is running and no key is held. Anything
+/// fed from the network has to keep polling.
+bool Pong::CanIdle(const SimInput& simInput) const
+{
+	if (!idleEnabled_ || netSession_ || serverClient_ || spectating_ || broadcast_.IsOpen() || startPending_ ||
+		soakMatches_)
+	{
+		return false;
+	}
+	if (multiBallSim_ ? multiBallRunning_ : sim_.GetState().gameRunning_)
+	{
+		return false;
+	}
+	return !simInput.batDirection_[PLAYER_ONE] && !simInput.batDirection_[PLAYER_TWO];
+}
+
+void Pong::BeginIdle()
+{
+	idle_ = true;
+	idleTimer_.Reset();
+	idleStartCpuTime_ = GetProcessCpuTime();
+}
+
+void Pong::EndIdle()
+{
+	idle_ = false;
+	idleTime_ += idleTimer_.GetUSec(false) / 1000000.0;
+	idleCpuTime_ += GetProcessCpuTime() - idleStartCpuTime_;
+}
+
+void Pong::MarkStartup(StartupStage stage)
+{
+	startupTimes_[stage] = startupTimer_.GetUSec(false);
+}
+
+/// Print how long each stage of startup took, from the application being
+/// constructed to the first frame of the game being presented.
+void Pong::ReportStartup()
+{
+	String report = "Startup";
+	long long previous = 0;
+	for (int i = 0; i < NUM_STARTUP_STAGES; ++i)
+	{
+		report += ToString(" %s %.1f ms,", STARTUP_STAGE_NAMES[i], (startupTimes_[i] - previous) / 1000.0f);
+		previous = startupTimes_[i];
+	}
+	report += ToString(" total %.1f ms from %s", previous / 1000.0f,
+		GetSubsystem<ResourceCache>()->GetPackageFiles().Empty() ? "loose files" : DATA_PACKAGE);
+	PrintLine(report);
+}
+
+void Pong::Stop()
+{
+	if (headless_ && !verifyBatch_ && replayFiles_.Empty() && !soakMatches_)
+	{
+		ReportBatchResults();
+	}
+
+	if (!recordFile_.Empty() && !headless_ && replayFiles_.Empty() && !netPort_ && !serverClient_ && !spectating_)
+	{
+		recording_.End(sim_);
+		if (recording_.Save(recordFile_.CString()))
+		{
+			PrintLine(ToString("Recorded %u ticks in %u runs to %s", recording_.GetNumTicks(), recording_.GetNumRuns(),
+				recordFile_.CString()));
+		}
+		else
+		{
+			PrintLine("Could not write recording " + recordFile_, true);
+		}
+	}
+
+	if (netSession_)
+	{
+		ReportNetStats();
+	}
+	if (serverClient_)
+	{
+		PrintLine(ToString("Received %u updates of match %u from the server, up to tick %u", serverUpdates_, serverMatch_,
+			serverTick_));
+	}
+	if (broadcast_.IsOpen())
+	{
+		const BroadcastStats& stats = broadcast_.GetStats();
+		PrintLine(ToString("Broadcast %u packets (%u keyframes) to up to %u spectators, %.1f bytes each", stats.packets_,
+			stats.keyframes_, stats.maxSubscribers_, stats.sends_ ? (float)stats.bytes_ / stats.sends_ : 0.0f));
+	}
+	if (spectating_)
+	{
+		PrintLine(ToString("Received %u packets of the broadcast, up to %u, %u waiting for a keyframe", spectatePackets_,
+			spectateSequence_, spectateReader_.GetMissingKeyframes()));
+	}
+
+	if (latencyMeter_ && latencyMeter_->GetStats().presses_)
+	{
+		const LatencyStats& stats = latencyMeter_->GetStats();
+		PrintLine(ToString("Input latency over %u presses at %.0f Hz: %.2f ticks (max %u), %.2f ms (max %.2f)", stats.presses_,
+			1.0f / fixedTimeStep_, stats.meanTicks_, stats.maxTicks_, stats.meanMilliseconds_, stats.maxMilliseconds_));
+	}
+
+	if (allocationCheckFrames_)
+	{
+		unsigned checked = checkedFrames_ > ALLOCATION_WARM_UP_FRAMES ? checkedFrames_ - ALLOCATION_WARM_UP_FRAMES : 0;
+		PrintLine(ToString("Allocation check: %u of %u frames of running matches allocated after warming up, %llu allocations, "
+			"%llu bytes", allocatingFrames_, checked, frameAllocations_.allocations_, frameAllocations_.bytes_));
+		if (allocatingFrames_)
+		{
+			ReportAllocationSites(stdout, 10);
+			exitCode_ = EXIT_FAILURE;
+		}
+	}
+	if (soakMatches_ && !PassedSoak())
+	{
+		exitCode_ = EXIT_FAILURE;
+	}
+
+	if (idle_)
+	{
+		EndIdle();
+	}
+	if (idleTime_ > 0.0)
+	{
+		PrintLine(ToString("Idle for %.1f s over %u frames, %.2f ms of CPU time per idle second", idleTime_, idleFrames_,
+			idleCpuTime_ * 1000.0 / idleTime_));
+	}
+
+	if (telemetry_.IsOpen())
+	{
+		telemetry_.Close();
+		const TelemetryStats& stats = telemetry_.GetStats();
+		PrintLine(ToString("Wrote %u telemetry records (%llu bytes) to %s, %u dropped", stats.written_, stats.bytes_,
+			telemetryFile_.CString(), stats.dropped_));
+	}
+
+	// Write out whatever is left of the trace.
+	if (profiler_)
+	{
+		profiler_->CloseTrace();
+	}
+}
+
+/// Lay the arena out from its description in world units, the same on every
+/// machine and without a window, then apply any parameter file over that.
+bool Pong::SetupSimulation()
+{
+	SimParams params;
+	SharedPtr<File> arena = GetSubsystem<ResourceCache>()->GetFile(arenaFile_);
+	if (!arena)
+	{
+		return false;
+	}
+	std::string text(arena->GetSize(), '\0');
+	if (text.empty() || arena->Read(&text[0], text.size()) != text.size() || !ParseSimParams(text, params))
+	{
+		URHO3D_LOGERROR("Could not read the arena from " + arenaFile_);
+		return false;
+	}
+
+	if (!paramsFile_.Empty() && !LoadSimParams(paramsFile_.CString(), params))
+	{
+		URHO3D_LOGERROR("Could not load parameters from " + paramsFile_);
+		return false;
+	}
+	if (fixedPoint_)
+	{
+		params.fixedPoint_ = true;
+	}
+
+	sim_.SetParams(params);
+	return true;
 }
 
 void Pong::CreateScene()
 {
 	scene_ = new Scene(context_);
 	scene_->CreateComponent<Octree>();
-	scene_->CreateComponent<PhysicsWorld2D>();
 
 	CreateCamera();
 	CreateWalls();
 	CreateBats();
-	CreateEndZones();
 	CreateBall();
+	UpdateSceneFromSim();
 }
 
 void Pong::CreateCamera()
@@ -82,15 +807,26 @@ void Pong::CreateCamera()
 	camera->SetOrthographic(true);
 
 	Graphics* graphics = GetSubsystem<Graphics>();
-	camera->SetOrthoSize((float)graphics->GetHeight() * PIXEL_SIZE);
-	camera->SetZoom(Min((float)graphics->GetWidth() / 1280.0f, (float)graphics->GetHeight() / 800.0f));
+	if (!graphics)
+	{
+		return;
+	}
+
+	// Fit the whole arena in the view, whichever of its width and height is
+	// the tighter fit for the window's shape.
+	const SimParams& params = sim_.GetParams();
+	float arenaWidth = 2.0f * Max(params.wallHalfWidth_, params.endZoneOffset_ + params.endZoneHalfWidth_);
+	float arenaHeight = 2.0f * Max(params.wallOffset_ + params.wallHalfHeight_, params.endZoneHalfHeight_);
+	float aspectRatio = (float)graphics->GetWidth() / (float)graphics->GetHeight();
+	camera->SetOrthoSize(Max(arenaHeight, arenaWidth / aspectRatio) * ARENA_VIEW_MARGIN);
 }
 
 void Pong::CreateWalls()
 {
-	auto wallDimensions = GetSizeFromGraphicsSize(0.9f, 0.02f);
-	CreateWall("BottomWall", Vector2(0.0f, -3.0f), wallDimensions);
-	CreateWall("TopWall", Vector2(0.0f, 3.0f), wallDimensions);
+	const SimParams& params = sim_.GetParams();
+	auto wallDimensions = Vector2(params.wallHalfWidth_, params.wallHalfHeight_) * 2.0f;
+	CreateWall("BottomWall", Vector2(0.0f, -params.wallOffset_), wallDimensions);
+	CreateWall("TopWall", Vector2(0.0f, params.wallOffset_), wallDimensions);
 }
 
 void Pong::CreateWall(String name, Vector2 position, Vector2 dimensions)
@@ -104,9 +840,10 @@ void Pong::CreateWall(String name, Vector2 position, Vector2 dimensions)
 
 void Pong::CreateBats()
 {
-	auto batDimensions = GetSizeFromGraphicsSize(0.012f, 0.1f);
-	playerOneBat_ = CreateBat("PlayerOne", Vector2(-BAT_OFFSET, 0.0f), batDimensions);
-	playerTwoBat_ = CreateBat("PlayerTwo", Vector2(BAT_OFFSET, 0.0f), batDimensions);
+	const SimParams& params = sim_.GetParams();
+	auto batDimensions = Vector2(params.batHalfWidth_, params.batHalfHeight_) * 2.0f;
+	playerOneBat_ = CreateBat("PlayerOne", Vector2(-params.batOffset_, 0.0f), batDimensions);
+	playerTwoBat_ = CreateBat("PlayerTwo", Vector2(params.batOffset_, 0.0f), batDimensions);
 }
 
 Bat* Pong::CreateBat(String name, Vector2 position, Vector2 dimensions)
@@ -120,75 +857,107 @@ Bat* Pong::CreateBat(String name, Vector2 position, Vector2 dimensions)
 	return bat;
 }
 
-void Pong::CreateEndZones()
-{
-	auto endZoneDimensions = GetSizeFromGraphicsSize(0.008f, 0.9f);
-
-	// The end zones should be slightly behind the bats, so that collisions
-	// with the bat don't result in collisions with the end zones.
-	CreateEndZone("PlayerOneEndZone", Vector2(-(BAT_OFFSET + 0.1f), 0.0f), endZoneDimensions);
-	CreateEndZone("PlayerTwoEndZone", Vector2(BAT_OFFSET + 0.1f, 0.0f), endZoneDimensions);
-}
-
-void Pong::CreateEndZone(String name, Vector2 position, Vector2 dimensions)
-{
-	Node* endZoneNode = scene_->CreateChild(name);
-	endZoneNode->SetPosition(position);
-	endZoneNode->SetScale(dimensions * PIXEL_SIZE);
-	endZoneNode->CreateComponent<EndZone>();
-}
-
-Vector2 Pong::GetSizeFromGraphicsSize(float fractionWidth, float fractionHeight)
-{
-	auto graphics = GetSubsystem<Graphics>();
-	float width = fractionWidth * graphics->GetWidth();
-	float height = fractionHeight * graphics->GetHeight();
-	return Vector2(width, height);
-}
-
 void Pong::CreateBall()
 {
 	Node* ballNode = scene_->CreateChild("Ball");
-	ballNode->SetScale2D(Vector2(1.0f, 1.0f));
 	ball_ = ballNode->CreateComponent<Ball>();
-	ball_->game_ = this;
+	ball_->SetRadius(sim_.GetParams().ballRadius_);
 	ballNode->SetEnabledRecursive(false);
 }
 
 void Pong::SetupViewport()
 {
 	Renderer* renderer = GetSubsystem<Renderer>();
+	if (!renderer)
+	{
+		return;
+	}
 	SharedPtr<Viewport> viewport(new Viewport(context_, scene_, cameraNode_->GetComponent<Camera>()));
 	renderer->SetViewport(0, viewport);
 }
 
 void Pong::StartGame()
 {
-	// Clear any text displayed previously.
-	RemoveText();
+	// Hide any text displayed previously.
+	HideText();
 
 	// Move the ball back to the centre and set it moving.
-	ball_->Reset();
-	gameRunning_ = true;
+	sim_.StartGame();
+	if (telemetry_.IsOpen())
+	{
+		matchTelemetry_.Serve(sim_.GetState());
+	}
+}
+
+/// Move the nodes to where the simulation has put the ball and bats, part
+/// way from the last tick's start to its end by how far the frame is into the
+/// next tick. The ball is only interpolated while it stays in play, so that
+/// it is never drawn sliding back to the centre for a serve. Multi-ball mode
+/// interpolates the bats only.
+void Pong::UpdateSceneFromSim()
+{
+	const SimParams& params = sim_.GetParams();
+	float t = Clamp(tickAccumulator_ / fixedTimeStep_, 0.0f, 1.0f);
+	float batY[NUM_PLAYERS];
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		batY[i] = Lerp(previousState_.batY_[i], GetBatY((SimPlayer)i), t);
+	}
+	playerOneBat_->GetNode()->SetPosition2D(Vector2(-params.batOffset_, batY[PLAYER_ONE]));
+	playerTwoBat_->GetNode()->SetPosition2D(Vector2(params.batOffset_, batY[PLAYER_TWO]));
+	latencyMeter_->BatsDrawn(batY);
+
+	if (multiBallSim_)
+	{
+		ballPool_.Update(multiBallSim_->GetBallX(), multiBallSim_->GetBallY(), multiBallSim_->GetNumBalls());
+		return;
+	}
+
+	const SimState& state = sim_.GetState();
+	Vector2 ballPosition(state.ballX_, state.ballY_);
+	if (previousState_.ballActive_ && state.ballActive_)
+	{
+		ballPosition = Vector2(previousState_.ballX_, previousState_.ballY_).Lerp(ballPosition, t);
+	}
+
+	Node* ballNode = ball_->GetNode();
+	ballNode->SetPosition2D(ballPosition);
+	if (ballNode->IsEnabled() != state.ballActive_)
+	{
+		ballNode->SetEnabledRecursive(state.ballActive_);
+	}
+}
+
+float Pong::GetBatY(SimPlayer player) const
+{
+	return multiBallSim_ ? multiBallSim_->GetBatY(player) : sim_.GetState().batY_[player];
 }
 
 void Pong::GameEnd(bool playerOneWon)
 {
-	gameRunning_ = false;
-	String winner = playerOneWon ? "one" : "two";
-	CreateGameOverText(winner);
+	++matchesPlayed_;
+	if (headless_ && !soakMatches_)
+	{
+		return;
+	}
+
+	SimPlayer winner = playerOneWon ? PLAYER_ONE : PLAYER_TWO;
+	++wins_[winner];
+	gameEndText_[winner]->SetVisible(true);
+	newGameText_->SetVisible(true);
 }
 
 bool Pong::GameIsRunning()
 {
-	return gameRunning_;
+	return sim_.GetState().gameRunning_;
 }
 
 void Pong::CreateWelcomeText()
 {
-	ResourceCache* cache = GetSubsystem<ResourceCache>();
-	Font* font = cache->GetResource<Font>("Fonts/Anonymous Pro.ttf");
+	Font* font = hudFont_;
 	Graphics* graphics = GetSubsystem<Graphics>();
+	// A headless soak has no window to lay the text out across.
+	int width = graphics ? graphics->GetWidth() : 0;
 	
 	welcomeText_ = GetSubsystem<UI>()->GetRoot()->CreateChild<Text>();
 	welcomeText_->SetText("PONG");
@@ -206,92 +975,344 @@ void Pong::CreateWelcomeText()
 	auto playerOneText = welcomeText_->CreateChild<Text>();
 	playerOneText->SetText("Player One\nW & S");
 	playerOneText->SetFont(font, 20);
-	playerOneText->SetPosition(IntVector2(-graphics->GetWidth() / 2 + 110, 0));
+	playerOneText->SetPosition(IntVector2(-width / 2 + 110, 0));
 	playerOneText->SetTextAlignment(HA_CENTER);
 	
 	auto playerTwoText = welcomeText_->CreateChild<Text>();
 	playerTwoText->SetText("Player Two\nUp & Down");
 	playerTwoText->SetFont(font, 20);
-	playerTwoText->SetPosition(IntVector2(graphics->GetWidth() / 2 - 80, 0));
+	playerTwoText->SetPosition(IntVector2(width / 2 - 80, 0));
 	playerTwoText->SetTextAlignment(HA_CENTER);
 }
 
-void Pong::CreateGameOverText(String winner)
+void Pong::CreateProfilerText()
+{
+	profilerText_ = GetSubsystem<UI>()->GetRoot()->CreateChild<Text>();
+	profilerText_->SetFont(hudFont_, 12);
+	profilerText_->SetPosition(10, 10);
+	profilerText_->SetVisible(showProfiler_);
+	profilerRefreshTimer_ = PROFILER_HUD_REFRESH;
+}
+
+/// Show the rolling frame timings, if the HUD is visible. Refreshed only now
+/// and then, as setting the text allocates.
+void Pong::UpdateProfilerText(float timeStep)
+{
+	if (!profilerText_->IsVisible())
+	{
+		return;
+	}
+	profilerRefreshTimer_ += timeStep;
+	if (profilerRefreshTimer_ < PROFILER_HUD_REFRESH)
+	{
+		return;
+	}
+	profilerRefreshTimer_ = 0.0f;
+
+	char text[1024];
+	int length = snprintf(text, sizeof text, "Frame %d  %.1fs\n%-10s %7s %7s %7s\n", framecount_, time_, "ms", "p50",
+		"p99", "max");
+	for (int i = 0; i < NUM_PROFILE_SECTIONS; ++i)
+	{
+		SectionStats stats;
+		profiler_->GetStats((ProfileSection)i, PROFILER_HUD_FRAMES, stats);
+		length += snprintf(text + length, sizeof text - length, "%-10s %7.3f %7.3f %7.3f\n",
+			FrameProfiler::GetSectionName((ProfileSection)i), stats.median_, stats.p99_, stats.max_);
+	}
+	const LatencyStats& latency = latencyMeter_->GetStats();
+	snprintf(text + length, sizeof text - length, "Key to bat %.1f ticks %.1f ms (max %.1f) at %.0f Hz\n", latency.meanTicks_,
+		latency.meanMilliseconds_, latency.maxMilliseconds_, 1.0f / fixedTimeStep_);
+	profilerText_->SetText(text);
+}
+
+/// Created once and shown or hidden as games end and start, so that no
+/// element is created or font looked up at the moment of game over.
+void Pong::CreateGameOverText()
 {
-	ResourceCache* cache = GetSubsystem<ResourceCache>();
 	UI* ui = GetSubsystem<UI>();
-	Font* font = cache->GetResource<Font>("Fonts/Anonymous Pro.ttf");
-	String gameEndMessage = "Player " + winner + " wins!";
+	const char* messages[NUM_PLAYERS] = { "Player one wins!", "Player two wins!" };
 
-	gameEndText_ = ui->GetRoot()->CreateChild<Text>();
-	gameEndText_->SetText(gameEndMessage);
-	gameEndText_->SetFont(font, 32);
-	gameEndText_->SetHorizontalAlignment(HA_CENTER);
-	gameEndText_->SetVerticalAlignment(VA_CENTER);
-	gameEndText_->SetTextAlignment(HA_CENTER);
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		gameEndText_[i] = ui->GetRoot()->CreateChild<Text>();
+		gameEndText_[i]->SetText(messages[i]);
+		gameEndText_[i]->SetFont(hudFont_, 32);
+		gameEndText_[i]->SetHorizontalAlignment(HA_CENTER);
+		gameEndText_[i]->SetVerticalAlignment(VA_CENTER);
+		gameEndText_[i]->SetTextAlignment(HA_CENTER);
+		gameEndText_[i]->SetVisible(false);
+	}
 
 	newGameText_ = ui->GetRoot()->CreateChild<Text>();
 	newGameText_->SetText("Press ENTER to start\nESC to exit");
-	newGameText_->SetFont(font, 20);
+	newGameText_->SetFont(hudFont_, 20);
 	newGameText_->SetHorizontalAlignment(HA_CENTER);
 	newGameText_->SetVerticalAlignment(VA_CENTER);
 	newGameText_->SetPosition(0, 100);
 	newGameText_->SetTextAlignment(HA_CENTER);
+	newGameText_->SetVisible(false);
+}
 
+void Pong::HideText()
+{
+	// Headless matches are played without a HUD.
+	if (!welcomeText_)
+	{
+		return;
+	}
+	welcomeText_->SetVisible(false);
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		gameEndText_[i]->SetVisible(false);
+	}
+	newGameText_->SetVisible(false);
 }
 
-void Pong::RemoveText()
+/// The score across the top and the rally and ball speed, or in multi-ball
+/// mode the balls and hits, along the bottom.
+void Pong::CreateHudText()
 {
-	if (welcomeText_)
+	UI* ui = GetSubsystem<UI>();
+
+	scoreText_ = ui->GetRoot()->CreateChild<Text>();
+	scoreText_->SetFont(hudFont_, 40);
+	scoreText_->SetHorizontalAlignment(HA_CENTER);
+	scoreText_->SetPosition(0, 20);
+
+	statsText_ = ui->GetRoot()->CreateChild<Text>();
+	statsText_->SetFont(hudFont_, 16);
+	statsText_->SetHorizontalAlignment(HA_CENTER);
+	statsText_->SetVerticalAlignment(VA_BOTTOM);
+	statsText_->SetPosition(0, -20);
+
+	// Anything that cannot match forces the first update.
+	for (int i = 0; i < NUM_PLAYERS; ++i)
 	{
-		welcomeText_->Remove();
+		shownScore_[i] = M_MAX_UNSIGNED;
 	}
-	if (gameEndText_)
+	for (int i = 0; i < NUM_HUD_STATS; ++i)
 	{
-		gameEndText_->Remove();
+		shownStats_[i] = M_MAX_UNSIGNED;
 	}
-	if (newGameText_)
+}
+
+/// Set the HUD text only when what it shows has changed. The strings are
+/// formatted into stack buffers and copied into members whose capacity is
+/// kept, and a Text reuses its own buffers for text no longer than before,
+/// so after the first few updates nothing is allocated.
+void Pong::UpdateHudText()
+{
+	// In multi-ball mode the score is in points rather than games, and the
+	// line along the bottom counts the balls in play and the bat hits.
+	unsigned score[NUM_PLAYERS];
+	unsigned stats[NUM_HUD_STATS];
+	const char* statsFormat;
+	if (multiBallSim_)
 	{
-		newGameText_->Remove();
+		score[PLAYER_ONE] = multiBallSim_->GetScore(PLAYER_ONE);
+		score[PLAYER_TWO] = multiBallSim_->GetScore(PLAYER_TWO);
+		stats[0] = multiBallSim_->GetNumBalls();
+		stats[1] = multiBallSim_->GetBatHits();
+		statsFormat = "Balls %-5u Hits %-6u";
+	}
+	else
+	{
+		const SimState& state = sim_.GetState();
+		score[PLAYER_ONE] = wins_[PLAYER_ONE];
+		score[PLAYER_TWO] = wins_[PLAYER_TWO];
+		stats[0] = state.rallyLength_;
+		stats[1] = state.ballActive_ ? (unsigned)Vector2(state.ballVelocityX_, state.ballVelocityY_).Length() : 0;
+		statsFormat = "Rally %-4u Speed %-4u";
+	}
+
+	char text[64];
+	if (score[PLAYER_ONE] != shownScore_[PLAYER_ONE] || score[PLAYER_TWO] != shownScore_[PLAYER_TWO])
+	{
+		shownScore_[PLAYER_ONE] = score[PLAYER_ONE];
+		shownScore_[PLAYER_TWO] = score[PLAYER_TWO];
+		snprintf(text, sizeof text, "%u   %u", score[PLAYER_ONE], score[PLAYER_TWO]);
+		scoreString_ = text;
+		scoreText_->SetText(scoreString_);
+	}
+
+	if (stats[0] != shownStats_[0] || stats[1] != shownStats_[1])
+	{
+		shownStats_[0] = stats[0];
+		shownStats_[1] = stats[1];
+		snprintf(text, sizeof text, statsFormat, stats[0], stats[1]);
+		statsString_ = text;
+		statsText_->SetText(statsString_);
 	}
 }
-    
+
 void Pong::HandleUpdate(StringHash eventType,VariantMap& eventData)
 {
+	using namespace Update;
+
+	AllocationCounts frameStart = GetThreadAllocationCounts();
+	float timeStep = soakMatches_ ? SOAK_FRAME_TIME : eventData[P_TIMESTEP].GetFloat();
+	++framecount_;
+	time_ += timeStep;
+
 	Input* input = GetSubsystem<Input>();
+	SimInput simInput;
+	{
+		ProfileScope scope(profiler_, PROFILE_INPUT);
+
+		// Player one input
+		simInput.batDirection_[PLAYER_ONE] = GetBatDirection(KEY_W, KEY_S);
+
+		// Player two input
+		simInput.batDirection_[PLAYER_TWO] = GetBatDirection(KEY_UP, KEY_DOWN);
+
+		// Only bats played from the keyboard are measured.
+		if (netSession_ || serverClient_)
+		{
+			signed char direction = simInput.batDirection_[PLAYER_ONE];
+			latencyMeter_->SetKeys(netPlayer_, direction ? direction : simInput.batDirection_[PLAYER_TWO], GetBatY(netPlayer_),
+				ticks_);
+		}
+		else if (!spectating_)
+		{
+			for (int i = 0; i < NUM_PLAYERS; ++i)
+			{
+				if (!aiPlayers_[i])
+				{
+					latencyMeter_->SetKeys((SimPlayer)i, simInput.batDirection_[i], GetBatY((SimPlayer)i), ticks_);
+				}
+			}
+		}
 
-	// Player one input
-	if (input->GetKeyDown(KEY_W))
+		// Start / restart, on the next tick
+		if (input->GetKeyPress(KEY_RETURN) || ((allocationCheckFrames_ || soakMatches_) && !GameIsRunning()))
+		{
+			startPending_ = true;
+		}
+
+		// Profiler HUD
+		if (input->GetKeyPress(KEY_F2))
+		{
+			profilerText_->SetVisible(!profilerText_->IsVisible());
+			profilerRefreshTimer_ = PROFILER_HUD_REFRESH;
+		}
+	}
+
+	bool waking = false;
+	if (CanIdle(simInput) != idle_)
 	{
-		playerOneBat_->SetVelocity(Vector2::UP * BAT_SPEED);
+		waking = idle_;
+		if (idle_)
+		{
+			EndIdle();
+		}
+		else
+		{
+			BeginIdle();
+		}
 	}
-	else if (input->GetKeyDown(KEY_S))
+
+	unsigned events = SIM_EVENT_NONE;
 	{
-		playerOneBat_->SetVelocity(Vector2::DOWN * BAT_SPEED);
+		ProfileScope scope(profiler_, PROFILE_SIMULATION);
+		if (idle_)
+		{
+			// Nothing moves, so nothing is stepped.
+			tickAccumulator_ = 0.0f;
+		}
+		else if (waking)
+		{
+			// Step the input that woke the game at once, without catching up
+			// on the time spent waiting for it.
+			tickAccumulator_ = fixedTimeStep_;
+		}
+		else
+		{
+			tickAccumulator_ = Min(tickAccumulator_ + timeStep, Max(MAX_CATCH_UP_TIME, fixedTimeStep_));
+		}
+		if (netSession_)
+		{
+			// Either set of keys moves the local player's bat.
+			signed char direction = simInput.batDirection_[PLAYER_ONE];
+			events = StepNetTicks(direction ? direction : simInput.batDirection_[PLAYER_TWO]);
+		}
+		else if (serverClient_)
+		{
+			signed char direction = simInput.batDirection_[PLAYER_ONE];
+			events = StepServerTicks(direction ? direction : simInput.batDirection_[PLAYER_TWO], timeStep);
+		}
+		else if (spectating_)
+		{
+			StepSpectatorTicks(timeStep);
+		}
+		else if (multiBallSim_)
+		{
+			while (tickAccumulator_ >= fixedTimeStep_)
+			{
+				tickAccumulator_ -= fixedTimeStep_;
+				BeginTick();
+				events |= StepMultiBallTick(simInput, startPending_);
+				startPending_ = false;
+				EndTick();
+			}
+		}
+		else
+		{
+			while (tickAccumulator_ >= fixedTimeStep_)
+			{
+				tickAccumulator_ -= fixedTimeStep_;
+				BeginTick();
+				events |= StepTick(simInput, startPending_);
+				startPending_ = false;
+				EndTick();
+			}
+			if (broadcast_.IsOpen())
+			{
+				BroadcastTicks(events, timeStep);
+			}
+		}
 	}
-	else
 	{
-		playerOneBat_->SetVelocity(Vector2::ZERO);
+		ProfileScope scope(profiler_, PROFILE_EVENTS);
+		if (netSession_ || serverClient_ || spectating_)
+		{
+			// A rollback can undo a game's end or start, and a server's update
+			// or a broadcast can be lost, so follow the state rather than the
+			// events.
+			bool running = GameIsRunning();
+			if (running != netGameRunning_)
+			{
+				netGameRunning_ = running;
+				if (running)
+				{
+					HideText();
+				}
+				else if (sim_.GetState().winner_ >= 0)
+				{
+					GameEnd(sim_.GetState().winner_ == PLAYER_ONE);
+				}
+			}
+		}
+		else if (events & SIM_EVENT_GAME_END)
+		{
+			GameEnd(sim_.GetState().winner_ == PLAYER_ONE);
+		}
 	}
-
-	// Player two input
-	if (input->GetKeyDown(KEY_UP))
 	{
-		playerTwoBat_->SetVelocity(Vector2::UP * BAT_SPEED);
+		ProfileScope scope(profiler_, PROFILE_SCENE);
+		UpdateSceneFromSim();
 	}
-	else if (input->GetKeyDown(KEY_DOWN))
 	{
-		playerTwoBat_->SetVelocity(Vector2::DOWN * BAT_SPEED);
+		ProfileScope scope(profiler_, PROFILE_UI);
+		UpdateHudText();
+		UpdateProfilerText(timeStep);
 	}
-	else
+	if (allocationCheckFrames_)
 	{
-		playerTwoBat_->SetVelocity(Vector2::ZERO);
+		CheckFrameAllocations(frameStart);
 	}
-
-	// Start / restart
-	if (input->GetKeyPress(KEY_RETURN) && !gameRunning_)
+	if (soakMatches_)
 	{
-		StartGame();
+		UpdateSoak();
 	}
 
 	// Exit
@@ -301,6 +1322,732 @@ void Pong::HandleUpdate(StringHash eventType,VariantMap& eventData)
 	}
 }
 
+/// Count what the frame allocated if a match was running through it, once
+/// warmed up, and stop once enough frames have been checked. Only this
+/// thread's allocations are counted; the engine's worker threads are its own
+/// business.
+void Pong::CheckFrameAllocations(const AllocationCounts& frameStart)
+{
+	if (!(multiBallSim_ ? multiBallRunning_ : GameIsRunning()))
+	{
+		return;
+	}
+
+	++checkedFrames_;
+	if (checkedFrames_ <= ALLOCATION_WARM_UP_FRAMES)
+	{
+		if (checkedFrames_ == ALLOCATION_WARM_UP_FRAMES)
+		{
+			ClearAllocationSites();
+		}
+		return;
+	}
+
+	AllocationCounts counts = GetThreadAllocationCounts();
+	if (counts.allocations_ != frameStart.allocations_)
+	{
+		++allocatingFrames_;
+		frameAllocations_.allocations_ += counts.allocations_ - frameStart.allocations_;
+		frameAllocations_.bytes_ += counts.bytes_ - frameStart.bytes_;
+	}
+	if (checkedFrames_ >= ALLOCATION_WARM_UP_FRAMES + allocationCheckFrames_)
+	{
+		engine_->Exit();
+	}
+}
+
+/// Give up on a soak's rally that neither computer player is going to miss,
+/// sample the process each time another interval of matches has been
+/// played, and stop once every sample has been taken.
+void Pong::UpdateSoak()
+{
+	if (GameIsRunning() && maxMatchTime_ > 0.0f && sim_.GetState().matchTime_ >= maxMatchTime_)
+	{
+		if (telemetry_.IsOpen())
+		{
+			matchTelemetry_.Abandon(sim_.GetState());
+		}
+		sim_.StopGame();
+		++matchesPlayed_;
+		++matchesTimedOut_;
+	}
+
+	// The last frame the profiler completed, so every frame is counted once.
+	if (profiler_->GetNumSamples())
+	{
+		float frameTime = profiler_->GetSample(0).time_[PROFILE_FRAME];
+		++soakFrameBins_[Min((unsigned)(frameTime / SOAK_FRAME_BIN_TIME), SOAK_FRAME_BINS - 1)];
+		++soakFrames_;
+	}
+	if (matchesPlayed_ < (numSoakSamples_ + 1) * soakInterval_)
+	{
+		return;
+	}
+	SampleSoak();
+	if (numSoakSamples_ == NUM_SOAK_SAMPLES)
+	{
+		engine_->Exit();
+	}
+}
+
+static unsigned CountComponents(const Node* node)
+{
+	unsigned count = node->GetNumComponents();
+	const Vector<SharedPtr<Node> >& children = node->GetChildren();
+	for (unsigned i = 0; i < children.Size(); ++i)
+	{
+		count += CountComponents(children[i]);
+	}
+	return count;
+}
+
+/// The frame time the given percentage of the frames since the last sample
+/// were no slower than, to the middle of its bin.
+float Pong::GetSoakFramePercentile(unsigned percent) const
+{
+	if (!soakFrames_)
+	{
+		return 0.0f;
+	}
+	// Ranked as FrameProfiler::GetStats ranks them.
+	unsigned rank = (soakFrames_ - 1) * percent / 100;
+	unsigned count = 0;
+	unsigned bin = 0;
+	for (; bin < SOAK_FRAME_BINS - 1; ++bin)
+	{
+		count += soakFrameBins_[bin];
+		if (count > rank)
+		{
+			break;
+		}
+	}
+	return (bin + 0.5f) * SOAK_FRAME_BIN_TIME;
+}
+
+void Pong::SampleSoak()
+{
+	SoakSample& sample = soakSamples_[numSoakSamples_++];
+	sample.matches_ = matchesPlayed_;
+	sample.residentBytes_ = GetResidentMemory();
+	sample.nodes_ = scene_->GetNumChildren(true) + 1;
+	sample.components_ = CountComponents(scene_);
+	sample.uiElements_ = GetSubsystem<UI>()->GetRoot()->GetNumChildren(true);
+	sample.frameMedian_ = GetSoakFramePercentile(50);
+	sample.frameP99_ = GetSoakFramePercentile(99);
+	soakFrames_ = 0;
+	for (unsigned i = 0; i < SOAK_FRAME_BINS; ++i)
+	{
+		soakFrameBins_[i] = 0;
+	}
+
+	PrintLine(ToString("Soak %u matches (%u timed out): %.1f MB resident, %u nodes, %u components, %u UI elements, "
+		"frames %.3f ms p50 %.3f ms p99", sample.matches_, matchesTimedOut_, sample.residentBytes_ / (1024.0 * 1024.0),
+		sample.nodes_, sample.components_, sample.uiElements_, sample.frameMedian_, sample.frameP99_));
+}
+
+/// Report a live object count that went above where it started.
+static bool CountHeld(const char* name, unsigned first, unsigned most)
+{
+	if (most > first)
+	{
+		PrintLine(ToString("Soak failed: %s grew from %u to %u", name, first, most), true);
+		return false;
+	}
+	return true;
+}
+
+/// Report frames that have become slower since the first sample.
+static bool FrameTimeHeld(const char* name, float first, float last)
+{
+	if (last > first * SOAK_FRAME_DRIFT && last - first > SOAK_FRAME_DRIFT_FLOOR)
+	{
+		PrintLine(ToString("Soak failed: %s frame time drifted from %.3f ms to %.3f ms", name, first, last), true);
+		return false;
+	}
+	return true;
+}
+
+/// Compare every sample with the first, taken once the first interval has
+/// warmed the game up. Live objects must never outnumber the first sample.
+/// Resident memory fails if it ends up well above it, or if it rose at every
+/// sample, as a leak does however slowly; allocator noise comes and goes.
+bool Pong::PassedSoak()
+{
+	if (numSoakSamples_ < NUM_SOAK_SAMPLES)
+	{
+		PrintLine(ToString("Soak stopped after %u of %u samples", numSoakSamples_, NUM_SOAK_SAMPLES), true);
+		return false;
+	}
+
+	const SoakSample& first = soakSamples_[0];
+	const SoakSample& last = soakSamples_[numSoakSamples_ - 1];
+	SoakSample most = first;
+	bool rising = true;
+	for (unsigned i = 1; i < numSoakSamples_; ++i)
+	{
+		const SoakSample& sample = soakSamples_[i];
+		most.nodes_ = Max(most.nodes_, sample.nodes_);
+		most.components_ = Max(most.components_, sample.components_);
+		most.uiElements_ = Max(most.uiElements_, sample.uiElements_);
+		rising = rising && sample.residentBytes_ > soakSamples_[i - 1].residentBytes_;
+	}
+	float frameMedian = last.frameMedian_;
+	float frameP99 = last.frameP99_;
+	for (unsigned i = numSoakSamples_ - SOAK_DRIFT_SAMPLES; i < numSoakSamples_; ++i)
+	{
+		frameMedian = Min(frameMedian, soakSamples_[i].frameMedian_);
+		frameP99 = Min(frameP99, soakSamples_[i].frameP99_);
+	}
+
+	bool passed = CountHeld("scene nodes", first.nodes_, most.nodes_);
+	passed = CountHeld("components", first.components_, most.components_) && passed;
+	passed = CountHeld("UI elements", first.uiElements_, most.uiElements_) && passed;
+	if (rising || last.residentBytes_ > first.residentBytes_ + SOAK_MEMORY_TOLERANCE)
+	{
+		PrintLine(ToString("Soak failed: resident memory grew from %.1f MB to %.1f MB%s",
+			first.residentBytes_ / (1024.0 * 1024.0), last.residentBytes_ / (1024.0 * 1024.0),
+			rising ? ", rising at every sample" : ""), true);
+		passed = false;
+	}
+	passed = FrameTimeHeld("median", first.frameMedian_, frameMedian) && passed;
+	passed = FrameTimeHeld("99th percentile", first.frameP99_, frameP99) && passed;
+
+	if (passed)
+	{
+		PrintLine(ToString("Soak passed over %u matches: %+.1f MB resident, frames %.3f to %.3f ms p50, %.3f to %.3f ms p99",
+			last.matches_ - first.matches_, ((double)last.residentBytes_ - (double)first.residentBytes_) / (1024.0 * 1024.0),
+			first.frameMedian_, frameMedian, first.frameP99_, frameP99));
+	}
+	return passed;
+}
+
+/// Keep the state a tick starts from, for drawing between ticks.
+void Pong::BeginTick()
+{
+	previousState_ = sim_.GetState();
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		previousState_.batY_[i] = GetBatY((SimPlayer)i);
+	}
+}
+
+void Pong::EndTick()
+{
+	++ticks_;
+	float batY[NUM_PLAYERS] = { GetBatY(PLAYER_ONE), GetBatY(PLAYER_TWO) };
+	latencyMeter_->TickStepped(ticks_, batY);
+}
+
+/// Step the simulation by one fixed tick, starting a game first if one was
+/// asked for and none is running, and record the tick if recording.
+unsigned Pong::StepTick(const SimInput& simInput, bool startPressed)
+{
+	bool startGame = startPressed && !GameIsRunning();
+	unsigned serveDirection = sim_.GetNextServeDirection();
+	if (startGame)
+	{
+		StartGame();
+	}
+
+	// Computer players see the state the step starts from, and are recorded
+	// as if their moves were keys.
+	SimInput tickInput = simInput;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		if (aiPlayers_[i])
+		{
+			tickInput.batDirection_[i] = ai_[i].Update(sim_, fixedTimeStep_);
+		}
+	}
+
+	if (!recordFile_.Empty())
+	{
+		recording_.AddTick(tickInput, startGame, serveDirection);
+	}
+
+	unsigned events = sim_.Step(fixedTimeStep_, tickInput);
+	if (telemetry_.IsOpen())
+	{
+		matchTelemetry_.Step(sim_.GetState(), events);
+	}
+	return events;
+}
+
+/// The intercepting AI if it plays this side, otherwise simple tracking.
+signed char Pong::GetComputerDirection(SimPlayer player)
+{
+	return aiPlayers_[player] ? ai_[player].Update(sim_, fixedTimeStep_) : sim_.TrackBall(player);
+}
+
+/// Starting clears the arena and the score; the balls are then served a few
+/// at a time and every ball scored is served again, for as long as the mode
+/// runs.
+unsigned Pong::StepMultiBallTick(const SimInput& simInput, bool startPressed)
+{
+	if (startPressed)
+	{
+		HideText();
+		multiBallSim_->Reset();
+		multiBallRunning_ = true;
+	}
+
+	if (multiBallRunning_)
+	{
+		for (unsigned i = 0; i < MULTI_BALL_SERVES_PER_TICK && multiBallSim_->Serve(); ++i)
+		{
+		}
+	}
+
+	return multiBallSim_->Step(fixedTimeStep_, simInput);
+}
+
+bool Pong::StartNetSession()
+{
+	String host = "127.0.0.1";
+	unsigned short port = netPort_;
+	Vector<String> peer = netPeer_.Split(':');
+	if (peer.Size() == 2)
+	{
+		host = peer[0];
+		port = (unsigned short)ToUInt(peer[1]);
+	}
+	else if (peer.Size() == 1)
+	{
+		port = (unsigned short)ToUInt(peer[0]);
+	}
+
+	if (!netTransport_.Open(netPort_, host.CString(), port))
+	{
+		return false;
+	}
+	netTransport_.SetConditions(netLoss_, netLatency_, netJitter_);
+
+	netSession_ = new RollbackSession(sim_, netSeed_, netPlayer_, inputDelay_, maxRollback_, fixedTimeStep_);
+	PrintLine(ToString("Playing as player %s on port %u against %s:%u, %u frames input delay, up to %u rolled back",
+		netPlayer_ == PLAYER_ONE ? "one" : "two", netPort_, host.CString(), port, inputDelay_, maxRollback_));
+	return true;
+}
+
+/// Take in the peer's packets, step as many ticks as have elapsed and the
+/// rollback window allows, and send the peer all the input it has not yet
+/// acknowledged. When the peer falls too far behind, ticks wait for it.
+unsigned Pong::StepNetTicks(signed char batDirection)
+{
+	unsigned now = Time::GetSystemTime();
+	unsigned char packet[NetTransport::MAX_PACKET_SIZE];
+	unsigned size;
+	while ((size = netTransport_.Receive(packet, sizeof packet)) > 0)
+	{
+		netSession_->ReadPacket(packet, size);
+	}
+
+	unsigned events = SIM_EVENT_NONE;
+	while (tickAccumulator_ >= fixedTimeStep_ && netSession_->CanAdvance())
+	{
+		tickAccumulator_ -= fixedTimeStep_;
+		BeginTick();
+		netSession_->AddLocalInput(batDirection, startPending_);
+		startPending_ = false;
+		events |= netSession_->AdvanceFrame();
+		EndTick();
+	}
+
+	size = netSession_->WritePacket(packet, sizeof packet);
+	netTransport_.Send(packet, size, now);
+	netTransport_.Update(now);
+	return events;
+}
+
+bool Pong::StartServerClient()
+{
+	String host = "127.0.0.1";
+	unsigned short port = DEFAULT_SERVER_PORT;
+	Vector<String> address = serverAddress_.Split(':');
+	if (address.Size() >= 1)
+	{
+		host = address[0];
+	}
+	if (address.Size() == 2)
+	{
+		port = (unsigned short)ToUInt(address[1]);
+	}
+
+	// Any local port will do; the server answers whichever one it hears from.
+	if (!netTransport_.Open(0, host.CString(), port))
+	{
+		return false;
+	}
+	netTransport_.SetConditions(netLoss_, netLatency_, netJitter_);
+	serverClient_ = true;
+	PrintLine(ToString("Joining the server at %s:%u", host.CString(), port));
+	return true;
+}
+
+/// Take the newest state the server has sent, and send it the input once per
+/// tick. The state is drawn between the last two updates received.
+unsigned Pong::StepServerTicks(signed char batDirection, float timeStep)
+{
+	unsigned now = Time::GetSystemTime();
+	unsigned char packet[NetTransport::MAX_PACKET_SIZE];
+	unsigned size;
+	while ((size = netTransport_.Receive(packet, sizeof packet)) > 0)
+	{
+		ServerUpdate update;
+		if (!ReadServerUpdate(packet, size, update))
+		{
+			continue;
+		}
+		// Updates can arrive out of order; only newer ones are drawn.
+		if (serverUpdates_ && update.match_ == serverMatch_ && (int)(update.tick_ - serverTick_) <= 0)
+		{
+			continue;
+		}
+
+		BeginTick();
+		sim_.GetState() = update.state_;
+		netPlayer_ = (SimPlayer)update.player_;
+		serverMatch_ = update.match_;
+		serverTick_ = update.tick_;
+		++serverUpdates_;
+		tickAccumulator_ = 0.0f;
+		EndTick();
+	}
+	tickAccumulator_ = Min(tickAccumulator_, fixedTimeStep_);
+
+	if (startPending_)
+	{
+		serverStartSends_ = SERVER_START_SENDS;
+		startPending_ = false;
+	}
+
+	serverSendTimer_ += timeStep;
+	if (serverSendTimer_ >= fixedTimeStep_)
+	{
+		serverSendTimer_ = Min(serverSendTimer_ - fixedTimeStep_, fixedTimeStep_);
+		ServerInput input;
+		input.sequence_ = ++serverSequence_;
+		input.batDirection_ = batDirection;
+		input.start_ = serverStartSends_ > 0;
+		if (serverStartSends_)
+		{
+			--serverStartSends_;
+		}
+		size = WriteServerInput(packet, input);
+		netTransport_.Send(packet, size, now);
+	}
+	netTransport_.Update(now);
+
+	// What happened is seen in the state, as with rollback.
+	return SIM_EVENT_NONE;
+}
+
+/// Send spectators the state at the broadcast rate, with everything that
+/// happened since the last one.
+void Pong::BroadcastTicks(unsigned events, float timeStep)
+{
+	unsigned now = Time::GetSystemTime();
+	broadcast_.Update(now);
+	broadcastEvents_ |= events;
+	broadcastTimer_ += timeStep;
+	if (broadcastTimer_ < 1.0f / BROADCAST_RATE)
+	{
+		return;
+	}
+	broadcastTimer_ = Min(broadcastTimer_ - 1.0f / BROADCAST_RATE, 1.0f / BROADCAST_RATE);
+
+	SpectatorState state;
+	state.FromSimState(sim_.GetState(), broadcastEvents_);
+	broadcast_.Publish(state, now);
+	broadcastEvents_ = SIM_EVENT_NONE;
+}
+
+bool Pong::StartSpectating()
+{
+	String host = "127.0.0.1";
+	unsigned short port = DEFAULT_SPECTATOR_PORT;
+	Vector<String> address = spectateAddress_.Split(':');
+	if (address.Size() >= 1)
+	{
+		host = address[0];
+	}
+	if (address.Size() == 2)
+	{
+		port = (unsigned short)ToUInt(address[1]);
+	}
+
+	if (!netTransport_.Open(0, host.CString(), port))
+	{
+		return false;
+	}
+	netTransport_.SetConditions(netLoss_, netLatency_, netJitter_);
+	spectating_ = true;
+	// Subscribe on the first frame.
+	spectateSubscribeTimer_ = SPECTATE_SUBSCRIBE_INTERVAL;
+	PrintLine(ToString("Watching the broadcast at %s:%u", host.CString(), port));
+	return true;
+}
+
+/// Take the newest state broadcast, and keep the subscription alive.
+void Pong::StepSpectatorTicks(float timeStep)
+{
+	unsigned now = Time::GetSystemTime();
+	unsigned char packet[NetTransport::MAX_PACKET_SIZE];
+	unsigned size;
+	while ((size = netTransport_.Receive(packet, sizeof packet)) > 0)
+	{
+		SpectatorState state;
+		unsigned sequence;
+		unsigned sendTime;
+		if (!spectateReader_.Read(packet, size, state, sequence, sendTime))
+		{
+			continue;
+		}
+		++spectatePackets_;
+		if (spectatePackets_ > 1 && (int)(sequence - spectateSequence_) <= 0)
+		{
+			continue;
+		}
+
+		BeginTick();
+		state.ToSimState(sim_.GetState());
+		spectateSequence_ = sequence;
+		tickAccumulator_ = 0.0f;
+		EndTick();
+	}
+	tickAccumulator_ = Min(tickAccumulator_, fixedTimeStep_);
+
+	spectateSubscribeTimer_ += timeStep;
+	if (spectateSubscribeTimer_ >= SPECTATE_SUBSCRIBE_INTERVAL)
+	{
+		spectateSubscribeTimer_ = 0.0f;
+		size = WriteSpectatorSubscribe(packet);
+		netTransport_.Send(packet, size, now);
+	}
+	netTransport_.Update(now);
+}
+
+void Pong::ReportNetStats()
+{
+	const RollbackStats& stats = netSession_->GetStats();
+	PrintLine(ToString("%d frames, %u rollbacks re-simulating %u frames (at most %u at once), %u packets rejected",
+		netSession_->GetFrame(), stats.rollbacks_, stats.resimulatedFrames_, stats.maxRollbackFrames_, stats.rejectedPackets_));
+}
+
+signed char Pong::GetBatDirection(int upKey, int downKey)
+{
+	Input* input = GetSubsystem<Input>();
+
+	if (input->GetKeyDown(upKey))
+	{
+		return 1;
+	}
+	else if (input->GetKeyDown(downKey))
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/// Play matches back to back, stepping the simulation with a fixed time step,
+/// until the requested number of matches has been played.
+void Pong::HandleHeadlessUpdate(StringHash eventType, VariantMap& eventData)
+{
+	AllocationCounts frameStart = GetThreadAllocationCounts();
+	ProfileScope scope(profiler_, PROFILE_SIMULATION);
+
+	for (unsigned i = 0; i < stepsPerFrame_; ++i)
+	{
+		if (matchesPlayed_ >= matchesToPlay_)
+		{
+			engine_->Exit();
+			return;
+		}
+
+		if (!GameIsRunning())
+		{
+			StartGame();
+		}
+
+		SimInput simInput;
+		simInput.batDirection_[PLAYER_ONE] = GetComputerDirection(PLAYER_ONE);
+		simInput.batDirection_[PLAYER_TWO] = GetComputerDirection(PLAYER_TWO);
+
+		unsigned events = sim_.Step(fixedTimeStep_, simInput);
+		simulatedTime_ += fixedTimeStep_;
+		if (telemetry_.IsOpen())
+		{
+			matchTelemetry_.Step(sim_.GetState(), events);
+		}
+
+		if (events & SIM_EVENT_GAME_END)
+		{
+			GameEnd(sim_.GetState().winner_ == PLAYER_ONE);
+		}
+		else if (maxMatchTime_ > 0.0f && sim_.GetState().matchTime_ >= maxMatchTime_)
+		{
+			// Give up on a rally that neither bat is ever going to miss.
+			if (telemetry_.IsOpen())
+			{
+				matchTelemetry_.Abandon(sim_.GetState());
+			}
+			sim_.StopGame();
+			++matchesPlayed_;
+			++matchesTimedOut_;
+		}
+	}
+
+	if (allocationCheckFrames_)
+	{
+		CheckFrameAllocations(frameStart);
+	}
+}
+
+/// Play matches with the batch simulation, restarting each match's lane as
+/// soon as it ends until the requested number of matches has been started.
+void Pong::HandleBatchUpdate(StringHash eventType, VariantMap& eventData)
+{
+	ProfileScope scope(profiler_, PROFILE_SIMULATION);
+
+	for (unsigned i = 0; i < stepsPerFrame_; ++i)
+	{
+		if (matchesPlayed_ >= matchesToPlay_)
+		{
+			engine_->Exit();
+			return;
+		}
+
+		unsigned runningMatches = 0;
+		for (unsigned match = 0; match < batchSize_; ++match)
+		{
+			if (!batchSim_->IsRunning(match) && matchesStarted_ < matchesToPlay_)
+			{
+				batchSim_->StartGame(match);
+				++matchesStarted_;
+			}
+			if (batchSim_->IsRunning(match))
+			{
+				++runningMatches;
+			}
+		}
+
+		TrackBallInBatch();
+		batchSim_->Step(fixedTimeStep_);
+		simulatedTime_ += fixedTimeStep_ * runningMatches;
+
+		for (unsigned match = 0; match < batchSize_; ++match)
+		{
+			if (batchSim_->GetEvents(match) & SIM_EVENT_GAME_END)
+			{
+				++matchesPlayed_;
+			}
+			else if (batchSim_->IsRunning(match) && maxMatchTime_ > 0.0f && batchSim_->GetMatchTime(match) >= maxMatchTime_)
+			{
+				batchSim_->StopGame(match);
+				++matchesPlayed_;
+				++matchesTimedOut_;
+			}
+		}
+	}
+}
+
+/// Same as PongSim::TrackBall, for every match in the batch.
+void Pong::TrackBallInBatch()
+{
+	const float* ballY = batchSim_->GetBallY();
+
+	for (int player = 0; player < NUM_PLAYERS; ++player)
+	{
+		const float* batY = batchSim_->GetBatY((SimPlayer)player);
+		float* directions = batchSim_->GetBatDirections((SimPlayer)player);
+
+		for (unsigned match = 0; match < batchSize_; ++match)
+		{
+			directions[match] = ballY[match] > batY[match] + TRACKING_DEAD_ZONE ? 1.0f :
+				(ballY[match] < batY[match] - TRACKING_DEAD_ZONE ? -1.0f : 0.0f);
+		}
+	}
+}
+
+/// Check that every batch kernel this CPU supports reproduces the scalar
+/// simulation exactly, and exit with an error if any does not.
+void Pong::VerifyBatchKernels()
+{
+	for (int kernel = KERNEL_SCALAR; kernel < NUM_KERNELS; ++kernel)
+	{
+		PrintLine(ToString("%s kernel: %s", BatchSim::GetKernelName((SimKernel)kernel),
+			BatchSim::IsKernelSupported((SimKernel)kernel) ? "supported" : "not supported"));
+	}
+
+	unsigned mismatches = BatchSim::CompareKernels(VERIFY_MATCHES, VERIFY_STEPS, fixedTimeStep_, sim_.GetState().randomSeed_);
+	if (mismatches)
+	{
+		ErrorExit(ToString("Batch kernels differ from the scalar simulation in %u match steps", mismatches));
+		return;
+	}
+
+	PrintLine("Batch kernels match the scalar simulation bit for bit");
+	engine_->Exit();
+}
+
+/// Play every recording given with -replay back as fast as possible, and
+/// check each ends in the state it was recorded ending in.
+void Pong::ReplayRecordings()
+{
+	unsigned failures = 0;
+	HiresTimer timer;
+
+	for (unsigned i = 0; i < replayFiles_.Size(); ++i)
+	{
+		const String& fileName = replayFiles_[i];
+		InputRecording recording;
+		if (!recording.Load(fileName.CString()))
+		{
+			PrintLine("Could not read recording " + fileName, true);
+			++failures;
+			continue;
+		}
+
+		ReplayResult result = recording.Replay();
+		if (result.Succeeded())
+		{
+			PrintLine(ToString("%s: %u ticks, state hash %08x matches", fileName.CString(), result.ticks_, result.stateHash_));
+			continue;
+		}
+
+		++failures;
+		if (result.firstBadServe_ < result.ticks_)
+		{
+			PrintLine(ToString("%s: serve differs at tick %u", fileName.CString(), result.firstBadServe_), true);
+		}
+		else
+		{
+			PrintLine(ToString("%s: final state hash %08x differs", fileName.CString(), result.stateHash_), true);
+		}
+	}
+
+	double elapsed = timer.GetUSec(false) / 1000000.0;
+	if (failures)
+	{
+		ErrorExit(ToString("%u of %u recordings did not replay exactly", failures, replayFiles_.Size()));
+		return;
+	}
+
+	PrintLine(ToString("Replayed %u recordings in %.3f s", replayFiles_.Size(), elapsed));
+	engine_->Exit();
+}
+
+void Pong::ReportBatchResults()
+{
+	double elapsed = batchTimer_.GetUSec(false) / 1000000.0;
+	if (elapsed <= 0.0)
+	{
+		return;
+	}
+
+	PrintLine(ToString("Played %u matches (%u timed out) in %.3f s", matchesPlayed_, matchesTimedOut_, elapsed));
+	PrintLine(ToString("%.1f matches/s, %.1f simulated s/s", matchesPlayed_ / elapsed, simulatedTime_ / elapsed));
+}
+
 void Pong::HandleClosePressed(StringHash eventType, VariantMap& eventData)
 {
 	engine_->Exit();
@@ -1,11 +1,22 @@
 #pragma once
 
+#include <Urho3D/Core/Timer.h>
 #include <Urho3D/Engine/Application.h>
 
+#include "BallPool.h"
+#include "NetTransport.h"
+#include "PongSim/AllocationTracker.h"
+#include "PongSim/InputRecording.h"
+#include "PongSim/InterceptAi.h"
+#include "PongSim/PongSim.h"
+#include "PongSim/SpectatorBroadcast.h"
+#include "PongSim/Telemetry.h"
+
 namespace Urho3D
 {
 	class Application;
 	class Button;
+	class Font;
 	class Node;
 	class Scene;
 	class Text;
@@ -15,15 +26,47 @@ using namespace Urho3D;
 
 class Ball;
 class Bat;
-class EndZone;
+class BatchSim;
+class FrameProfiler;
+class LatencyMeter;
+class MultiBallSim;
+class RollbackSession;
+
+/// The stages of startup, each timed up to its end.
+enum StartupStage
+{
+	STARTUP_SETUP = 0,
+	STARTUP_ENGINE,
+	STARTUP_PRELOAD,
+	STARTUP_SCENE,
+	STARTUP_FIRST_FRAME,
+	NUM_STARTUP_STAGES
+};
+
+/// The process as -soak sampled it after a number of matches.
+struct SoakSample
+{
+	unsigned matches_;
+	unsigned long long residentBytes_;
+	// Live objects, which should be back to the same numbers at the end of
+	// every match.
+	unsigned nodes_;
+	unsigned components_;
+	unsigned uiElements_;
+	// Whole frames since the last sample, in milliseconds.
+	float frameMedian_;
+	float frameP99_;
+};
 
 class Pong : public Application
 {
 public:
 
 	Pong(Context * context);
+	virtual ~Pong();
 	virtual void Setup();
 	virtual void Start();
+	virtual void Stop();
 	void GameEnd(bool playerOneWon);
 	bool GameIsRunning();
 
@@ -38,28 +81,224 @@ private:
 	SharedPtr<Bat> playerOneBat_;
 	SharedPtr<Bat> playerTwoBat_;
 	SharedPtr<Ball> ball_;
-	SharedPtr<Text> gameEndText_;
+	// Retained HUD, created once and updated in place.
+	SharedPtr<Font> hudFont_;
+	SharedPtr<Text> gameEndText_[NUM_PLAYERS];
 	SharedPtr<Text> newGameText_;
 	SharedPtr<Text> welcomeText_;
-	bool gameRunning_;
+	SharedPtr<Text> scoreText_;
+	SharedPtr<Text> statsText_;
+	String scoreString_;
+	String statsString_;
+	// Games won this session, and what the HUD last showed.
+	unsigned wins_[NUM_PLAYERS];
+	unsigned shownScore_[NUM_PLAYERS];
+	static const int NUM_HUD_STATS = 2;
+	unsigned shownStats_[NUM_HUD_STATS];
+
+	// Gameplay state lives in the simulation; the scene only renders it.
+	PongSim sim_;
+
+	// Headless batch mode. The simulation is stepped with a fixed time step,
+	// both bats are driven automatically and no scene is created.
+	bool headless_;
+	float fixedTimeStep_;
+	unsigned stepsPerFrame_;
+	unsigned matchesToPlay_;
+	unsigned matchesPlayed_;
+	unsigned matchesTimedOut_;
+	float maxMatchTime_;
+	double simulatedTime_;
+	HiresTimer batchTimer_;
+	// When non-zero, headless matches are played this many at a time with
+	// the vectorised batch simulation.
+	unsigned batchSize_;
+	unsigned matchesStarted_;
+	BatchSim* batchSim_;
+	bool verifyBatch_;
+
+	// Interactive play is stepped in fixed ticks of fixedTimeStep_, so that
+	// a recording of its input replays exactly, and drawn between the last
+	// two ticks. Local play ticks at a high rate unless told otherwise.
+	bool timeStepGiven_;
+	float tickAccumulator_;
+	unsigned ticks_;
+	SimState previousState_;
+	SharedPtr<LatencyMeter> latencyMeter_;
+	bool startPending_;
+	InputRecording recording_;
+	String recordFile_;
+	Vector<String> replayFiles_;
+	// Serves, bounces and results of local and headless matches, written to
+	// the file given by -telemetry.
+	String telemetryFile_;
+	TelemetryWriter telemetry_;
+	MatchTelemetry matchTelemetry_;
+
+	// Computer players, chosen by -ai. In headless mode the other bats track
+	// the ball.
+	bool aiPlayers_[NUM_PLAYERS];
+	AiParams aiParams_;
+	InterceptAi ai_[NUM_PLAYERS];
+
+	// The arena resource, and gameplay constants loaded over it from -params,
+	// such as those written by PongFarm's tuner.
+	String arenaFile_;
+	String paramsFile_;
+	// Forces the deterministic fixed point simulation, which both peers of
+	// an online match must agree on.
+	bool fixedPoint_;
+
+	// Any number of balls at once, enabled by -balls. Local play only.
+	unsigned multiBallCount_;
+	MultiBallSim* multiBallSim_;
+	BallPool ballPool_;
+	bool multiBallRunning_;
+
+	// Online play against one peer, with rollback. Enabled by -netport.
+	RollbackSession* netSession_;
+	NetTransport netTransport_;
+	unsigned short netPort_;
+	String netPeer_;
+	SimPlayer netPlayer_;
+	unsigned netSeed_;
+	unsigned inputDelay_;
+	unsigned maxRollback_;
+	float netLoss_;
+	unsigned netLatency_;
+	unsigned netJitter_;
+	bool netGameRunning_;
+
+	// Playing a match hosted by a PongServer, enabled by -server. The server
+	// runs the simulation; this only sends input and draws what it is sent.
+	String serverAddress_;
+	bool serverClient_;
+	unsigned serverSequence_;
+	unsigned serverTick_;
+	unsigned serverUpdates_;
+	unsigned short serverMatch_;
+	float serverSendTimer_;
+	// Inputs still to be sent with the start flag, in case some are lost.
+	unsigned serverStartSends_;
+
+	// Local play streamed to spectators on the port given by -broadcast,
+	// with the events of the ticks between broadcasts gathered up.
+	unsigned short broadcastPort_;
+	SpectatorBroadcast broadcast_;
+	float broadcastTimer_;
+	unsigned broadcastEvents_;
+
+	// Watching a broadcast, enabled by -spectate. Nothing is simulated; the
+	// state is drawn between the last two received.
+	String spectateAddress_;
+	bool spectating_;
+	StateStreamReader spectateReader_;
+	unsigned spectateSequence_;
+	unsigned spectatePackets_;
+	float spectateSubscribeTimer_;
+
+	// Frames of running matches checked for allocations by -allocationcheck
+	// once warmed up, and what those that allocated made between them.
+	unsigned allocationCheckFrames_;
+	unsigned checkedFrames_;
+	unsigned allocatingFrames_;
+	AllocationCounts frameAllocations_;
+
+	// A soak test, enabled by -soak: the computer plays both sides of this
+	// many matches back to back through the whole game, scene and HUD
+	// included, with or without a window. The process is sampled every
+	// soakInterval_ matches and fails on exit if it grew or slowed down.
+	static const unsigned NUM_SOAK_SAMPLES = 20;
+	unsigned soakMatches_;
+	unsigned soakInterval_;
+	// Every frame's time since the last sample, binned, as the profiler only
+	// keeps the most recent frames.
+	static const unsigned SOAK_FRAME_BINS = 5000;
+	unsigned soakFrames_;
+	unsigned soakFrameBins_[SOAK_FRAME_BINS];
+	SoakSample soakSamples_[NUM_SOAK_SAMPLES];
+	unsigned numSoakSamples_;
+
+	// Local play sleeps on the welcome and game over screens until there is
+	// input, unless -noidle is given. The time and CPU time spent idle are
+	// reported on exit.
+	bool idleEnabled_;
+	bool idle_;
+	unsigned idleFrames_;
+	HiresTimer idleTimer_;
+	double idleStartCpuTime_;
+	double idleTime_;
+	double idleCpuTime_;
+
+	// Per frame timings, shown on the HUD and optionally traced to a file.
+	SharedPtr<FrameProfiler> profiler_;
+	SharedPtr<Text> profilerText_;
+	bool showProfiler_;
+	String profilerTraceFile_;
+	float profilerRefreshTimer_;
+
+	// Startup reads the packaged data unless -nopackage is given, and is
+	// timed from construction to the first frame of the game.
+	bool usePackage_;
+	HiresTimer startupTimer_;
+	long long startupTimes_[NUM_STARTUP_STAGES];
 
+	void ParseArguments();
+	void HandlePreloadUpdate(StringHash eventType, VariantMap & eventData);
+	void CreateGame();
+	void HandleFirstFrame(StringHash eventType, VariantMap & eventData);
+	void HandleIdleEndFrame(StringHash eventType, VariantMap & eventData);
+	bool CanIdle(const SimInput& simInput) const;
+	void BeginIdle();
+	void EndIdle();
+	void MarkStartup(StartupStage stage);
+	void ReportStartup();
+	bool SetupSimulation();
 	void CreateScene();
 	void CreateBall();
 	void CreateWalls();
 	void CreateWall(String name, Vector2 position, Vector2 dimensions);
 	void CreateBats();
 	Bat* CreateBat(String name, Vector2 position, Vector2 dimensions);
-	void CreateEndZones();
-	void CreateEndZone(String name, Vector2 position, Vector2 dimensions);
-	Vector2 GetSizeFromGraphicsSize(float fractionWidth, float fractionHeight);
 	void CreateCamera();
 	void CreateWelcomeText();
+	void CreateProfilerText();
+	void UpdateProfilerText(float timeStep);
 	void SetupViewport();
 	void StartGame();
-	void CreateGameOverText(String winner);
-	void RemoveText();
+	void UpdateSceneFromSim();
+	float GetBatY(SimPlayer player) const;
+	void CreateGameOverText();
+	void HideText();
+	void CreateHudText();
+	void UpdateHudText();
 	void CreateInstructions();
 	void HandleClosePressed(StringHash eventType, VariantMap & eventData);
 	void HandleUpdate(StringHash eventType, VariantMap & eventData);
+	void HandleHeadlessUpdate(StringHash eventType, VariantMap & eventData);
+	void HandleBatchUpdate(StringHash eventType, VariantMap & eventData);
+	void TrackBallInBatch();
+	void VerifyBatchKernels();
+	void ReplayRecordings();
+	void BeginTick();
+	void EndTick();
+	unsigned StepTick(const SimInput& simInput, bool startPressed);
+	signed char GetComputerDirection(SimPlayer player);
+	unsigned StepMultiBallTick(const SimInput& simInput, bool startPressed);
+	bool StartNetSession();
+	unsigned StepNetTicks(signed char batDirection);
+	void ReportNetStats();
+	bool StartServerClient();
+	unsigned StepServerTicks(signed char batDirection, float timeStep);
+	void BroadcastTicks(unsigned events, float timeStep);
+	bool StartSpectating();
+	void StepSpectatorTicks(float timeStep);
+	signed char GetBatDirection(int upKey, int downKey);
+	void ReportBatchResults();
+	void CheckFrameAllocations(const AllocationCounts& frameStart);
+	void UpdateSoak();
+	float GetSoakFramePercentile(unsigned percent) const;
+	void SampleSoak();
+	bool PassedSoak();
 	void HandlePostRenderUpdate(StringHash eventType, VariantMap & eventData);
 };
\ No newline at end of file
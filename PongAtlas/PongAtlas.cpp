@@ -0,0 +1,202 @@
+#include <cstdio>
+#include <cstdlib>
+
+#include <Urho3D/Core/Context.h>
+#include <Urho3D/IO/FileSystem.h>
+#include <Urho3D/Math/MathDefs.h>
+#include <Urho3D/Resource/Image.h>
+#include <Urho3D/Resource/XMLFile.h>
+
+#include "PongAtlas.h"
+
+// Edge pixels repeated around every sprite.
+const int ATLAS_BORDER = 1;
+
+// Largest texture the atlas may grow to.
+const int MAX_ATLAS_SIZE = 4096;
+
+/// Tallest first, then by name, so the packing does not depend on the order
+/// files are listed in.
+static bool CompareSprites(const AtlasSprite& lhs, const AtlasSprite& rhs)
+{
+	if (lhs.image_->GetHeight() != rhs.image_->GetHeight())
+	{
+		return lhs.image_->GetHeight() > rhs.image_->GetHeight();
+	}
+	return lhs.name_ < rhs.name_;
+}
+
+PongAtlas::PongAtlas(Context* context) :
+	context_(context),
+	width_(0),
+	height_(0)
+{
+}
+
+bool PongAtlas::AddImages(const String& directory, const String& exclude)
+{
+	FileSystem* fileSystem = context_->GetSubsystem<FileSystem>();
+	Vector<String> files;
+	fileSystem->ScanDir(files, directory, "*.png", SCAN_FILES, false);
+
+	for (unsigned i = 0; i < files.Size(); ++i)
+	{
+		String name = GetFileName(files[i]);
+		if (name == exclude)
+		{
+			continue;
+		}
+
+		SharedPtr<Image> image(new Image(context_));
+		if (!image->LoadFile(AddTrailingSlash(directory) + files[i]))
+		{
+			fprintf(stderr, "Could not load %s\n", files[i].CString());
+			return false;
+		}
+
+		AtlasSprite sprite = { name, image, 0, 0 };
+		sprites_.Push(sprite);
+	}
+
+	Sort(sprites_.Begin(), sprites_.End(), CompareSprites);
+	return !sprites_.Empty();
+}
+
+bool PongAtlas::Pack()
+{
+	int widest = 0;
+	for (unsigned i = 0; i < sprites_.Size(); ++i)
+	{
+		widest = Max(widest, sprites_[i].image_->GetWidth() + 2 * ATLAS_BORDER);
+	}
+
+	for (int width = (int)NextPowerOfTwo((unsigned)widest); width <= MAX_ATLAS_SIZE; width *= 2)
+	{
+		int usedHeight;
+		if (PackShelves(width, usedHeight))
+		{
+			int height = (int)NextPowerOfTwo((unsigned)usedHeight);
+			if (height <= width)
+			{
+				width_ = width;
+				height_ = height;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+bool PongAtlas::PackShelves(int width, int& usedHeight)
+{
+	int x = 0;
+	int y = 0;
+	int shelfHeight = 0;
+
+	for (unsigned i = 0; i < sprites_.Size(); ++i)
+	{
+		AtlasSprite& sprite = sprites_[i];
+		int spriteWidth = sprite.image_->GetWidth() + 2 * ATLAS_BORDER;
+		int spriteHeight = sprite.image_->GetHeight() + 2 * ATLAS_BORDER;
+		if (spriteWidth > width)
+		{
+			return false;
+		}
+
+		if (x + spriteWidth > width)
+		{
+			y += shelfHeight;
+			x = 0;
+			shelfHeight = 0;
+		}
+		sprite.x_ = x + ATLAS_BORDER;
+		sprite.y_ = y + ATLAS_BORDER;
+		x += spriteWidth;
+		shelfHeight = Max(shelfHeight, spriteHeight);
+	}
+
+	usedHeight = y + shelfHeight;
+	return true;
+}
+
+bool PongAtlas::Save(const String& imagePath, const String& sheetPath) const
+{
+	Image atlas(context_);
+	atlas.SetSize(width_, height_, 4);
+	atlas.Clear(Color(0.0f, 0.0f, 0.0f, 0.0f));
+
+	XMLFile sheet(context_);
+	XMLElement root = sheet.CreateRoot("TextureAtlas");
+	root.SetAttribute("imagePath", GetFileNameAndExtension(imagePath));
+
+	for (unsigned i = 0; i < sprites_.Size(); ++i)
+	{
+		const AtlasSprite& sprite = sprites_[i];
+		const Image* image = sprite.image_;
+		int width = image->GetWidth();
+		int height = image->GetHeight();
+
+		// Copy the image and its border, clamping into the image for the
+		// border. Whole pixels are copied, so the colours stay exact.
+		for (int y = -ATLAS_BORDER; y < height + ATLAS_BORDER; ++y)
+		{
+			for (int x = -ATLAS_BORDER; x < width + ATLAS_BORDER; ++x)
+			{
+				atlas.SetPixelInt(sprite.x_ + x, sprite.y_ + y, image->GetPixelInt(Clamp(x, 0, width - 1), Clamp(y, 0, height - 1)));
+			}
+		}
+
+		XMLElement subTexture = root.CreateChild("SubTexture");
+		subTexture.SetAttribute("name", sprite.name_);
+		subTexture.SetInt("x", sprite.x_);
+		subTexture.SetInt("y", sprite.y_);
+		subTexture.SetInt("width", width);
+		subTexture.SetInt("height", height);
+	}
+
+	return atlas.SavePNG(imagePath) && sheet.SaveFile(sheetPath);
+}
+
+static void PrintUsage()
+{
+	printf("Usage: PongAtlas DIRECTORY [NAME]\n"
+		"  Packs every PNG in DIRECTORY into NAME.png, with the sprite sheet\n"
+		"  NAME.xml next to it. NAME defaults to Sprites.\n");
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argc > 3)
+	{
+		PrintUsage();
+		return EXIT_FAILURE;
+	}
+
+	String directory = AddTrailingSlash(argv[1]);
+	String name = argc > 2 ? argv[2] : "Sprites";
+
+	SharedPtr<Context> context(new Context());
+	context->RegisterSubsystem(new FileSystem(context));
+
+	PongAtlas atlas(context);
+	if (!atlas.AddImages(directory, name))
+	{
+		fprintf(stderr, "No images to pack in %s\n", directory.CString());
+		return EXIT_FAILURE;
+	}
+	if (!atlas.Pack())
+	{
+		fprintf(stderr, "The images do not fit in a %dx%d texture\n", MAX_ATLAS_SIZE, MAX_ATLAS_SIZE);
+		return EXIT_FAILURE;
+	}
+	if (!atlas.Save(directory + name + ".png", directory + name + ".xml"))
+	{
+		fprintf(stderr, "Could not write %s%s\n", directory.CString(), name.CString());
+		return EXIT_FAILURE;
+	}
+
+	printf("Packed %u sprites into %s%s.png, %dx%d\n", atlas.GetNumSprites(), directory.CString(), name.CString(),
+		atlas.GetWidth(), atlas.GetHeight());
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef PONG_ATLAS_H
+#define PONG_ATLAS_H
+
+#include <Urho3D/Container/Ptr.h>
+#include <Urho3D/Container/Str.h>
+#include <Urho3D/Container/Vector.h>
+
+namespace Urho3D
+{
+	class Context;
+	class Image;
+}
+
+using namespace Urho3D;
+
+/// An image to pack, and where its top left corner ended up in the atlas.
+struct AtlasSprite
+{
+	String name_;
+	SharedPtr<Image> image_;
+	int x_;
+	int y_;
+};
+
+/// Packs images into one texture and writes a sprite sheet naming each one's
+/// rectangle in it, so that everything drawn from the sheet shares a material
+/// and the 2D renderer draws it in one batch. Sprites are packed onto shelves
+/// in order of height, in the narrowest power of two texture that is at least
+/// as wide as it is tall. Each sprite's edge pixels are repeated around it, so
+/// that filtering never picks up its neighbours.
+class PongAtlas
+{
+public:
+
+	explicit PongAtlas(Context* context);
+
+	/// Add every PNG in the directory, except the atlas's own image.
+	bool AddImages(const String& directory, const String& exclude);
+	bool Pack();
+	/// Write the texture and, next to it, the sprite sheet.
+	bool Save(const String& imagePath, const String& sheetPath) const;
+
+	unsigned GetNumSprites() const { return sprites_.Size(); }
+	int GetWidth() const { return width_; }
+	int GetHeight() const { return height_; }
+
+private:
+
+	SharedPtr<Context> context_;
+	Vector<AtlasSprite> sprites_;
+	int width_;
+	int height_;
+
+	bool PackShelves(int width, int& usedHeight);
+};
+
+#endif
@@ -0,0 +1,464 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "PongBench.h"
+#include "PongSim/BatchSim.h"
+#include "PongSim/InterceptAi.h"
+#include "PongSim/MultiBallSim.h"
+
+// Time step of every benchmarked step, as the game runs at.
+const float BENCH_TIME_STEP = 1.0f / 60.0f;
+
+// Matches stepped together by the batch benchmarks.
+const unsigned BENCH_BATCH_MATCHES = 1024;
+
+// Balls kept in play by the multi-ball benchmark, which the mode has to step
+// within a 60 Hz frame.
+const unsigned BENCH_MULTI_BALLS = 10000;
+
+// How far short of its target a ball or bat is placed, so that one step
+// always takes it into contact.
+const float BENCH_CONTACT_GAP = 0.01f;
+
+BenchOptions::BenchOptions() :
+	samples_(30),
+	minSampleTime_(0.01)
+{
+}
+
+/// Start a match with the ball at the given place and velocity, and the bats
+/// in the centre.
+static void PlaceBall(PongSim& sim, float x, float y, float velocityX, float velocityY)
+{
+	SimState& state = sim.GetState();
+	state.ballX_ = x;
+	state.ballY_ = y;
+	state.ballVelocityX_ = velocityX;
+	state.ballVelocityY_ = velocityY;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		state.batY_[i] = 0.0f;
+		state.batVelocity_[i] = 0.0f;
+	}
+	state.ballActive_ = true;
+	state.gameRunning_ = true;
+}
+
+/// Lay out the arena's bodies and contact routes, which is what building the
+/// scene amounts to now that the scene only draws the simulation.
+static unsigned BenchArenaSetup(unsigned iterations)
+{
+	PongSim sim;
+	SimParams params;
+	unsigned result = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		sim.SetParams(params);
+		result += sim.GetBody(BODY_TOP_WALL).mask_;
+	}
+
+	return result;
+}
+
+static unsigned BenchServe(unsigned iterations)
+{
+	PongSim sim;
+	unsigned result = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		sim.Reset();
+		sim.StartGame();
+		result += sim.GetState().ballVelocityX_ < 0.0f;
+	}
+
+	return result;
+}
+
+static unsigned BenchBallHitsBat(unsigned iterations)
+{
+	PongSim sim;
+	const SimParams& params = sim.GetParams();
+	float x = params.batOffset_ - params.batHalfWidth_ - params.ballRadius_ - BENCH_CONTACT_GAP;
+	SimInput input = { { 0, 0 } };
+	unsigned result = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		PlaceBall(sim, x, 0.0f, params.initialBallSpeed_, 0.0f);
+		result += sim.Step(BENCH_TIME_STEP, input);
+	}
+
+	return result;
+}
+
+static unsigned BenchBallHitsWall(unsigned iterations)
+{
+	PongSim sim;
+	const SimParams& params = sim.GetParams();
+	float y = params.wallOffset_ - params.wallHalfHeight_ - params.ballRadius_ - BENCH_CONTACT_GAP;
+	SimInput input = { { 0, 0 } };
+	unsigned result = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		PlaceBall(sim, 0.0f, y, 0.0f, params.initialBallSpeed_);
+		result += sim.Step(BENCH_TIME_STEP, input);
+	}
+
+	return result;
+}
+
+static unsigned BenchBatHitsWall(unsigned iterations)
+{
+	PongSim sim;
+	const SimParams& params = sim.GetParams();
+	float y = params.wallOffset_ - params.wallHalfHeight_ - params.batHalfHeight_ - BENCH_CONTACT_GAP;
+	SimInput input = { { 1, 1 } };
+	unsigned result = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		SimState& state = sim.GetState();
+		state.batY_[PLAYER_ONE] = y;
+		state.batY_[PLAYER_TWO] = y;
+		result += sim.Step(BENCH_TIME_STEP, input);
+	}
+
+	return result;
+}
+
+/// Step a rally between two tracking bats, serving again whenever it ends.
+static unsigned StepRally(PongSim& sim, unsigned iterations)
+{
+	unsigned result = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		if (!sim.GetState().gameRunning_)
+		{
+			sim.StartGame();
+		}
+
+		SimInput input;
+		input.batDirection_[PLAYER_ONE] = sim.TrackBall(PLAYER_ONE);
+		input.batDirection_[PLAYER_TWO] = sim.TrackBall(PLAYER_TWO);
+		result += sim.Step(BENCH_TIME_STEP, input);
+	}
+
+	return result;
+}
+
+static unsigned BenchStepContinuous(unsigned iterations)
+{
+	PongSim sim;
+	return StepRally(sim, iterations);
+}
+
+static unsigned BenchStepDiscrete(unsigned iterations)
+{
+	SimParams params;
+	params.continuousCollision_ = false;
+	PongSim sim(params);
+	return StepRally(sim, iterations);
+}
+
+static unsigned BenchStepFixed(unsigned iterations)
+{
+	SimParams params;
+	params.fixedPoint_ = true;
+	PongSim sim(params);
+	return StepRally(sim, iterations);
+}
+
+/// Turn the ball round on every update, so that the AI predicts a new
+/// intercept every time: the most it ever does in a step.
+static unsigned BenchAiUpdate(unsigned iterations)
+{
+	AiParams params;
+	params.reactionTime_ = 0.0f;
+	InterceptAi ai(PLAYER_TWO, params);
+	PongSim sim;
+	sim.StartGame();
+	SimState& state = sim.GetState();
+	unsigned result = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		state.ballVelocityX_ = -state.ballVelocityX_;
+		state.ballY_ = (float)(i & 255) * 0.01f - 1.28f;
+		result += ai.Update(sim, BENCH_TIME_STEP) + 1;
+	}
+
+	return result;
+}
+
+/// Step a batch of rallies, as the headless batch mode does.
+template <SimKernel kernel> unsigned BenchBatchStep(unsigned iterations)
+{
+	BatchSim batch(BENCH_BATCH_MATCHES);
+	batch.SetKernel(kernel);
+	for (unsigned match = 0; match < BENCH_BATCH_MATCHES; ++match)
+	{
+		batch.SetRandomSeed(match, PongSim::MixSeed(1, match));
+	}
+	unsigned result = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		const float* ballY = batch.GetBallY();
+		for (int player = 0; player < NUM_PLAYERS; ++player)
+		{
+			const float* batY = batch.GetBatY((SimPlayer)player);
+			float* directions = batch.GetBatDirections((SimPlayer)player);
+			for (unsigned match = 0; match < BENCH_BATCH_MATCHES; ++match)
+			{
+				directions[match] = ballY[match] > batY[match] + TRACKING_DEAD_ZONE ? 1.0f :
+					(ballY[match] < batY[match] - TRACKING_DEAD_ZONE ? -1.0f : 0.0f);
+			}
+		}
+
+		batch.Step(BENCH_TIME_STEP);
+
+		for (unsigned match = 0; match < BENCH_BATCH_MATCHES; ++match)
+		{
+			if (!batch.IsRunning(match))
+			{
+				batch.StartGame(match);
+			}
+		}
+		result += batch.GetEvents(0);
+	}
+
+	return result;
+}
+
+/// Step a full multi-ball arena, serving a new ball for every one scored,
+/// with the bats sweeping up and down.
+static unsigned BenchMultiBallStep(unsigned iterations)
+{
+	MultiBallSim sim(BENCH_MULTI_BALLS);
+	while (sim.Serve())
+	{
+	}
+	SimInput input;
+	unsigned result = 0;
+
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		input.batDirection_[PLAYER_ONE] = (i / 40) & 1 ? 1 : -1;
+		input.batDirection_[PLAYER_TWO] = (i / 55) & 1 ? -1 : 1;
+		result += sim.Step(BENCH_TIME_STEP, input);
+		while (sim.Serve())
+		{
+		}
+	}
+
+	return result + sim.GetBatHits();
+}
+
+// Keeps benchmark results alive.
+volatile unsigned benchSink = 0;
+
+static double TimeIterations(BenchFunction function, unsigned iterations)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	benchSink += function(iterations);
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+PongBench::PongBench(const BenchOptions& options) :
+	options_(options)
+{
+	const Benchmark benchmarks[] =
+	{
+		{ "arena_setup", BenchArenaSetup, 1 },
+		{ "serve", BenchServe, 1 },
+		{ "ball_bat_contact", BenchBallHitsBat, 1 },
+		{ "ball_wall_contact", BenchBallHitsWall, 1 },
+		{ "bat_wall_stop", BenchBatHitsWall, 1 },
+		{ "step_continuous", BenchStepContinuous, 1 },
+		{ "step_discrete", BenchStepDiscrete, 1 },
+		{ "step_fixed", BenchStepFixed, 1 },
+		{ "ai_update", BenchAiUpdate, 1 },
+		{ "multiball_step", BenchMultiBallStep, BENCH_MULTI_BALLS }
+	};
+	const Benchmark batchBenchmarks[NUM_KERNELS] =
+	{
+		{ "batch_step_scalar", BenchBatchStep<KERNEL_SCALAR>, BENCH_BATCH_MATCHES },
+		{ "batch_step_sse2", BenchBatchStep<KERNEL_SSE2>, BENCH_BATCH_MATCHES },
+		{ "batch_step_avx2", BenchBatchStep<KERNEL_AVX2>, BENCH_BATCH_MATCHES }
+	};
+
+	for (unsigned i = 0; i < sizeof benchmarks / sizeof benchmarks[0]; ++i)
+	{
+		AddBenchmark(benchmarks[i]);
+	}
+	for (int kernel = KERNEL_SCALAR; kernel < NUM_KERNELS; ++kernel)
+	{
+		// Kernels the CPU lacks would only time the scalar fallback again.
+		if (BatchSim::IsKernelSupported((SimKernel)kernel))
+		{
+			AddBenchmark(batchBenchmarks[kernel]);
+		}
+	}
+}
+
+void PongBench::AddBenchmark(const Benchmark& benchmark)
+{
+	if (options_.filter_.empty() || strstr(benchmark.name_, options_.filter_.c_str()))
+	{
+		benchmarks_.push_back(benchmark);
+	}
+}
+
+void PongBench::Run()
+{
+	for (unsigned i = 0; i < benchmarks_.size(); ++i)
+	{
+		results_.push_back(RunBenchmark(benchmarks_[i]));
+	}
+}
+
+BenchResult PongBench::RunBenchmark(const Benchmark& benchmark) const
+{
+	// Find an iteration count that fills a sample, which also warms up.
+	unsigned iterations = 1;
+	for (;;)
+	{
+		double time = TimeIterations(benchmark.function_, iterations);
+		if (time >= options_.minSampleTime_ || iterations >= 1U << 30)
+		{
+			break;
+		}
+		double scale = time > 0.0 ? options_.minSampleTime_ / time * 1.2 : 10.0;
+		iterations = (unsigned)std::min((double)iterations * std::min(std::max(scale, 2.0), 10.0), (double)(1U << 30));
+	}
+
+	std::vector<double> samples;
+	double operations = (double)iterations * benchmark.operationsPerIteration_;
+	for (unsigned i = 0; i < options_.samples_; ++i)
+	{
+		samples.push_back(TimeIterations(benchmark.function_, iterations) * 1e9 / operations);
+	}
+	std::sort(samples.begin(), samples.end());
+
+	BenchResult result;
+	result.name_ = benchmark.name_;
+	result.iterations_ = iterations;
+	result.samples_ = (unsigned)samples.size();
+	result.min_ = samples.front();
+	result.max_ = samples.back();
+	unsigned middle = result.samples_ / 2;
+	result.median_ = result.samples_ & 1 ? samples[middle] : (samples[middle - 1] + samples[middle]) / 2.0;
+
+	double sum = 0.0;
+	for (unsigned i = 0; i < samples.size(); ++i)
+	{
+		sum += samples[i];
+	}
+	result.mean_ = sum / result.samples_;
+	double squares = 0.0;
+	for (unsigned i = 0; i < samples.size(); ++i)
+	{
+		squares += (samples[i] - result.mean_) * (samples[i] - result.mean_);
+	}
+	result.standardDeviation_ = result.samples_ > 1 ? std::sqrt(squares / (result.samples_ - 1)) : 0.0;
+
+	return result;
+}
+
+void PongBench::Report() const
+{
+	printf("%-20s %12s %8s %12s %12s %12s\n", "benchmark", "median ns", "stddev", "min ns", "max ns", "iterations");
+	for (unsigned i = 0; i < results_.size(); ++i)
+	{
+		const BenchResult& result = results_[i];
+		printf("%-20s %12.2f %7.1f%% %12.2f %12.2f %12u\n", result.name_.c_str(), result.median_,
+			result.standardDeviation_ / std::max(result.mean_, 1e-9) * 100.0, result.min_, result.max_, result.iterations_);
+	}
+}
+
+bool PongBench::WriteJson(const std::string& path) const
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		return false;
+	}
+
+	// Benchmark names are plain identifiers, so nothing needs escaping.
+	fprintf(file, "{\n  \"samples\": %u,\n  \"min_sample_time\": %g,\n  \"batch_kernel\": \"%s\",\n  \"benchmarks\": [\n",
+		options_.samples_, options_.minSampleTime_, BatchSim::GetKernelName(BatchSim::GetBestKernel()));
+	for (unsigned i = 0; i < results_.size(); ++i)
+	{
+		const BenchResult& result = results_[i];
+		fprintf(file, "    { \"name\": \"%s\", \"iterations\": %u, \"samples\": %u, \"median_ns\": %.3f, \"mean_ns\": %.3f, "
+			"\"stddev_ns\": %.3f, \"min_ns\": %.3f, \"max_ns\": %.3f }%s\n", result.name_.c_str(), result.iterations_,
+			result.samples_, result.median_, result.mean_, result.standardDeviation_, result.min_, result.max_,
+			i + 1 < results_.size() ? "," : "");
+	}
+	fprintf(file, "  ]\n}\n");
+
+	fclose(file);
+	return true;
+}
+
+static void PrintUsage()
+{
+	printf("Usage: PongBench [options]\n"
+		"  -samples N   timed samples of every benchmark\n"
+		"  -mintime S   minimum length of a sample in seconds\n"
+		"  -filter NAME only run benchmarks whose name contains NAME\n"
+		"  -json FILE   write the results as JSON\n");
+}
+
+int main(int argc, char** argv)
+{
+	BenchOptions options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (!strcmp(argument, "-samples") && hasValue)
+		{
+			options.samples_ = std::max((unsigned)strtoul(argv[++i], 0, 10), 1U);
+		}
+		else if (!strcmp(argument, "-mintime") && hasValue)
+		{
+			options.minSampleTime_ = std::max(atof(argv[++i]), 0.0001);
+		}
+		else if (!strcmp(argument, "-filter") && hasValue)
+		{
+			options.filter_ = argv[++i];
+		}
+		else if (!strcmp(argument, "-json") && hasValue)
+		{
+			options.output_ = argv[++i];
+		}
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	PongBench bench(options);
+	bench.Run();
+	bench.Report();
+
+	if (!options.output_.empty() && !bench.WriteJson(options.output_))
+	{
+		fprintf(stderr, "Could not write %s\n", options.output_.c_str());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#ifndef PONG_BENCH_H
+#define PONG_BENCH_H
+
+#include <string>
+#include <vector>
+
+struct BenchOptions
+{
+	BenchOptions();
+
+	// Timed samples taken of every benchmark, after calibrating the number of
+	// iterations, which also warms up.
+	unsigned samples_;
+	// Each sample repeats the operation until it takes at least this long,
+	// in seconds.
+	double minSampleTime_;
+	// Only benchmarks whose name contains this are run, if set.
+	std::string filter_;
+	// Results are written here as JSON, if set.
+	std::string output_;
+};
+
+/// Runs a benchmark's operation the given number of times and returns a
+/// value derived from the results, so that the work cannot be optimised
+/// away. Any setup is done first, and is small enough to vanish into the
+/// timing of a whole sample.
+typedef unsigned (*BenchFunction)(unsigned iterations);
+
+struct Benchmark
+{
+	const char* name_;
+	BenchFunction function_;
+	// Operations each iteration performs, e.g. the matches in a batch step.
+	unsigned operationsPerIteration_;
+};
+
+/// Nanoseconds per operation over every sample of a benchmark.
+struct BenchResult
+{
+	std::string name_;
+	unsigned iterations_;
+	unsigned samples_;
+	double median_;
+	double mean_;
+	double standardDeviation_;
+	double min_;
+	double max_;
+};
+
+/// Times the simulation's hot paths in isolation. Every benchmark's
+/// iteration count is calibrated once, then the same count is timed for
+/// every sample, and the median is reported along with the spread.
+class PongBench
+{
+public:
+
+	explicit PongBench(const BenchOptions& options);
+	void Run();
+	void Report() const;
+	bool WriteJson(const std::string& path) const;
+
+private:
+
+	BenchOptions options_;
+	std::vector<Benchmark> benchmarks_;
+	std::vector<BenchResult> results_;
+
+	void AddBenchmark(const Benchmark& benchmark);
+	BenchResult RunBenchmark(const Benchmark& benchmark) const;
+};
+
+#endif
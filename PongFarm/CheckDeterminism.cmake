@@ -0,0 +1,55 @@
+# Build PongFarm and the simulation straight from source twice, unoptimised
+# and at full optimisation with the fast math the release build uses, and
+# check that fixed point matches hash the same tick for tick in both: with
+# the bats tracking the ball, and with the AI playing, with and without its
+# noise. Run by the determinism target and by ctest, as
+#
+#   cmake -DCOMPILER=<c++> -DSOURCE_DIR=<source> -DBINARY_DIR=<dir> -P CheckDeterminism.cmake
+
+set (MATCHES 3000)
+set (BUILDS unoptimised optimised)
+set (unoptimised_FLAGS -O0)
+set (optimised_FLAGS -O3 -ffast-math -march=native)
+set (CASES tracking ai_exact ai_noisy)
+set (tracking_ARGS "")
+set (ai_exact_ARGS -ai -ainoise 0)
+set (ai_noisy_ARGS -ai -ainoise 0.5 -aireactionmax 0.5)
+
+file (GLOB SOURCES ${SOURCE_DIR}/PongFarm/*.cpp ${SOURCE_DIR}/PongSim/*.cpp)
+file (MAKE_DIRECTORY ${BINARY_DIR})
+
+foreach (BUILD ${BUILDS})
+    message (STATUS "Building PongFarm ${BUILD} (${${BUILD}_FLAGS})")
+    execute_process (COMMAND ${COMPILER} -std=c++11 ${${BUILD}_FLAGS} -pthread -I${SOURCE_DIR} ${SOURCES}
+        -o ${BINARY_DIR}/PongFarm-${BUILD} RESULT_VARIABLE RESULT)
+    if (NOT RESULT EQUAL 0)
+        message (FATAL_ERROR "Could not build PongFarm ${BUILD}")
+    endif ()
+endforeach ()
+
+set (FAILED FALSE)
+foreach (CASE ${CASES})
+    set (HASHES "")
+    foreach (BUILD ${BUILDS})
+        execute_process (COMMAND ${BINARY_DIR}/PongFarm-${BUILD} -matches ${MATCHES} -hash -fixedpoint ${${CASE}_ARGS}
+            OUTPUT_VARIABLE OUTPUT RESULT_VARIABLE RESULT)
+        string (REGEX MATCH "State hash of every tick ([0-9a-f]+)" HASH "${OUTPUT}")
+        if (NOT RESULT EQUAL 0 OR NOT HASH)
+            message (FATAL_ERROR "PongFarm ${BUILD} failed on ${CASE}")
+        endif ()
+        list (APPEND HASHES ${CMAKE_MATCH_1})
+    endforeach ()
+    list (REMOVE_DUPLICATES HASHES)
+    list (LENGTH HASHES DISTINCT)
+    if (DISTINCT EQUAL 1)
+        message (STATUS "${CASE}: ${HASHES} from every build")
+    else ()
+        string (REPLACE ";" " and " HASHES "${HASHES}")
+        message (STATUS "${CASE}: builds differ, ${HASHES}")
+        set (FAILED TRUE)
+    endif ()
+endforeach ()
+
+if (FAILED)
+    message (FATAL_ERROR "Fixed point matches differ between optimisation levels")
+endif ()
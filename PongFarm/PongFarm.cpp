@@ -0,0 +1,456 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "PongFarm.h"
+#include "PongSim/BatchSim.h"
+#include "PongSim/InputRecording.h"
+#include "PongSim/SimParamsFile.h"
+#include "PongTuner.h"
+#include "WorkRanges.h"
+
+// FNV-1a, for chaining the per tick state hashes.
+const unsigned FNV_OFFSET_BASIS = 2166136261u;
+const unsigned FNV_PRIME = 16777619u;
+
+FarmOptions::FarmOptions() :
+	matches_(100000),
+	threads_(0),
+	grain_(16),
+	timeStep_(1.0f / 60.0f),
+	maxMatchTime_(300.0f),
+	seed_(1),
+	ai_(false),
+	aiReactionMax_(0.0f),
+	hashTicks_(false)
+{
+}
+
+FarmStats::FarmStats() :
+	matches_(0),
+	timeouts_(0),
+	maxRallyLength_(0),
+	rallyLength_(0),
+	finalBallSpeed_(0.0),
+	simulatedTime_(0.0)
+{
+	wins_[PLAYER_ONE] = 0;
+	wins_[PLAYER_TWO] = 0;
+}
+
+void FarmStats::Add(const MatchResult& result)
+{
+	++matches_;
+	if (result.winner_ < 0)
+	{
+		++timeouts_;
+	}
+	else
+	{
+		++wins_[result.winner_];
+	}
+	maxRallyLength_ = std::max(maxRallyLength_, result.rallyLength_);
+	rallyLength_ += result.rallyLength_;
+	finalBallSpeed_ += result.finalBallSpeed_;
+	simulatedTime_ += result.duration_;
+}
+
+void FarmStats::Merge(const FarmStats& stats)
+{
+	matches_ += stats.matches_;
+	wins_[PLAYER_ONE] += stats.wins_[PLAYER_ONE];
+	wins_[PLAYER_TWO] += stats.wins_[PLAYER_TWO];
+	timeouts_ += stats.timeouts_;
+	maxRallyLength_ = std::max(maxRallyLength_, stats.maxRallyLength_);
+	rallyLength_ += stats.rallyLength_;
+	finalBallSpeed_ += stats.finalBallSpeed_;
+	simulatedTime_ += stats.simulatedTime_;
+}
+
+PongFarm::PongFarm(const FarmOptions& options) :
+	options_(options),
+	elapsed_(0.0)
+{
+	if (!options_.threads_)
+	{
+		options_.threads_ = std::max(std::thread::hardware_concurrency(), 1U);
+	}
+	options_.grain_ = std::max(options_.grain_, 1U);
+	workers_.resize(options_.threads_);
+}
+
+MatchResult PongFarm::PlayMatch(PongSim& sim, unsigned match, const FarmOptions& options)
+{
+	// Each match, and its serves and players within it, get their own seeds,
+	// so results do not depend on which thread played which match.
+	unsigned matchSeed = PongSim::MixSeed(options.seed_, match);
+	sim.Reset();
+	sim.SetRandomSeed(PongSim::MixSeed(matchSeed, SEED_SERVES));
+	sim.StartGame();
+
+	const SimState& state = sim.GetState();
+	SimInput input;
+	unsigned playerSeeds[NUM_PLAYERS];
+	AiParams playerParams[NUM_PLAYERS] = { options.aiParams_, options.aiParams_ };
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		playerSeeds[i] = PongSim::MixSeed(matchSeed, SEED_PLAYER_ONE + i);
+		if (options.aiReactionMax_ > options.aiParams_.reactionTime_)
+		{
+			// Drawn in fixed point, so that a player is as skilled on every
+			// build. Random numbers are from 0 to 32767.
+			Fixed skill = FixedDivide(PongSim::NextRandom(playerSeeds[i]), 32767);
+			Fixed minReaction = ToFixed(options.aiParams_.reactionTime_);
+			Fixed range = ToFixed(options.aiReactionMax_) - minReaction;
+			playerParams[i].reactionTime_ = FixedToFloat(minReaction + FixedMultiply(skill, range));
+		}
+	}
+	InterceptAi players[NUM_PLAYERS] =
+	{
+		InterceptAi(PLAYER_ONE, playerParams[PLAYER_ONE], playerSeeds[PLAYER_ONE]),
+		InterceptAi(PLAYER_TWO, playerParams[PLAYER_TWO], playerSeeds[PLAYER_TWO])
+	};
+	unsigned stateHash = FNV_OFFSET_BASIS;
+
+	while (state.gameRunning_ && (options.maxMatchTime_ <= 0.0f || state.matchTime_ < options.maxMatchTime_))
+	{
+		for (int i = 0; i < NUM_PLAYERS; ++i)
+		{
+			input.batDirection_[i] = options.ai_ ? players[i].Update(sim, options.timeStep_) : sim.TrackBall((SimPlayer)i);
+		}
+		sim.Step(options.timeStep_, input);
+		if (options.hashTicks_)
+		{
+			stateHash = (stateHash ^ InputRecording::HashState(state)) * FNV_PRIME;
+		}
+	}
+
+	MatchResult result;
+	result.match_ = match;
+	result.rallyLength_ = state.rallyLength_;
+	result.finalBallSpeed_ = std::sqrt(state.ballVelocityX_ * state.ballVelocityX_ + state.ballVelocityY_ * state.ballVelocityY_);
+	result.duration_ = state.matchTime_;
+	result.stateHash_ = options.hashTicks_ ? stateHash : 0;
+	result.winner_ = state.gameRunning_ ? -1 : state.winner_;
+	return result;
+}
+
+void PongFarm::Run()
+{
+	WorkRanges ranges(options_.threads_, options_.matches_);
+	std::vector<std::thread> threads;
+
+	// Reserve each worker's share up front; a worker that steals a lot may
+	// still grow its buffer, but never touches anyone else's.
+	for (unsigned i = 0; i < options_.threads_; ++i)
+	{
+		workers_[i].results_.reserve(options_.matches_ / options_.threads_ + options_.grain_);
+	}
+
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (unsigned i = 0; i < options_.threads_; ++i)
+	{
+		threads.push_back(std::thread([this, &ranges, i]()
+		{
+			Worker& worker = workers_[i];
+			PongSim sim(options_.params_);
+			unsigned begin;
+			unsigned end;
+
+			while (ranges.Take(i, options_.grain_, begin, end))
+			{
+				for (unsigned match = begin; match < end; ++match)
+				{
+					MatchResult result = PlayMatch(sim, match, options_);
+					worker.stats_.Add(result);
+					worker.results_.push_back(result);
+				}
+			}
+		}));
+	}
+
+	for (unsigned i = 0; i < threads.size(); ++i)
+	{
+		threads[i].join();
+		workers_[i].steals_ = ranges.GetNumSteals(i);
+	}
+
+	elapsed_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// Merge the per worker buffers, in match order.
+	for (unsigned i = 0; i < workers_.size(); ++i)
+	{
+		totals_.Merge(workers_[i].stats_);
+		results_.insert(results_.end(), workers_[i].results_.begin(), workers_[i].results_.end());
+	}
+	std::sort(results_.begin(), results_.end(), [](const MatchResult& a, const MatchResult& b) { return a.match_ < b.match_; });
+}
+
+void PongFarm::Report() const
+{
+	unsigned steals = 0;
+	for (unsigned i = 0; i < workers_.size(); ++i)
+	{
+		steals += workers_[i].steals_;
+	}
+
+	unsigned matches = std::max(totals_.matches_, 1U);
+	double elapsed = std::max(elapsed_, 1e-9);
+
+	printf("Played %u matches on %u threads in %.3f s (%u steals)\n", totals_.matches_, options_.threads_, elapsed_, steals);
+	printf("%.1f matches/s, %.1f simulated s/s\n", totals_.matches_ / elapsed, totals_.simulatedTime_ / elapsed);
+	printf("Player one won %u, player two won %u, %u timed out\n", totals_.wins_[PLAYER_ONE], totals_.wins_[PLAYER_TWO], totals_.timeouts_);
+	printf("Mean rally length %.2f (max %u), mean final ball speed %.3f\n", (double)totals_.rallyLength_ / matches,
+		totals_.maxRallyLength_, totals_.finalBallSpeed_ / matches);
+	if (options_.hashTicks_)
+	{
+		printf("State hash of every tick %08x%s\n", GetStateHash(), options_.params_.fixedPoint_ ? " (fixed point)" : "");
+	}
+}
+
+unsigned PongFarm::GetStateHash() const
+{
+	unsigned hash = FNV_OFFSET_BASIS;
+	for (unsigned i = 0; i < results_.size(); ++i)
+	{
+		hash = (hash ^ results_[i].stateHash_) * FNV_PRIME;
+	}
+	return hash;
+}
+
+bool PongFarm::WriteResults(const std::string& path) const
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		return false;
+	}
+
+	fprintf(file, "match,winner,rally_length,final_ball_speed,duration,state_hash\n");
+	for (unsigned i = 0; i < results_.size(); ++i)
+	{
+		const MatchResult& result = results_[i];
+		fprintf(file, "%u,%d,%u,%.6f,%.6f,%08x\n", result.match_, result.winner_, result.rallyLength_, result.finalBallSpeed_,
+			result.duration_, result.stateHash_);
+	}
+
+	fclose(file);
+	return true;
+}
+
+// Every candidate plays this many matches unless told otherwise; enough for
+// the rally length statistics to settle, while keeping a generation short.
+const unsigned DEFAULT_TUNE_MATCHES = 2000;
+
+// Matches and steps -verifybatch runs every batch kernel for, unless -matches
+// is given; the same as the game's own -verifybatch.
+const unsigned VERIFY_MATCHES = 256;
+const unsigned VERIFY_STEPS = 20000;
+
+static void PrintUsage()
+{
+	printf("Usage: PongFarm [options]\n"
+		"  -matches N       number of matches to play\n"
+		"  -threads N       worker threads, 0 for one per hardware thread\n"
+		"  -grain N         matches taken from the work queue at a time\n"
+		"  -timestep S      fixed simulation time step in seconds\n"
+		"  -maxmatchtime S  give up on a match after this many simulated seconds\n"
+		"  -seed N          seed every match's seeds are derived from\n"
+		"  -output FILE     write per match results as CSV\n"
+		"  -ai              play both sides with the intercepting AI\n"
+		"  -aireaction S    the AI's reaction time in seconds\n"
+		"  -ainoise U       most the AI's aim is off by, in world units\n"
+		"  -aireactionmax S draw each player's reaction time from up to this\n"
+		"  -params FILE     load gameplay constants from a parameter file\n"
+		"  -fixedpoint      simulate in deterministic Q16.16 fixed point\n"
+		"  -hash            hash the state after every tick, and report the\n"
+		"                   combined hash; compare it between builds\n"
+		"  -verifybatch     check every supported batch kernel steps matches\n"
+		"                   bit for bit the same as the scalar one\n"
+		"\n"
+		"  -tune            search for constants that give the target matches;\n"
+		"                   -matches is then per candidate\n"
+		"  -generations N   generations of the search\n"
+		"  -population N    candidates per generation\n"
+		"  -targetrally M,S target mean and standard deviation of rally length\n"
+		"  -targetduration M,S  the same for match duration in seconds\n"
+		"  -bestsets N      number of the best sets to write\n"
+		"  -tuneoutput P    write the best sets as P_1.params and so on\n");
+}
+
+/// Run every batch kernel the CPU supports against the scalar one, and
+/// report whether they agree.
+static bool VerifyBatchKernels(const FarmOptions& options, unsigned matches)
+{
+	for (int kernel = KERNEL_SCALAR; kernel < NUM_KERNELS; ++kernel)
+	{
+		printf("%s kernel: %s\n", BatchSim::GetKernelName((SimKernel)kernel),
+			BatchSim::IsKernelSupported((SimKernel)kernel) ? "supported" : "not supported");
+	}
+
+	unsigned mismatches = BatchSim::CompareKernels(matches, VERIFY_STEPS, options.timeStep_, options.seed_);
+	if (mismatches)
+	{
+		fprintf(stderr, "Batch kernels differ from the scalar simulation in %u match steps\n", mismatches);
+		return false;
+	}
+
+	printf("Batch kernels match the scalar simulation bit for bit\n");
+	return true;
+}
+
+/// Parse "MEAN,SD".
+static bool ParseTarget(const char* value, TuneTarget& target)
+{
+	return sscanf(value, "%f,%f", &target.mean_, &target.standardDeviation_) == 2 && target.mean_ > 0.0f &&
+		target.standardDeviation_ >= 0.0f;
+}
+
+int main(int argc, char** argv)
+{
+	FarmOptions options;
+	TuneOptions tuneOptions;
+	bool tune = false;
+	bool verifyBatch = false;
+	bool matchesGiven = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (!strcmp(argument, "-matches") && hasValue)
+		{
+			options.matches_ = (unsigned)strtoul(argv[++i], 0, 10);
+			matchesGiven = true;
+		}
+		else if (!strcmp(argument, "-threads") && hasValue)
+		{
+			options.threads_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-grain") && hasValue)
+		{
+			options.grain_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-timestep") && hasValue)
+		{
+			options.timeStep_ = std::max((float)atof(argv[++i]), 0.0001f);
+		}
+		else if (!strcmp(argument, "-maxmatchtime") && hasValue)
+		{
+			options.maxMatchTime_ = (float)atof(argv[++i]);
+		}
+		else if (!strcmp(argument, "-seed") && hasValue)
+		{
+			options.seed_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-output") && hasValue)
+		{
+			options.output_ = argv[++i];
+		}
+		else if (!strcmp(argument, "-ai"))
+		{
+			options.ai_ = true;
+		}
+		else if (!strcmp(argument, "-aireaction") && hasValue)
+		{
+			options.aiParams_.reactionTime_ = std::max((float)atof(argv[++i]), 0.0f);
+		}
+		else if (!strcmp(argument, "-ainoise") && hasValue)
+		{
+			options.aiParams_.noise_ = std::max((float)atof(argv[++i]), 0.0f);
+		}
+		else if (!strcmp(argument, "-aireactionmax") && hasValue)
+		{
+			options.aiReactionMax_ = std::max((float)atof(argv[++i]), 0.0f);
+		}
+		else if (!strcmp(argument, "-params") && hasValue)
+		{
+			const char* path = argv[++i];
+			if (!LoadSimParams(path, options.params_))
+			{
+				fprintf(stderr, "Could not load parameters from %s\n", path);
+				return EXIT_FAILURE;
+			}
+		}
+		else if (!strcmp(argument, "-fixedpoint"))
+		{
+			options.params_.fixedPoint_ = true;
+		}
+		else if (!strcmp(argument, "-hash"))
+		{
+			options.hashTicks_ = true;
+		}
+		else if (!strcmp(argument, "-verifybatch"))
+		{
+			verifyBatch = true;
+		}
+		else if (!strcmp(argument, "-tune"))
+		{
+			tune = true;
+		}
+		else if (!strcmp(argument, "-generations") && hasValue)
+		{
+			tuneOptions.generations_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-population") && hasValue)
+		{
+			tuneOptions.population_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-targetrally") && hasValue && ParseTarget(argv[i + 1], tuneOptions.rallyLength_))
+		{
+			++i;
+		}
+		else if (!strcmp(argument, "-targetduration") && hasValue && ParseTarget(argv[i + 1], tuneOptions.duration_))
+		{
+			++i;
+		}
+		else if (!strcmp(argument, "-bestsets") && hasValue)
+		{
+			tuneOptions.bestSets_ = std::max((unsigned)strtoul(argv[++i], 0, 10), 1U);
+		}
+		else if (!strcmp(argument, "-tuneoutput") && hasValue)
+		{
+			tuneOptions.output_ = argv[++i];
+		}
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (verifyBatch)
+	{
+		return VerifyBatchKernels(options, matchesGiven ? options.matches_ : VERIFY_MATCHES) ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	if (tune)
+	{
+		if (!matchesGiven)
+		{
+			options.matches_ = DEFAULT_TUNE_MATCHES;
+		}
+		tuneOptions.seed_ = options.seed_;
+		PongTuner tuner(options, tuneOptions);
+		tuner.Run();
+		return tuner.WriteBest() ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+
+	PongFarm farm(options);
+	farm.Run();
+	farm.Report();
+
+	if (!options.output_.empty() && !farm.WriteResults(options.output_))
+	{
+		fprintf(stderr, "Could not write %s\n", options.output_.c_str());
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#ifndef PONG_FARM_H
+#define PONG_FARM_H
+
+#include <string>
+#include <vector>
+
+#include "PongSim/InterceptAi.h"
+#include "PongSim/PongSim.h"
+
+struct FarmOptions
+{
+	FarmOptions();
+
+	unsigned matches_;
+	// Zero uses every hardware thread.
+	unsigned threads_;
+	// Number of matches a worker takes from its range at a time.
+	unsigned grain_;
+	float timeStep_;
+	float maxMatchTime_;
+	unsigned seed_;
+	SimParams params_;
+	// Play both sides with InterceptAi rather than simple ball tracking.
+	bool ai_;
+	AiParams aiParams_;
+	// If above aiParams_'s reaction time, each player's reaction time is
+	// drawn from between the two for every match, for a spread of skill.
+	float aiReactionMax_;
+	// Chain a hash of the state after every tick into each match's result,
+	// to compare runs bit for bit, e.g. fixed point builds at different
+	// optimisation levels or on different CPUs.
+	bool hashTicks_;
+	// Per match results are written here as CSV, if set.
+	std::string output_;
+};
+
+/// Outcome of one match. A winner of -1 means the match timed out.
+struct MatchResult
+{
+	unsigned match_;
+	unsigned rallyLength_;
+	float finalBallSpeed_;
+	float duration_;
+	// Zero unless the ticks were hashed.
+	unsigned stateHash_;
+	signed char winner_;
+};
+
+struct FarmStats
+{
+	FarmStats();
+	void Add(const MatchResult& result);
+	void Merge(const FarmStats& stats);
+
+	unsigned matches_;
+	unsigned wins_[NUM_PLAYERS];
+	unsigned timeouts_;
+	unsigned maxRallyLength_;
+	unsigned long long rallyLength_;
+	double finalBallSpeed_;
+	double simulatedTime_;
+};
+
+/// Plays many independent headless matches across all cores. Work is spread
+/// with WorkRanges, every worker has its own simulation and result buffer,
+/// and the buffers are only merged once all workers have finished.
+class PongFarm
+{
+public:
+
+	explicit PongFarm(const FarmOptions& options);
+	void Run();
+	void Report() const;
+	bool WriteResults(const std::string& path) const;
+	/// The tick hashes of every match combined in match order.
+	unsigned GetStateHash() const;
+	const FarmStats& GetTotals() const { return totals_; }
+	/// Every match's result, in match order.
+	const std::vector<MatchResult>& GetResults() const { return results_; }
+
+	/// Play one match to the end, or until it times out. The match's seeds
+	/// are derived from its number, so it plays the same on any thread.
+	static MatchResult PlayMatch(PongSim& sim, unsigned match, const FarmOptions& options);
+
+private:
+
+	struct Worker
+	{
+		FarmStats stats_;
+		std::vector<MatchResult> results_;
+		unsigned steals_;
+		// Keep workers' data on separate cache lines.
+		char padding_[64];
+	};
+
+	FarmOptions options_;
+	std::vector<Worker> workers_;
+	FarmStats totals_;
+	std::vector<MatchResult> results_;
+	double elapsed_;
+};
+
+#endif
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <random>
+
+#include "PongSim/SimParamsFile.h"
+#include "PongTuner.h"
+
+/// A tuned parameter and the range it is searched in.
+struct TunedParam
+{
+	const char* name_;
+	float SimParams::* member_;
+	float min_;
+	float max_;
+};
+
+// The bats stay well clear of the end zones at either end of their range.
+static const TunedParam TUNED_PARAMS[] =
+{
+	{ "batSpeed", &SimParams::batSpeed_, 2.0f, 8.0f },
+	{ "batOffset", &SimParams::batOffset_, 3.2f, 3.9f },
+	{ "initialBallSpeed", &SimParams::initialBallSpeed_, 2.0f, 8.0f },
+	{ "batSpeedUp", &SimParams::batSpeedUp_, 1.0f, 1.1f }
+};
+
+const unsigned NUM_TUNED_PARAMS = sizeof TUNED_PARAMS / sizeof TUNED_PARAMS[0];
+
+// Spread of the first generation, and the least any later one is allowed to
+// shrink to, as fractions of each parameter's range.
+const double INITIAL_SPREAD = 0.3;
+const double MIN_SPREAD = 0.02;
+
+// A match that times out counts this much against a candidate.
+const double TIMEOUT_COST = 10.0;
+
+// Slowest reaction time in the spread of AI skill the matches are played
+// with, unless the farm options give one.
+const float TUNE_REACTION_MAX = 0.45f;
+
+TuneOptions::TuneOptions() :
+	generations_(20),
+	population_(16),
+	eliteFraction_(0.25f),
+	seed_(1),
+	bestSets_(3),
+	output_("tuned")
+{
+	// Matches between players of the tuning skill spread vary by a few hits
+	// and seconds either way, so wider targets cannot be met and only pull
+	// the means off theirs.
+	rallyLength_.mean_ = 20.0f;
+	rallyLength_.standardDeviation_ = 3.0f;
+	duration_.mean_ = 30.0f;
+	duration_.standardDeviation_ = 3.0f;
+}
+
+PongTuner::PongTuner(const FarmOptions& farmOptions, const TuneOptions& options) :
+	farmOptions_(farmOptions),
+	options_(options)
+{
+	farmOptions_.ai_ = true;
+	if (farmOptions_.aiReactionMax_ <= farmOptions_.aiParams_.reactionTime_)
+	{
+		farmOptions_.aiReactionMax_ = std::max(TUNE_REACTION_MAX, farmOptions_.aiParams_.reactionTime_);
+	}
+	options_.population_ = std::max(options_.population_, 2U);
+	options_.eliteFraction_ = std::min(std::max(options_.eliteFraction_, 0.0f), 1.0f);
+}
+
+/// Squared distance of a statistic from its target, relative to the target
+/// so that rally lengths and seconds weigh the same.
+static double TargetCost(double mean, double deviation, const TuneTarget& target)
+{
+	double meanScale = std::max((double)target.mean_, 1e-3);
+	double deviationScale = std::max((double)target.standardDeviation_, meanScale * 0.1);
+	double meanError = (mean - target.mean_) / meanScale;
+	double deviationError = (deviation - target.standardDeviation_) / deviationScale;
+	return meanError * meanError + deviationError * deviationError;
+}
+
+CandidateStats PongTuner::Evaluate(const SimParams& params) const
+{
+	FarmOptions options = farmOptions_;
+	options.params_ = params;
+	PongFarm farm(options);
+	farm.Run();
+
+	const std::vector<MatchResult>& results = farm.GetResults();
+	double count = std::max((double)results.size(), 1.0);
+	double rallySum = 0.0;
+	double rallySquares = 0.0;
+	double durationSum = 0.0;
+	double durationSquares = 0.0;
+	unsigned timeouts = 0;
+	for (unsigned i = 0; i < results.size(); ++i)
+	{
+		const MatchResult& result = results[i];
+		rallySum += result.rallyLength_;
+		rallySquares += (double)result.rallyLength_ * result.rallyLength_;
+		durationSum += result.duration_;
+		durationSquares += (double)result.duration_ * result.duration_;
+		timeouts += result.winner_ < 0 ? 1 : 0;
+	}
+
+	CandidateStats stats;
+	stats.rallyMean_ = rallySum / count;
+	stats.rallyDeviation_ = std::sqrt(std::max(rallySquares / count - stats.rallyMean_ * stats.rallyMean_, 0.0));
+	stats.durationMean_ = durationSum / count;
+	stats.durationDeviation_ = std::sqrt(std::max(durationSquares / count - stats.durationMean_ * stats.durationMean_, 0.0));
+	stats.timeoutFraction_ = timeouts / count;
+	stats.cost_ = TargetCost(stats.rallyMean_, stats.rallyDeviation_, options_.rallyLength_) +
+		TargetCost(stats.durationMean_, stats.durationDeviation_, options_.duration_) + TIMEOUT_COST * stats.timeoutFraction_;
+	return stats;
+}
+
+void PongTuner::KeepBest(const TuneCandidate& candidate)
+{
+	best_.push_back(candidate);
+	std::sort(best_.begin(), best_.end(), [](const TuneCandidate& a, const TuneCandidate& b) { return a.stats_.cost_ < b.stats_.cost_; });
+	if (best_.size() > options_.bestSets_)
+	{
+		best_.resize(options_.bestSets_);
+	}
+}
+
+void PongTuner::Run()
+{
+	std::mt19937 random(options_.seed_);
+	std::normal_distribution<double> normal;
+	unsigned numElites = std::max((unsigned)(options_.population_ * options_.eliteFraction_), 1U);
+
+	// The search distribution, scaled to each parameter's range.
+	double mean[NUM_TUNED_PARAMS];
+	double spread[NUM_TUNED_PARAMS];
+	for (unsigned i = 0; i < NUM_TUNED_PARAMS; ++i)
+	{
+		const TunedParam& param = TUNED_PARAMS[i];
+		double value = (farmOptions_.params_.*param.member_ - param.min_) / (param.max_ - param.min_);
+		mean[i] = std::min(std::max(value, 0.0), 1.0);
+		spread[i] = INITIAL_SPREAD;
+	}
+
+	std::vector<TuneCandidate> generation(options_.population_);
+	std::vector<double> scaled(options_.population_ * NUM_TUNED_PARAMS);
+	std::vector<unsigned> order(options_.population_);
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+	for (unsigned g = 0; g < options_.generations_; ++g)
+	{
+		for (unsigned c = 0; c < options_.population_; ++c)
+		{
+			TuneCandidate& candidate = generation[c];
+			candidate.params_ = farmOptions_.params_;
+			candidate.generation_ = g;
+			for (unsigned i = 0; i < NUM_TUNED_PARAMS; ++i)
+			{
+				const TunedParam& param = TUNED_PARAMS[i];
+				// The first candidate of the first generation is the starting set.
+				double value = g || c ? mean[i] + spread[i] * normal(random) : mean[i];
+				value = std::min(std::max(value, 0.0), 1.0);
+				scaled[c * NUM_TUNED_PARAMS + i] = value;
+				candidate.params_.*param.member_ = (float)(param.min_ + value * (param.max_ - param.min_));
+			}
+			candidate.stats_ = Evaluate(candidate.params_);
+			KeepBest(candidate);
+			order[c] = c;
+		}
+
+		std::sort(order.begin(), order.end(), [&generation](unsigned a, unsigned b)
+		{
+			return generation[a].stats_.cost_ < generation[b].stats_.cost_;
+		});
+
+		// Refit the distribution to the elites.
+		for (unsigned i = 0; i < NUM_TUNED_PARAMS; ++i)
+		{
+			double sum = 0.0;
+			for (unsigned e = 0; e < numElites; ++e)
+			{
+				sum += scaled[order[e] * NUM_TUNED_PARAMS + i];
+			}
+			mean[i] = sum / numElites;
+			double squares = 0.0;
+			for (unsigned e = 0; e < numElites; ++e)
+			{
+				double offset = scaled[order[e] * NUM_TUNED_PARAMS + i] - mean[i];
+				squares += offset * offset;
+			}
+			spread[i] = std::max(std::sqrt(squares / numElites), MIN_SPREAD);
+		}
+
+		const CandidateStats& stats = best_[0].stats_;
+		double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		printf("Generation %u: best cost %.4f, rally %.1f sd %.1f, duration %.1f s sd %.1f, %.1f%% timeouts (%.1f s)\n", g + 1,
+			stats.cost_, stats.rallyMean_, stats.rallyDeviation_, stats.durationMean_, stats.durationDeviation_,
+			stats.timeoutFraction_ * 100.0, elapsed);
+	}
+}
+
+bool PongTuner::WriteBest() const
+{
+	for (unsigned i = 0; i < best_.size(); ++i)
+	{
+		const TuneCandidate& candidate = best_[i];
+		const CandidateStats& stats = candidate.stats_;
+		char comment[512];
+		snprintf(comment, sizeof comment, "Tuned set %u of %u, from generation %u, over %u AI matches each\n"
+			"Rally length mean %.2f sd %.2f, target %.2f sd %.2f\n"
+			"Duration mean %.2f s sd %.2f, target %.2f s sd %.2f\n"
+			"Timeouts %.2f%%, cost %.5f", i + 1, (unsigned)best_.size(), candidate.generation_ + 1, farmOptions_.matches_,
+			stats.rallyMean_, stats.rallyDeviation_, options_.rallyLength_.mean_, options_.rallyLength_.standardDeviation_,
+			stats.durationMean_, stats.durationDeviation_, options_.duration_.mean_, options_.duration_.standardDeviation_,
+			stats.timeoutFraction_ * 100.0, stats.cost_);
+
+		char path[512];
+		snprintf(path, sizeof path, "%s_%u.params", options_.output_.c_str(), i + 1);
+		if (!SaveSimParams(path, candidate.params_, comment))
+		{
+			fprintf(stderr, "Could not write %s\n", path);
+			return false;
+		}
+
+		printf("%s:", path);
+		for (unsigned j = 0; j < NUM_TUNED_PARAMS; ++j)
+		{
+			printf(" %s %.4f", TUNED_PARAMS[j].name_, candidate.params_.*TUNED_PARAMS[j].member_);
+		}
+		printf(", cost %.4f\n", stats.cost_);
+	}
+	return true;
+}
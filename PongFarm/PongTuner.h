@@ -0,0 +1,81 @@
+#pragma once
+
+#ifndef PONG_TUNER_H
+#define PONG_TUNER_H
+
+#include <string>
+#include <vector>
+
+#include "PongFarm.h"
+
+/// Desired mean and standard deviation of a per match statistic.
+struct TuneTarget
+{
+	float mean_;
+	float standardDeviation_;
+};
+
+struct TuneOptions
+{
+	TuneOptions();
+
+	unsigned generations_;
+	// Candidates played each generation.
+	unsigned population_;
+	// Fraction of each generation the next is sampled around.
+	float eliteFraction_;
+	unsigned seed_;
+	TuneTarget rallyLength_;
+	// In simulated seconds.
+	TuneTarget duration_;
+	// Number of the best sets written out, as PREFIX_1.params and so on.
+	unsigned bestSets_;
+	std::string output_;
+};
+
+/// How one parameter set played, and how far that is from the targets.
+struct CandidateStats
+{
+	double rallyMean_;
+	double rallyDeviation_;
+	double durationMean_;
+	double durationDeviation_;
+	double timeoutFraction_;
+	double cost_;
+};
+
+struct TuneCandidate
+{
+	SimParams params_;
+	CandidateStats stats_;
+	unsigned generation_;
+};
+
+/// Searches the gameplay constants for a set whose AI against AI matches
+/// have the target rally length and duration distributions. Every candidate
+/// plays a farm of matches across all cores. The search is the cross
+/// entropy method: each generation is sampled from a normal distribution
+/// per parameter, which is then refitted to the generation's best fraction.
+/// Parameters are searched scaled to their range, and the search starts
+/// from the given set.
+class PongTuner
+{
+public:
+
+	PongTuner(const FarmOptions& farmOptions, const TuneOptions& options);
+	void Run();
+	/// Write the best sets found, each with its statistics as comments.
+	bool WriteBest() const;
+
+private:
+
+	FarmOptions farmOptions_;
+	TuneOptions options_;
+	// Best first, at most bestSets_ of them.
+	std::vector<TuneCandidate> best_;
+
+	CandidateStats Evaluate(const SimParams& params) const;
+	void KeepBest(const TuneCandidate& candidate);
+};
+
+#endif
@@ -0,0 +1,92 @@
+#include "WorkRanges.h"
+
+namespace
+{
+
+unsigned long long Pack(unsigned begin, unsigned end)
+{
+	return ((unsigned long long)end << 32) | begin;
+}
+
+unsigned Begin(unsigned long long range)
+{
+	return (unsigned)range;
+}
+
+unsigned End(unsigned long long range)
+{
+	return (unsigned)(range >> 32);
+}
+
+}
+
+WorkRanges::WorkRanges(unsigned numWorkers, unsigned count) :
+	numWorkers_(numWorkers),
+	ranges_(new Range[numWorkers])
+{
+	// Start with an even split; stealing evens out the rest.
+	for (unsigned i = 0; i < numWorkers; ++i)
+	{
+		unsigned begin = (unsigned)((unsigned long long)count * i / numWorkers);
+		unsigned end = (unsigned)((unsigned long long)count * (i + 1) / numWorkers);
+		ranges_[i].value_.store(Pack(begin, end));
+		ranges_[i].steals_ = 0;
+	}
+}
+
+bool WorkRanges::Take(unsigned worker, unsigned maxCount, unsigned& begin, unsigned& end)
+{
+	std::atomic<unsigned long long>& own = ranges_[worker].value_;
+
+	for (;;)
+	{
+		unsigned long long range = own.load(std::memory_order_acquire);
+		unsigned rangeBegin = Begin(range);
+		unsigned rangeEnd = End(range);
+
+		if (rangeBegin < rangeEnd)
+		{
+			unsigned takenEnd = rangeEnd - rangeBegin > maxCount ? rangeBegin + maxCount : rangeEnd;
+			if (own.compare_exchange_weak(range, Pack(takenEnd, rangeEnd), std::memory_order_acq_rel))
+			{
+				begin = rangeBegin;
+				end = takenEnd;
+				return true;
+			}
+		}
+		else if (!Steal(worker))
+		{
+			return false;
+		}
+	}
+}
+
+/// Move the back half of the first non-empty range found into the worker's
+/// own, empty, range. Work being moved by another thief is already owned by
+/// that thief, so finding every range empty means the worker can stop.
+bool WorkRanges::Steal(unsigned worker)
+{
+	for (unsigned i = 1; i < numWorkers_; ++i)
+	{
+		std::atomic<unsigned long long>& victim = ranges_[(worker + i) % numWorkers_].value_;
+		unsigned long long range = victim.load(std::memory_order_acquire);
+
+		while (Begin(range) < End(range))
+		{
+			unsigned rangeBegin = Begin(range);
+			unsigned rangeEnd = End(range);
+			unsigned middle = rangeEnd - (rangeEnd - rangeBegin + 1) / 2;
+
+			if (victim.compare_exchange_weak(range, Pack(rangeBegin, middle), std::memory_order_acq_rel))
+			{
+				// Nobody else writes to an empty range, and an index is never
+				// handed out twice, so a plain store cannot lose work.
+				ranges_[worker].value_.store(Pack(middle, rangeEnd), std::memory_order_release);
+				++ranges_[worker].steals_;
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#ifndef PONG_WORK_RANGES_H
+#define PONG_WORK_RANGES_H
+
+#include <atomic>
+#include <memory>
+
+/// Hands the indices [0, count) out to a fixed set of workers without locks.
+/// Each worker takes indices from the front of its own range, and a worker
+/// whose range is empty steals the back half of another worker's range. A
+/// range is packed into one 64-bit atomic, so taking and stealing are each a
+/// single compare and swap.
+class WorkRanges
+{
+public:
+
+	WorkRanges(unsigned numWorkers, unsigned count);
+	/// Take up to maxCount indices for a worker, stealing if its own range is
+	/// empty. Returns false once there is no work left anywhere.
+	bool Take(unsigned worker, unsigned maxCount, unsigned& begin, unsigned& end);
+	unsigned GetNumSteals(unsigned worker) const { return ranges_[worker].steals_; }
+
+private:
+
+	// Padded to a cache line, so that workers taking from their own ranges
+	// do not contend with each other.
+	struct Range
+	{
+		std::atomic<unsigned long long> value_;
+		unsigned steals_;
+		char padding_[64 - sizeof(std::atomic<unsigned long long>) - sizeof(unsigned)];
+	};
+
+	unsigned numWorkers_;
+	std::unique_ptr<Range[]> ranges_;
+
+	bool Steal(unsigned worker);
+};
+
+#endif
@@ -0,0 +1,682 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "PongServer.h"
+#include "PongSim/SimParamsFile.h"
+
+// Matches a worker takes from the shared counter at a time. Small, so that a
+// match that runs long delays few others, but more than one, so that the
+// workers are not all contending for the counter.
+const unsigned MATCH_GRAIN = 4;
+
+// A client that sends nothing for this many seconds has left.
+const double CLIENT_TIMEOUT = 5.0;
+
+// Seconds between looks for clients that have left.
+const double EXPIRY_INTERVAL = 1.0;
+
+// Every client shares the one socket, so a full receive buffer drops
+// packets from all of them alike.
+const unsigned SOCKET_BUFFER_SIZE = 4 << 20;
+
+// Most matches the protocol can tell apart.
+const unsigned MAX_MATCHES = 65536;
+
+// Frames the allocation check lets the server settle for before counting.
+const unsigned long long ALLOCATION_WARM_UP_FRAMES = 120;
+
+ServerOptions::ServerOptions() :
+	port_(DEFAULT_SERVER_PORT),
+	capacity_(1024),
+	botMatches_(0),
+	threads_(0),
+	timeStep_(1.0f / 60.0f),
+	matchBudget_(1000),
+	maxLagTicks_(8),
+	duration_(0.0f),
+	reportInterval_(5.0f),
+	seed_(1),
+	allocationCheck_(false)
+{
+}
+
+ServerStats::ServerStats() :
+	frames_(0),
+	ticks_(0),
+	overruns_(0),
+	droppedTicks_(0),
+	packetsIn_(0),
+	packetsOut_(0),
+	rejectedPackets_(0),
+	refusedClients_(0),
+	stepTime_(0.0),
+	maxFrameStepTime_(0.0),
+	allocatingFrames_(0),
+	frameAllocations_(0),
+	frameAllocatedBytes_(0)
+{
+}
+
+PongServer::PongServer(const ServerOptions& options) :
+	options_(options),
+	ticksScheduled_(0),
+	matchesOpened_(0),
+	openMatch_(-1),
+	nextExpiry_(0.0),
+	frame_(0),
+	busyWorkers_(0),
+	quit_(false),
+	nextMatch_(0)
+{
+	if (!options_.threads_)
+	{
+		options_.threads_ = std::max(std::thread::hardware_concurrency(), 1U);
+	}
+	options_.capacity_ = std::min(std::max(options_.capacity_, options_.botMatches_), MAX_MATCHES);
+	options_.maxLagTicks_ = std::max(options_.maxLagTicks_, 1U);
+
+	// Every match shares the arena, laid out once here and copied into the
+	// pool; nothing is allocated when a match is created.
+	PongSim layout(options_.params_);
+	Match match;
+	match.sim_ = layout;
+	match.inUse_ = false;
+	match.bot_ = false;
+	matches_.resize(options_.capacity_, match);
+	freeMatches_.reserve(options_.capacity_);
+	for (unsigned i = options_.capacity_; i-- > 0;)
+	{
+		freeMatches_.push_back(i);
+	}
+	activeMatches_.reserve(options_.capacity_);
+	clients_.Reserve(options_.capacity_ * NUM_PLAYERS);
+}
+
+PongServer::~PongServer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		quit_ = true;
+	}
+	frameReady_.notify_all();
+	for (unsigned i = 0; i < workers_.size(); ++i)
+	{
+		workers_[i].join();
+	}
+}
+
+bool PongServer::Start()
+{
+	if (!socket_.Open(options_.port_, SOCKET_BUFFER_SIZE))
+	{
+		return false;
+	}
+
+	for (unsigned i = 0; i < options_.botMatches_; ++i)
+	{
+		CreateMatch(true);
+	}
+	for (unsigned i = 1; i < options_.threads_; ++i)
+	{
+		workers_.push_back(std::thread(&PongServer::WorkerLoop, this));
+	}
+
+	startTime_ = Clock::now();
+	printf("Serving on port %u: %u matches, %u of them bots, on %u threads at %.0f Hz\n", options_.port_, options_.capacity_,
+		options_.botMatches_, options_.threads_, 1.0f / options_.timeStep_);
+	return true;
+}
+
+void PongServer::Run()
+{
+	ServerStats lastStats = stats_;
+	double lastReport = 0.0;
+
+	for (;;)
+	{
+		double now = GetTime();
+		if (options_.duration_ > 0.0f && now >= options_.duration_)
+		{
+			break;
+		}
+
+		ReceivePackets(now);
+		if (now >= nextExpiry_)
+		{
+			ExpireClients(now);
+			nextExpiry_ = now + EXPIRY_INTERVAL;
+		}
+
+		unsigned long long due = (unsigned long long)(now / options_.timeStep_);
+		if (due <= ticksScheduled_)
+		{
+			// Wake for input as it arrives, or for the next tick.
+			double untilTick = (ticksScheduled_ + 1) * (double)options_.timeStep_ - now;
+			socket_.Wait((unsigned)(untilTick * 1000.0) + 1);
+			continue;
+		}
+
+		StepFrame(due - ticksScheduled_);
+		ticksScheduled_ = due;
+		SendUpdates();
+		if (options_.allocationCheck_)
+		{
+			CheckAllocations();
+		}
+
+		if (options_.reportInterval_ > 0.0f && now - lastReport >= options_.reportInterval_)
+		{
+			PrintStatus(now, lastStats, lastReport);
+			lastStats = stats_;
+			lastReport = now;
+		}
+	}
+}
+
+void PongServer::Report() const
+{
+	double elapsed = std::max(GetTime(), 1e-9);
+	double frames = (double)std::max(stats_.frames_, 1ULL);
+	printf("Served %.1f s: %llu frames, %llu match ticks (%.0f/s)\n", elapsed, stats_.frames_, stats_.ticks_,
+		stats_.ticks_ / elapsed);
+	printf("Stepping took %.3f ms per frame on average, %.3f ms at most\n", stats_.stepTime_ * 1000.0 / frames,
+		stats_.maxFrameStepTime_ * 1000.0);
+	printf("%llu budget overruns, %llu ticks dropped\n", stats_.overruns_, stats_.droppedTicks_);
+	printf("%llu packets in, %llu out, %llu rejected, %llu clients refused\n", stats_.packetsIn_, stats_.packetsOut_,
+		stats_.rejectedPackets_, stats_.refusedClients_);
+
+	if (options_.allocationCheck_)
+	{
+		unsigned long long checked = stats_.frames_ > ALLOCATION_WARM_UP_FRAMES ? stats_.frames_ - ALLOCATION_WARM_UP_FRAMES : 0;
+		printf("Allocation check: %llu of %llu frames after warming up allocated, %llu allocations, %llu bytes\n",
+			stats_.allocatingFrames_, checked, stats_.frameAllocations_, stats_.frameAllocatedBytes_);
+		if (stats_.allocatingFrames_)
+		{
+			ReportAllocationSites(stdout, 10);
+		}
+	}
+}
+
+double PongServer::GetTime() const
+{
+	return std::chrono::duration<double>(Clock::now() - startTime_).count();
+}
+
+/// Take a match from the pool, with both seats played by the AI. Returns -1
+/// if the pool is empty.
+int PongServer::CreateMatch(bool bot)
+{
+	if (freeMatches_.empty())
+	{
+		return -1;
+	}
+
+	unsigned index = freeMatches_.back();
+	freeMatches_.pop_back();
+	activeMatches_.push_back(index);
+
+	Match& match = matches_[index];
+	unsigned matchSeed = PongSim::MixSeed(options_.seed_, matchesOpened_++);
+	match.sim_.Reset();
+	match.sim_.SetRandomSeed(PongSim::MixSeed(matchSeed, SEED_SERVES));
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		match.ai_[i] = InterceptAi((SimPlayer)i, options_.aiParams_, PongSim::MixSeed(matchSeed, SEED_PLAYER_ONE + i));
+		Seat& seat = match.seats_[i];
+		seat.endpoint_ = 0;
+		seat.human_ = false;
+		seat.lastSequence_ = 0;
+		seat.lastHeard_ = 0.0;
+		seat.batDirection_ = 0;
+		seat.startPending_ = false;
+	}
+	match.inUse_ = true;
+	match.bot_ = bot;
+	match.tick_ = 0;
+	match.pendingTicks_ = 0;
+	match.steppedTicks_ = 0;
+	match.overran_ = false;
+	return (int)index;
+}
+
+void PongServer::DestroyMatch(unsigned index)
+{
+	matches_[index].inUse_ = false;
+	freeMatches_.push_back(index);
+	activeMatches_.erase(std::find(activeMatches_.begin(), activeMatches_.end(), index));
+	if (openMatch_ == (int)index)
+	{
+		openMatch_ = -1;
+	}
+}
+
+/// Give a new client the free seat of the open match, or player one of a new
+/// match, whose other seat the AI plays until a second client arrives.
+bool PongServer::SeatClient(UdpEndpoint endpoint, double now, unsigned& seat)
+{
+	if (openMatch_ < 0)
+	{
+		openMatch_ = CreateMatch(false);
+		if (openMatch_ < 0)
+		{
+			++stats_.refusedClients_;
+			return false;
+		}
+	}
+
+	Match& match = matches_[openMatch_];
+	int player = match.seats_[PLAYER_ONE].human_ ? PLAYER_TWO : PLAYER_ONE;
+	Seat& taken = match.seats_[player];
+	taken.endpoint_ = endpoint;
+	taken.human_ = true;
+	taken.lastSequence_ = 0;
+	taken.lastHeard_ = now;
+	taken.batDirection_ = 0;
+	taken.startPending_ = false;
+
+	seat = (unsigned)openMatch_ * NUM_PLAYERS + player;
+	clients_.Insert(endpoint, seat);
+
+	char address[32];
+	UdpSocket::FormatEndpoint(endpoint, address, sizeof address);
+	printf("%s plays match %d as player %s\n", address, openMatch_, player == PLAYER_ONE ? "one" : "two");
+
+	if (match.seats_[PLAYER_ONE].human_ && match.seats_[PLAYER_TWO].human_)
+	{
+		openMatch_ = -1;
+	}
+	return true;
+}
+
+/// Apply every waiting input to its seat. Only runs between frames, so the
+/// workers never see a seat change under them.
+void PongServer::ReceivePackets(double now)
+{
+	unsigned char packet[SERVER_INPUT_PACKET_SIZE + 1];
+	UdpEndpoint endpoint;
+	unsigned size;
+
+	while ((size = socket_.Receive(packet, sizeof packet, endpoint)) > 0)
+	{
+		++stats_.packetsIn_;
+		ServerInput input;
+		if (!ReadServerInput(packet, size, input))
+		{
+			++stats_.rejectedPackets_;
+			continue;
+		}
+
+		unsigned index;
+		if (!clients_.Find(endpoint, index) && !SeatClient(endpoint, now, index))
+		{
+			continue;
+		}
+
+		Seat& seat = matches_[index / NUM_PLAYERS].seats_[index % NUM_PLAYERS];
+		seat.lastHeard_ = now;
+		if (input.sequence_ > seat.lastSequence_)
+		{
+			seat.lastSequence_ = input.sequence_;
+			seat.batDirection_ = input.batDirection_;
+			seat.startPending_ = seat.startPending_ || input.start_;
+		}
+	}
+}
+
+/// Hand the seats of clients that have gone quiet back to the AI, and free
+/// matches left with no clients at all.
+void PongServer::ExpireClients(double now)
+{
+	// Backwards, as freeing a match takes it out of the list.
+	for (unsigned i = (unsigned)activeMatches_.size(); i-- > 0;)
+	{
+		unsigned index = activeMatches_[i];
+		Match& match = matches_[index];
+		bool left = false;
+		for (int j = 0; j < NUM_PLAYERS; ++j)
+		{
+			Seat& seat = match.seats_[j];
+			if (!seat.human_ || now - seat.lastHeard_ < CLIENT_TIMEOUT)
+			{
+				continue;
+			}
+
+			char address[32];
+			UdpSocket::FormatEndpoint(seat.endpoint_, address, sizeof address);
+			printf("%s left match %u\n", address, index);
+
+			seat.human_ = false;
+			clients_.Erase(seat.endpoint_);
+			left = true;
+		}
+
+		if (!left)
+		{
+			continue;
+		}
+		if (!match.seats_[PLAYER_ONE].human_ && !match.seats_[PLAYER_TWO].human_)
+		{
+			DestroyMatch(index);
+		}
+		else if (openMatch_ < 0)
+		{
+			openMatch_ = (int)index;
+		}
+	}
+}
+
+/// Give every match the ticks that have come due, and step them all across
+/// the workers and this thread.
+void PongServer::StepFrame(unsigned long long ticks)
+{
+	for (unsigned i = 0; i < activeMatches_.size(); ++i)
+	{
+		Match& match = matches_[activeMatches_[i]];
+		unsigned long long pending = match.pendingTicks_ + ticks;
+		if (pending > options_.maxLagTicks_)
+		{
+			stats_.droppedTicks_ += pending - options_.maxLagTicks_;
+			pending = options_.maxLagTicks_;
+		}
+		match.pendingTicks_ = (unsigned)pending;
+	}
+
+	Clock::time_point start = Clock::now();
+	nextMatch_ = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		busyWorkers_ = (unsigned)workers_.size();
+		++frame_;
+	}
+	frameReady_.notify_all();
+
+	StepMatches();
+
+	{
+		std::unique_lock<std::mutex> lock(mutex_);
+		frameDone_.wait(lock, [this]() { return !busyWorkers_; });
+	}
+
+	double stepTime = std::chrono::duration<double>(Clock::now() - start).count();
+	++stats_.frames_;
+	stats_.stepTime_ += stepTime;
+	stats_.maxFrameStepTime_ = std::max(stats_.maxFrameStepTime_, stepTime);
+}
+
+void PongServer::WorkerLoop()
+{
+	unsigned frame = 0;
+	for (;;)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			frameReady_.wait(lock, [this, frame]() { return quit_ || frame_ != frame; });
+			if (quit_)
+			{
+				return;
+			}
+			frame = frame_;
+		}
+
+		StepMatches();
+
+		std::lock_guard<std::mutex> lock(mutex_);
+		if (!--busyWorkers_)
+		{
+			frameDone_.notify_one();
+		}
+	}
+}
+
+void PongServer::StepMatches()
+{
+	unsigned count = (unsigned)activeMatches_.size();
+	unsigned begin;
+	while ((begin = nextMatch_.fetch_add(MATCH_GRAIN)) < count)
+	{
+		unsigned end = std::min(begin + MATCH_GRAIN, count);
+		for (unsigned i = begin; i < end; ++i)
+		{
+			StepMatch(activeMatches_[i]);
+		}
+	}
+}
+
+/// Step the match's pending ticks until its budget runs out, and write the
+/// update for each of its clients.
+void PongServer::StepMatch(unsigned index)
+{
+	Match& match = matches_[index];
+	Clock::time_point budgetEnd = Clock::now() + std::chrono::microseconds(options_.matchBudget_);
+	match.steppedTicks_ = 0;
+	match.overran_ = false;
+
+	while (match.pendingTicks_)
+	{
+		StepTick(match);
+		--match.pendingTicks_;
+		++match.steppedTicks_;
+		if (match.pendingTicks_ && Clock::now() >= budgetEnd)
+		{
+			match.overran_ = true;
+			break;
+		}
+	}
+
+	if (!match.steppedTicks_)
+	{
+		return;
+	}
+
+	ServerUpdate update;
+	update.match_ = (unsigned short)index;
+	update.tick_ = match.tick_;
+	update.state_ = match.sim_.GetState();
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		if (match.seats_[i].human_)
+		{
+			update.player_ = (unsigned char)i;
+			WriteServerUpdate(match.updates_[i], update);
+		}
+	}
+}
+
+/// A game starts when a client asks for one, or straight away in a bot
+/// match. Seats without a client are played by the AI.
+void PongServer::StepTick(Match& match)
+{
+	PongSim& sim = match.sim_;
+	bool start = match.bot_;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		start = start || match.seats_[i].startPending_;
+		match.seats_[i].startPending_ = false;
+	}
+	if (start && !sim.GetState().gameRunning_)
+	{
+		sim.StartGame();
+	}
+
+	SimInput input;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		const Seat& seat = match.seats_[i];
+		input.batDirection_[i] = seat.human_ ? seat.batDirection_ : match.ai_[i].Update(sim, options_.timeStep_);
+	}
+	sim.Step(options_.timeStep_, input);
+	++match.tick_;
+}
+
+void PongServer::SendUpdates()
+{
+	for (unsigned i = 0; i < activeMatches_.size(); ++i)
+	{
+		Match& match = matches_[activeMatches_[i]];
+		stats_.ticks_ += match.steppedTicks_;
+		stats_.overruns_ += match.overran_ ? 1 : 0;
+		if (!match.steppedTicks_)
+		{
+			continue;
+		}
+
+		for (int j = 0; j < NUM_PLAYERS; ++j)
+		{
+			if (match.seats_[j].human_)
+			{
+				socket_.Send(match.updates_[j], SERVER_UPDATE_PACKET_SIZE, match.seats_[j].endpoint_);
+				++stats_.packetsOut_;
+			}
+		}
+	}
+}
+
+/// Count what every thread allocated since the last frame, the waiting and
+/// taking in of input included. The sites are only kept from the end of the
+/// warm up.
+void PongServer::CheckAllocations()
+{
+	AllocationCounts counts = GetAllocationCounts();
+	if (stats_.frames_ == ALLOCATION_WARM_UP_FRAMES)
+	{
+		ClearAllocationSites();
+	}
+	else if (stats_.frames_ > ALLOCATION_WARM_UP_FRAMES && counts.allocations_ != lastAllocations_.allocations_)
+	{
+		++stats_.allocatingFrames_;
+		stats_.frameAllocations_ += counts.allocations_ - lastAllocations_.allocations_;
+		stats_.frameAllocatedBytes_ += counts.bytes_ - lastAllocations_.bytes_;
+	}
+	lastAllocations_ = counts;
+}
+
+void PongServer::PrintStatus(double now, const ServerStats& last, double lastTime) const
+{
+	double elapsed = std::max(now - lastTime, 1e-9);
+	double frames = (double)std::max(stats_.frames_ - last.frames_, 1ULL);
+	printf("%.0f s: %u matches, %u clients, %.0f ticks/s, %.3f ms stepping per frame, %llu overruns, %llu dropped\n", now,
+		(unsigned)activeMatches_.size(), clients_.Size(), (stats_.ticks_ - last.ticks_) / elapsed,
+		(stats_.stepTime_ - last.stepTime_) * 1000.0 / frames, stats_.overruns_ - last.overruns_,
+		stats_.droppedTicks_ - last.droppedTicks_);
+}
+
+static void PrintUsage()
+{
+	printf("Usage: PongServer [options]\n"
+		"  -port N          UDP port to serve on\n"
+		"  -capacity N      matches allocated up front\n"
+		"  -bots N          matches played by the AI on both sides, for load\n"
+		"  -threads N       threads stepping matches, 0 for one per hardware\n"
+		"                   thread\n"
+		"  -tickrate HZ     ticks per second of every match\n"
+		"  -budget US       most microseconds a match may step for in a frame\n"
+		"  -maxlag N        ticks a match may fall behind before dropping some\n"
+		"  -duration S      stop after this many seconds, 0 to run until killed\n"
+		"  -report S        seconds between status lines, 0 for none\n"
+		"  -seed N          seed every match's seeds are derived from\n"
+		"  -params FILE     load gameplay constants from a parameter file\n"
+		"  -fixedpoint      simulate in deterministic Q16.16 fixed point\n"
+		"  -aireaction S    the AI's reaction time in seconds\n"
+		"  -ainoise U       most the AI's aim is off by, in world units\n"
+		"  -allocationcheck fail if anything allocates once warmed up; needs a\n"
+		"                   build with PONG_TRACK_ALLOCATIONS\n");
+}
+
+int main(int argc, char** argv)
+{
+	ServerOptions options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (!strcmp(argument, "-port") && hasValue)
+		{
+			options.port_ = (unsigned short)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-capacity") && hasValue)
+		{
+			options.capacity_ = std::max((unsigned)strtoul(argv[++i], 0, 10), 1U);
+		}
+		else if (!strcmp(argument, "-bots") && hasValue)
+		{
+			options.botMatches_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-threads") && hasValue)
+		{
+			options.threads_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-tickrate") && hasValue)
+		{
+			options.timeStep_ = 1.0f / std::max((float)atof(argv[++i]), 1.0f);
+		}
+		else if (!strcmp(argument, "-budget") && hasValue)
+		{
+			options.matchBudget_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-maxlag") && hasValue)
+		{
+			options.maxLagTicks_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-duration") && hasValue)
+		{
+			options.duration_ = std::max((float)atof(argv[++i]), 0.0f);
+		}
+		else if (!strcmp(argument, "-report") && hasValue)
+		{
+			options.reportInterval_ = std::max((float)atof(argv[++i]), 0.0f);
+		}
+		else if (!strcmp(argument, "-seed") && hasValue)
+		{
+			options.seed_ = (unsigned)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-params") && hasValue)
+		{
+			const char* path = argv[++i];
+			if (!LoadSimParams(path, options.params_))
+			{
+				fprintf(stderr, "Could not load parameters from %s\n", path);
+				return EXIT_FAILURE;
+			}
+		}
+		else if (!strcmp(argument, "-fixedpoint"))
+		{
+			options.params_.fixedPoint_ = true;
+		}
+		else if (!strcmp(argument, "-aireaction") && hasValue)
+		{
+			options.aiParams_.reactionTime_ = std::max((float)atof(argv[++i]), 0.0f);
+		}
+		else if (!strcmp(argument, "-ainoise") && hasValue)
+		{
+			options.aiParams_.noise_ = std::max((float)atof(argv[++i]), 0.0f);
+		}
+		else if (!strcmp(argument, "-allocationcheck"))
+		{
+#ifdef PONG_TRACK_ALLOCATIONS
+			options.allocationCheck_ = true;
+#else
+			fprintf(stderr, "-allocationcheck needs a build with PONG_TRACK_ALLOCATIONS\n");
+			return EXIT_FAILURE;
+#endif
+		}
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	PongServer server(options);
+	if (!server.Start())
+	{
+		fprintf(stderr, "Could not open port %u\n", options.port_);
+		return EXIT_FAILURE;
+	}
+	server.Run();
+	server.Report();
+	return server.PassedAllocationCheck() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#ifndef PONG_SERVER_H
+#define PONG_SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "PongSim/AllocationTracker.h"
+#include "PongSim/EndpointMap.h"
+#include "PongSim/InterceptAi.h"
+#include "PongSim/ServerProtocol.h"
+#include "PongSim/UdpSocket.h"
+
+struct ServerOptions
+{
+	ServerOptions();
+
+	unsigned short port_;
+	// Matches allocated up front. Clients beyond them are turned away.
+	unsigned capacity_;
+	// Matches played by the AI on both sides for as long as the server
+	// runs, to load it without clients.
+	unsigned botMatches_;
+	// Zero uses every hardware thread. The main thread is one of them.
+	unsigned threads_;
+	float timeStep_;
+	// Most time in microseconds a match may spend stepping in one server
+	// frame; the rest of its ticks wait for the next frame.
+	unsigned matchBudget_;
+	// Ticks a match may fall behind before the oldest are dropped.
+	unsigned maxLagTicks_;
+	// Seconds to run for, or 0 to run until killed.
+	float duration_;
+	// Seconds between status lines.
+	float reportInterval_;
+	unsigned seed_;
+	SimParams params_;
+	AiParams aiParams_;
+	// Count the frames that allocate after warming up, which needs a build
+	// with PONG_TRACK_ALLOCATIONS.
+	bool allocationCheck_;
+};
+
+struct ServerStats
+{
+	ServerStats();
+
+	unsigned long long frames_;
+	unsigned long long ticks_;
+	// Times a match ran out of budget within a frame.
+	unsigned long long overruns_;
+	unsigned long long droppedTicks_;
+	unsigned long long packetsIn_;
+	unsigned long long packetsOut_;
+	unsigned long long rejectedPackets_;
+	unsigned long long refusedClients_;
+	// Seconds spent stepping matches, in total and in the longest frame.
+	double stepTime_;
+	double maxFrameStepTime_;
+	// Frames after warming up in which any thread allocated, and what they
+	// allocated, with the allocation check on.
+	unsigned long long allocatingFrames_;
+	unsigned long long frameAllocations_;
+	unsigned long long frameAllocatedBytes_;
+};
+
+/// Hosts many matches in one process, each a PongSim with its two seats
+/// played by remote clients or by InterceptAi. Matches come from a pool
+/// allocated at start, and are reset rather than rebuilt when reused.
+///
+/// Every match keeps to the same fixed tick. The main thread takes in input
+/// between frames; in a frame, the matches that are due are stepped across
+/// a pool of worker threads, which take them a few at a time from a shared
+/// counter, and each match then stops at its time budget, so that one slow
+/// match neither holds up a whole share of the others nor the frame. The
+/// states are then sent to the clients from the main thread.
+class PongServer
+{
+public:
+
+	explicit PongServer(const ServerOptions& options);
+	~PongServer();
+
+	/// Open the port, start the workers and the bot matches.
+	bool Start();
+	/// Serve until the duration has passed.
+	void Run();
+	void Report() const;
+	/// Whether the allocation check, if on, found nothing allocating.
+	bool PassedAllocationCheck() const { return !stats_.allocatingFrames_; }
+	const ServerStats& GetStats() const { return stats_; }
+
+private:
+
+	typedef std::chrono::steady_clock Clock;
+
+	struct Seat
+	{
+		UdpEndpoint endpoint_;
+		bool human_;
+		unsigned lastSequence_;
+		double lastHeard_;
+		signed char batDirection_;
+		bool startPending_;
+	};
+
+	struct Match
+	{
+		PongSim sim_;
+		InterceptAi ai_[NUM_PLAYERS];
+		Seat seats_[NUM_PLAYERS];
+		bool inUse_;
+		bool bot_;
+		unsigned tick_;
+		unsigned pendingTicks_;
+		// What the last frame did, for the main thread to gather.
+		unsigned steppedTicks_;
+		bool overran_;
+		// Written by the worker that stepped the match, one per seat.
+		unsigned char updates_[NUM_PLAYERS][SERVER_UPDATE_PACKET_SIZE];
+	};
+
+	ServerOptions options_;
+	UdpSocket socket_;
+	Clock::time_point startTime_;
+	unsigned long long ticksScheduled_;
+	// Matches opened so far, each seeded from its number.
+	unsigned matchesOpened_;
+
+	std::vector<Match> matches_;
+	std::vector<unsigned> freeMatches_;
+	// Matches in use, in the order the workers take them.
+	std::vector<unsigned> activeMatches_;
+	// Seated clients, to match index times NUM_PLAYERS plus player.
+	EndpointMap clients_;
+	// A client match with a seat left for the next client, or -1.
+	int openMatch_;
+	double nextExpiry_;
+
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	std::condition_variable frameReady_;
+	std::condition_variable frameDone_;
+	unsigned frame_;
+	unsigned busyWorkers_;
+	bool quit_;
+	std::atomic<unsigned> nextMatch_;
+
+	ServerStats stats_;
+	AllocationCounts lastAllocations_;
+
+	double GetTime() const;
+	int CreateMatch(bool bot);
+	void DestroyMatch(unsigned index);
+	bool SeatClient(UdpEndpoint endpoint, double now, unsigned& seat);
+	void ReceivePackets(double now);
+	void ExpireClients(double now);
+	void StepFrame(unsigned long long ticks);
+	void WorkerLoop();
+	void StepMatches();
+	void StepMatch(unsigned index);
+	void StepTick(Match& match);
+	void SendUpdates();
+	void CheckAllocations();
+	void PrintStatus(double now, const ServerStats& last, double lastTime) const;
+};
+
+#endif
@@ -0,0 +1,328 @@
+#ifdef PONG_TRACK_ALLOCATIONS
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__GNUC__) && !defined(_WIN32)
+#include <cxxabi.h>
+#include <execinfo.h>
+#define PONG_ALLOCATION_STACKS
+#define PONG_NOINLINE __attribute__((noinline))
+#else
+#define PONG_NOINLINE
+#endif
+
+#include "AllocationTracker.h"
+
+// Frames kept of the stack above operator new.
+const unsigned SITE_FRAMES = 6;
+// Frames of the tracker itself at the top of every stack: Allocate() and
+// operator new.
+const unsigned TRACKER_FRAMES = 2;
+// Distinct sites recorded; allocations from sites beyond them are only
+// counted.
+const unsigned MAX_SITES = 4096;
+// Distinct scopes summed up in a report.
+const unsigned MAX_REPORT_SCOPES = 64;
+
+/// Where allocations were made from: the scope they were made in and the
+/// return addresses above operator new.
+struct AllocationSite
+{
+	const char* scope_;
+	void* frames_[SITE_FRAMES];
+	unsigned numFrames_;
+	unsigned long long allocations_;
+	unsigned long long bytes_;
+	bool used_;
+};
+
+// Everything here is plain data or constant initialized, so it is ready for
+// allocations made before any constructor has run.
+static std::atomic<unsigned long long> totalAllocations(0);
+static std::atomic<unsigned long long> totalBytes(0);
+static thread_local unsigned long long threadAllocations;
+static thread_local unsigned long long threadBytes;
+static thread_local const char* currentScope;
+// Set while the tracker itself may allocate, so that it does not record
+// itself.
+static thread_local bool inTracker;
+
+static AllocationSite sites[MAX_SITES];
+static unsigned long long unrecordedAllocations;
+static std::atomic_flag sitesLock = ATOMIC_FLAG_INIT;
+
+static void LockSites()
+{
+	while (sitesLock.test_and_set(std::memory_order_acquire))
+	{
+	}
+}
+
+static void UnlockSites()
+{
+	sitesLock.clear(std::memory_order_release);
+}
+
+static void RecordSite(std::size_t size)
+{
+	AllocationSite site;
+	site.scope_ = currentScope;
+	site.numFrames_ = 0;
+#ifdef PONG_ALLOCATION_STACKS
+	void* frames[SITE_FRAMES + TRACKER_FRAMES];
+	int numFrames = backtrace(frames, SITE_FRAMES + TRACKER_FRAMES);
+	for (int i = TRACKER_FRAMES; i < numFrames; ++i)
+	{
+		site.frames_[site.numFrames_++] = frames[i];
+	}
+#endif
+
+	// FNV-1a over the scope and the frames.
+	size_t hash = 2166136261u;
+	hash = (hash ^ (size_t)site.scope_) * 16777619u;
+	for (unsigned i = 0; i < site.numFrames_; ++i)
+	{
+		hash = (hash ^ (size_t)site.frames_[i]) * 16777619u;
+	}
+
+	LockSites();
+	for (unsigned probe = 0; probe < MAX_SITES; ++probe)
+	{
+		AllocationSite& entry = sites[(hash + probe) % MAX_SITES];
+		if (!entry.used_)
+		{
+			entry = site;
+			entry.used_ = true;
+			entry.allocations_ = 1;
+			entry.bytes_ = size;
+			UnlockSites();
+			return;
+		}
+		if (entry.scope_ == site.scope_ && entry.numFrames_ == site.numFrames_ &&
+			std::equal(site.frames_, site.frames_ + site.numFrames_, entry.frames_))
+		{
+			++entry.allocations_;
+			entry.bytes_ += size;
+			UnlockSites();
+			return;
+		}
+	}
+	++unrecordedAllocations;
+	UnlockSites();
+}
+
+static PONG_NOINLINE void* Allocate(std::size_t size)
+{
+	void* memory = malloc(size ? size : 1);
+	if (!memory)
+	{
+		return 0;
+	}
+
+	totalAllocations.fetch_add(1, std::memory_order_relaxed);
+	totalBytes.fetch_add(size, std::memory_order_relaxed);
+	++threadAllocations;
+	threadBytes += size;
+	if (!inTracker)
+	{
+		inTracker = true;
+		RecordSite(size);
+		inTracker = false;
+	}
+	return memory;
+}
+
+void* operator new(std::size_t size)
+{
+	void* memory = Allocate(size);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new[](std::size_t size)
+{
+	void* memory = Allocate(size);
+	if (!memory)
+	{
+		throw std::bad_alloc();
+	}
+	return memory;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+	return Allocate(size);
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+	free(memory);
+}
+
+AllocationCounts GetAllocationCounts()
+{
+	AllocationCounts counts;
+	counts.allocations_ = totalAllocations.load(std::memory_order_relaxed);
+	counts.bytes_ = totalBytes.load(std::memory_order_relaxed);
+	return counts;
+}
+
+AllocationCounts GetThreadAllocationCounts()
+{
+	AllocationCounts counts;
+	counts.allocations_ = threadAllocations;
+	counts.bytes_ = threadBytes;
+	return counts;
+}
+
+void ClearAllocationSites()
+{
+	LockSites();
+	for (unsigned i = 0; i < MAX_SITES; ++i)
+	{
+		sites[i].used_ = false;
+	}
+	unrecordedAllocations = 0;
+	UnlockSites();
+}
+
+/// Print a frame as its demangled function and offset where it can be
+/// named, and as the raw entry otherwise.
+static void PrintFrame(FILE* file, void* frame)
+{
+#ifdef PONG_ALLOCATION_STACKS
+	char** symbols = backtrace_symbols(&frame, 1);
+	if (!symbols)
+	{
+		fprintf(file, "      %p\n", frame);
+		return;
+	}
+	// Entries look like "binary(mangled+0x1f) [0x4011d6]".
+	char* name = strchr(symbols[0], '(');
+	char* offset = name ? strchr(name, '+') : 0;
+	char* demangled = 0;
+	if (name && offset && offset > name + 1)
+	{
+		*offset = '\0';
+		int status;
+		demangled = abi::__cxa_demangle(name + 1, 0, 0, &status);
+		*offset = '+';
+	}
+	if (demangled)
+	{
+		char* end = strchr(offset, ')');
+		fprintf(file, "      %s%.*s\n", demangled, end ? (int)(end - offset) : 0, offset);
+		free(demangled);
+	}
+	else
+	{
+		fprintf(file, "      %s\n", symbols[0]);
+	}
+	free(symbols);
+#else
+	fprintf(file, "      %p\n", frame);
+#endif
+}
+
+void ReportAllocationSites(FILE* file, unsigned maxSites)
+{
+	inTracker = true;
+
+	// Take a copy, so that other threads can go on allocating.
+	static AllocationSite copy[MAX_SITES];
+	static unsigned order[MAX_SITES];
+	LockSites();
+	std::copy(sites, sites + MAX_SITES, copy);
+	unsigned long long unrecorded = unrecordedAllocations;
+	UnlockSites();
+
+	unsigned numSites = 0;
+	const char* scopes[MAX_REPORT_SCOPES];
+	AllocationCounts scopeCounts[MAX_REPORT_SCOPES];
+	unsigned numScopes = 0;
+	for (unsigned i = 0; i < MAX_SITES; ++i)
+	{
+		if (!copy[i].used_)
+		{
+			continue;
+		}
+		order[numSites++] = i;
+		unsigned scope = (unsigned)(std::find(scopes, scopes + numScopes, copy[i].scope_) - scopes);
+		if (scope == numScopes && numScopes < MAX_REPORT_SCOPES)
+		{
+			scopes[numScopes] = copy[i].scope_;
+			scopeCounts[numScopes++] = AllocationCounts();
+		}
+		if (scope < numScopes)
+		{
+			scopeCounts[scope].allocations_ += copy[i].allocations_;
+			scopeCounts[scope].bytes_ += copy[i].bytes_;
+		}
+	}
+
+	fprintf(file, "Allocations by scope:\n");
+	for (unsigned i = 0; i < numScopes; ++i)
+	{
+		fprintf(file, "  %-24s %10llu allocations %12llu bytes\n", scopes[i] ? scopes[i] : "(no scope)",
+			scopeCounts[i].allocations_, scopeCounts[i].bytes_);
+	}
+
+	std::sort(order, order + numSites, [](unsigned left, unsigned right)
+	{
+		return copy[left].allocations_ > copy[right].allocations_;
+	});
+	fprintf(file, "Allocation sites, most frequent first (%u sites, %llu allocations from sites past the table):\n",
+		numSites, unrecorded);
+	for (unsigned i = 0; i < numSites && i < maxSites; ++i)
+	{
+		const AllocationSite& site = copy[order[i]];
+		fprintf(file, "  %llu allocations, %llu bytes in %s\n", site.allocations_, site.bytes_,
+			site.scope_ ? site.scope_ : "(no scope)");
+		for (unsigned j = 0; j < site.numFrames_; ++j)
+		{
+			PrintFrame(file, site.frames_[j]);
+		}
+	}
+
+	inTracker = false;
+}
+
+AllocationScope::AllocationScope(const char* name) :
+	previous_(currentScope)
+{
+	currentScope = name;
+}
+
+AllocationScope::~AllocationScope()
+{
+	currentScope = previous_;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#ifndef PONG_ALLOCATION_TRACKER_H
+#define PONG_ALLOCATION_TRACKER_H
+
+#include <cstdio>
+
+/// Heap allocations made through operator new, counted when built with
+/// PONG_TRACK_ALLOCATIONS. Otherwise the counts stay at zero and scopes cost
+/// nothing.
+struct AllocationCounts
+{
+	AllocationCounts() : allocations_(0), bytes_(0) {}
+
+	unsigned long long allocations_;
+	unsigned long long bytes_;
+};
+
+#ifdef PONG_TRACK_ALLOCATIONS
+
+/// Allocations by every thread since the process started.
+AllocationCounts GetAllocationCounts();
+/// Allocations by the calling thread since it started.
+AllocationCounts GetThreadAllocationCounts();
+/// Forget the call sites recorded so far, e.g. once warmed up, so that the
+/// report shows only what came after.
+void ClearAllocationSites();
+/// Print the call sites that allocated most often, with the scope each
+/// allocation was made in and the stack above it. Stacks are symbolized
+/// where the platform can; the build links with -rdynamic for that.
+void ReportAllocationSites(FILE* file, unsigned maxSites);
+
+/// Attributes the calling thread's allocations to a named part of the
+/// program for as long as it is in scope. Scopes nest; the innermost wins.
+/// The name must outlive the process, e.g. a string literal.
+class AllocationScope
+{
+public:
+
+	explicit AllocationScope(const char* name);
+	~AllocationScope();
+
+private:
+
+	const char* previous_;
+};
+
+#else
+
+inline AllocationCounts GetAllocationCounts() { return AllocationCounts(); }
+inline AllocationCounts GetThreadAllocationCounts() { return AllocationCounts(); }
+inline void ClearAllocationSites() {}
+inline void ReportAllocationSites(FILE*, unsigned) {}
+
+class AllocationScope
+{
+public:
+
+	explicit AllocationScope(const char*) {}
+};
+
+#endif
+
+#endif
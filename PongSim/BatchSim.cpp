@@ -0,0 +1,381 @@
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PONGSIM_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(PONGSIM_AVX2) && defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "BatchSimKernel.h"
+
+// Lane counts are padded to a multiple of the widest kernel's vector.
+const unsigned MAX_KERNEL_WIDTH = 8;
+
+// A bat driven by CompareKernels stops within this distance of the ball.
+const float COMPARE_DEAD_ZONE = 0.05f;
+
+namespace
+{
+
+/// One lane at a time. Used where no vector instruction set is available,
+/// and as the reference the vector kernels are checked against.
+struct ScalarOps
+{
+	typedef float Float;
+	typedef bool Mask;
+	typedef unsigned Int;
+	static const unsigned WIDTH = 1;
+
+	static Float Load(const float* source) { return *source; }
+	static void Store(float* dest, Float value) { *dest = value; }
+	static Float Set(float value) { return value; }
+	static Mask LoadMask(const unsigned* source) { return *source != 0; }
+	static void StoreMask(unsigned* dest, Mask value) { *dest = value ? 0xffffffffu : 0u; }
+	static Int LoadInt(const unsigned* source) { return *source; }
+	static void StoreInt(unsigned* dest, Int value) { *dest = value; }
+	static Int SetInt(unsigned value) { return value; }
+
+	static Float Add(Float a, Float b) { return a + b; }
+	static Float Sub(Float a, Float b) { return a - b; }
+	static Float Mul(Float a, Float b) { return a * b; }
+	static Float Max(Float a, Float b) { return a > b ? a : b; }
+	static Float Abs(Float a) { return std::fabs(a); }
+	static Float Negate(Float a) { return -a; }
+	static Mask Less(Float a, Float b) { return a < b; }
+	static Mask Greater(Float a, Float b) { return a > b; }
+	static Mask And(Mask a, Mask b) { return a && b; }
+	static Mask Or(Mask a, Mask b) { return a || b; }
+	static Mask AndNot(Mask a, Mask b) { return a && !b; }
+	static Float Select(Mask mask, Float a, Float b) { return mask ? a : b; }
+	static Int SelectInt(Mask mask, Int a, Int b) { return mask ? a : b; }
+	static Int MaskBits(Mask mask, unsigned bits) { return mask ? bits : 0u; }
+	static Int IntOr(Int a, Int b) { return a | b; }
+	static Int IntAdd(Int a, Int b) { return a + b; }
+};
+
+#ifdef PONGSIM_SSE2
+/// Four lanes at a time.
+struct Sse2Ops
+{
+	typedef __m128 Float;
+	typedef __m128 Mask;
+	typedef __m128i Int;
+	static const unsigned WIDTH = 4;
+
+	static Float Load(const float* source) { return _mm_loadu_ps(source); }
+	static void Store(float* dest, Float value) { _mm_storeu_ps(dest, value); }
+	static Float Set(float value) { return _mm_set1_ps(value); }
+	static Mask LoadMask(const unsigned* source) { return _mm_castsi128_ps(LoadInt(source)); }
+	static void StoreMask(unsigned* dest, Mask value) { StoreInt(dest, _mm_castps_si128(value)); }
+	static Int LoadInt(const unsigned* source) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(source)); }
+	static void StoreInt(unsigned* dest, Int value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(dest), value); }
+	static Int SetInt(unsigned value) { return _mm_set1_epi32((int)value); }
+
+	static Float Add(Float a, Float b) { return _mm_add_ps(a, b); }
+	static Float Sub(Float a, Float b) { return _mm_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) { return _mm_mul_ps(a, b); }
+	static Float Max(Float a, Float b) { return _mm_max_ps(a, b); }
+	static Float Abs(Float a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+	static Float Negate(Float a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+	static Mask Less(Float a, Float b) { return _mm_cmplt_ps(a, b); }
+	static Mask Greater(Float a, Float b) { return _mm_cmpgt_ps(a, b); }
+	static Mask And(Mask a, Mask b) { return _mm_and_ps(a, b); }
+	static Mask Or(Mask a, Mask b) { return _mm_or_ps(a, b); }
+	static Mask AndNot(Mask a, Mask b) { return _mm_andnot_ps(b, a); }
+	static Float Select(Mask mask, Float a, Float b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+	static Int SelectInt(Mask mask, Int a, Int b) { return _mm_castps_si128(Select(mask, _mm_castsi128_ps(a), _mm_castsi128_ps(b))); }
+	static Int MaskBits(Mask mask, unsigned bits) { return _mm_and_si128(_mm_castps_si128(mask), SetInt(bits)); }
+	static Int IntOr(Int a, Int b) { return _mm_or_si128(a, b); }
+	static Int IntAdd(Int a, Int b) { return _mm_add_epi32(a, b); }
+};
+#endif
+
+/// Bitwise equality, so that -0 and 0 or differing NaNs are told apart.
+bool SameBits(float a, float b)
+{
+	return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+bool StatesEqual(const SimState& a, const SimState& b)
+{
+	return SameBits(a.ballX_, b.ballX_) && SameBits(a.ballY_, b.ballY_) &&
+		SameBits(a.ballVelocityX_, b.ballVelocityX_) && SameBits(a.ballVelocityY_, b.ballVelocityY_) &&
+		SameBits(a.batY_[PLAYER_ONE], b.batY_[PLAYER_ONE]) && SameBits(a.batY_[PLAYER_TWO], b.batY_[PLAYER_TWO]) &&
+		SameBits(a.batVelocity_[PLAYER_ONE], b.batVelocity_[PLAYER_ONE]) &&
+		SameBits(a.batVelocity_[PLAYER_TWO], b.batVelocity_[PLAYER_TWO]) &&
+		SameBits(a.matchTime_, b.matchTime_) && a.randomSeed_ == b.randomSeed_ &&
+		a.rallyLength_ == b.rallyLength_ && a.ballActive_ == b.ballActive_ &&
+		a.gameRunning_ == b.gameRunning_ && a.winner_ == b.winner_;
+}
+
+}
+
+void StepBatchScalar(const BatchArrays& arrays, const SimParams& params, float timeStep, unsigned numLanes)
+{
+	StepLanes<ScalarOps>(arrays, params, timeStep, numLanes);
+}
+
+#ifdef PONGSIM_SSE2
+void StepBatchSse2(const BatchArrays& arrays, const SimParams& params, float timeStep, unsigned numLanes)
+{
+	StepLanes<Sse2Ops>(arrays, params, timeStep, numLanes);
+}
+#endif
+
+BatchSim::BatchSim(unsigned numMatches, const SimParams& params) :
+	params_(params),
+	kernel_(GetBestKernel()),
+	numMatches_(numMatches),
+	numLanes_((numMatches + MAX_KERNEL_WIDTH - 1) / MAX_KERNEL_WIDTH * MAX_KERNEL_WIDTH)
+{
+	ballX_.resize(numLanes_, 0.0f);
+	ballY_.resize(numLanes_, 0.0f);
+	ballVelocityX_.resize(numLanes_, 0.0f);
+	ballVelocityY_.resize(numLanes_, 0.0f);
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		batY_[i].resize(numLanes_, 0.0f);
+		batVelocity_[i].resize(numLanes_, 0.0f);
+		batDirection_[i].resize(numLanes_, 0.0f);
+	}
+	matchTime_.resize(numLanes_, 0.0f);
+	ballActive_.resize(numLanes_, 0);
+	running_.resize(numLanes_, 0);
+	rallyLength_.resize(numLanes_, 0);
+	winner_.resize(numLanes_, (unsigned)-1);
+	events_.resize(numLanes_, SIM_EVENT_NONE);
+	randomSeed_.resize(numLanes_, 1);
+
+	// The kernels only resolve contacts where bodies overlap after a step,
+	// in floating point.
+	params_.continuousCollision_ = false;
+	params_.fixedPoint_ = false;
+}
+
+void BatchSim::SetKernel(SimKernel kernel)
+{
+	kernel_ = IsKernelSupported(kernel) ? kernel : KERNEL_SCALAR;
+}
+
+bool BatchSim::IsKernelSupported(SimKernel kernel)
+{
+	switch (kernel)
+	{
+	case KERNEL_SCALAR:
+		return true;
+
+	case KERNEL_SSE2:
+#ifdef PONGSIM_SSE2
+		return true;
+#else
+		return false;
+#endif
+
+	case KERNEL_AVX2:
+#if defined(PONGSIM_AVX2) && defined(_MSC_VER)
+		{
+			// The CPU has to support AVX2, and the OS has to save the AVX
+			// registers.
+			int info[4];
+			__cpuid(info, 1);
+			if (!(info[2] & (1 << 27)) || (_xgetbv(0) & 6) != 6)
+			{
+				return false;
+			}
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+		}
+#elif defined(PONGSIM_AVX2)
+		return __builtin_cpu_supports("avx2") != 0;
+#else
+		return false;
+#endif
+
+	default:
+		return false;
+	}
+}
+
+SimKernel BatchSim::GetBestKernel()
+{
+	for (int kernel = NUM_KERNELS - 1; kernel > KERNEL_SCALAR; --kernel)
+	{
+		if (IsKernelSupported((SimKernel)kernel))
+		{
+			return (SimKernel)kernel;
+		}
+	}
+	return KERNEL_SCALAR;
+}
+
+const char* BatchSim::GetKernelName(SimKernel kernel)
+{
+	static const char* names[NUM_KERNELS] = { "scalar", "SSE2", "AVX2" };
+	return kernel < NUM_KERNELS ? names[kernel] : "unknown";
+}
+
+void BatchSim::SetRandomSeed(unsigned match, unsigned seed)
+{
+	randomSeed_[match] = seed;
+}
+
+/// Same as PongSim::StartGame, for one match.
+void BatchSim::StartGame(unsigned match)
+{
+	matchTime_[match] = 0.0f;
+	rallyLength_[match] = 0;
+	winner_[match] = (unsigned)-1;
+	running_[match] = 0xffffffffu;
+
+	ballX_[match] = 0.0f;
+	ballY_[match] = 0.0f;
+	unsigned direction = PongSim::RandomServeDirection(randomSeed_[match]);
+	PongSim::GetServeVelocity(direction, params_.initialBallSpeed_, ballVelocityX_[match], ballVelocityY_[match]);
+	ballActive_[match] = 0xffffffffu;
+}
+
+void BatchSim::StopGame(unsigned match)
+{
+	ballActive_[match] = 0;
+	running_[match] = 0;
+}
+
+void BatchSim::SetInput(unsigned match, const SimInput& input)
+{
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		batDirection_[i][match] = input.batDirection_[i];
+	}
+}
+
+void BatchSim::Step(float timeStep)
+{
+	BatchArrays arrays;
+	arrays.ballX_ = &ballX_[0];
+	arrays.ballY_ = &ballY_[0];
+	arrays.ballVelocityX_ = &ballVelocityX_[0];
+	arrays.ballVelocityY_ = &ballVelocityY_[0];
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		arrays.batY_[i] = &batY_[i][0];
+		arrays.batVelocity_[i] = &batVelocity_[i][0];
+		arrays.batDirection_[i] = &batDirection_[i][0];
+	}
+	arrays.matchTime_ = &matchTime_[0];
+	arrays.ballActive_ = &ballActive_[0];
+	arrays.running_ = &running_[0];
+	arrays.rallyLength_ = &rallyLength_[0];
+	arrays.winner_ = &winner_[0];
+	arrays.events_ = &events_[0];
+
+	switch (kernel_)
+	{
+#ifdef PONGSIM_AVX2
+	case KERNEL_AVX2:
+		StepBatchAvx2(arrays, params_, timeStep, numLanes_);
+		break;
+#endif
+
+#ifdef PONGSIM_SSE2
+	case KERNEL_SSE2:
+		StepBatchSse2(arrays, params_, timeStep, numLanes_);
+		break;
+#endif
+
+	default:
+		StepBatchScalar(arrays, params_, timeStep, numLanes_);
+		break;
+	}
+}
+
+void BatchSim::GetState(unsigned match, SimState& state) const
+{
+	state.ballX_ = ballX_[match];
+	state.ballY_ = ballY_[match];
+	state.ballVelocityX_ = ballVelocityX_[match];
+	state.ballVelocityY_ = ballVelocityY_[match];
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		state.batY_[i] = batY_[i][match];
+		state.batVelocity_[i] = batVelocity_[i][match];
+	}
+	state.matchTime_ = matchTime_[match];
+	state.randomSeed_ = randomSeed_[match];
+	state.rallyLength_ = rallyLength_[match];
+	state.ballActive_ = ballActive_[match] != 0;
+	state.gameRunning_ = running_[match] != 0;
+	state.winner_ = (signed char)winner_[match];
+}
+
+unsigned BatchSim::CompareKernels(unsigned numMatches, unsigned numSteps, float timeStep, unsigned seed)
+{
+	unsigned mismatches = 0;
+
+	for (int kernel = KERNEL_SCALAR; kernel < NUM_KERNELS; ++kernel)
+	{
+		if (!IsKernelSupported((SimKernel)kernel))
+		{
+			continue;
+		}
+
+		SimParams params;
+		params.continuousCollision_ = false;
+		BatchSim batch(numMatches, params);
+		batch.SetKernel((SimKernel)kernel);
+		std::vector<PongSim> reference(numMatches, PongSim(params));
+
+		for (unsigned match = 0; match < numMatches; ++match)
+		{
+			batch.SetRandomSeed(match, PongSim::MixSeed(seed, match));
+			reference[match].SetRandomSeed(PongSim::MixSeed(seed, match));
+		}
+
+		for (unsigned step = 0; step < numSteps; ++step)
+		{
+			for (unsigned match = 0; match < numMatches; ++match)
+			{
+				PongSim& sim = reference[match];
+				if (!sim.GetState().gameRunning_)
+				{
+					sim.StartGame();
+					batch.StartGame(match);
+				}
+
+				// Track the ball, but let the bats drift into the walls now
+				// and then so that stopping is exercised too.
+				SimInput input;
+				const SimState& state = sim.GetState();
+				for (int player = 0; player < NUM_PLAYERS; ++player)
+				{
+					float offset = state.ballY_ - state.batY_[player];
+					input.batDirection_[player] = offset > COMPARE_DEAD_ZONE ? 1 : (offset < -COMPARE_DEAD_ZONE ? -1 : 0);
+					if ((step / 64 + match + player) % 7 == 0)
+					{
+						input.batDirection_[player] = player == PLAYER_ONE ? 1 : -1;
+					}
+				}
+
+				sim.Step(timeStep, input);
+				batch.SetInput(match, input);
+			}
+
+			batch.Step(timeStep);
+
+			for (unsigned match = 0; match < numMatches; ++match)
+			{
+				SimState state;
+				batch.GetState(match, state);
+				if (!StatesEqual(state, reference[match].GetState()))
+				{
+					++mismatches;
+				}
+			}
+		}
+	}
+
+	return mismatches;
+}
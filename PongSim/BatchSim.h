@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef PONG_BATCH_SIM_H
+#define PONG_BATCH_SIM_H
+
+#include <vector>
+
+#include "PongSim.h"
+
+/// Instruction sets BatchSim can step with. All of them produce bit for bit
+/// the same results as PongSim.
+enum SimKernel
+{
+	KERNEL_SCALAR = 0,
+	KERNEL_SSE2,
+	KERNEL_AVX2,
+	NUM_KERNELS
+};
+
+/// Many independent matches held as a structure of arrays and stepped
+/// together. Contacts are resolved with masks rather than branches, so a
+/// whole vector of matches is stepped at once. Serving, which is rare, is
+/// done per match. Contacts are always found by overlap at the end of a step,
+/// as PongSim does with continuous collision turned off.
+class BatchSim
+{
+public:
+
+	/// The number of matches is rounded up internally to a whole number of
+	/// the widest vectors; the extra lanes never run.
+	explicit BatchSim(unsigned numMatches, const SimParams& params = SimParams());
+	unsigned GetNumMatches() const { return numMatches_; }
+	const SimParams& GetParams() const { return params_; }
+
+	void SetKernel(SimKernel kernel);
+	SimKernel GetKernel() const { return kernel_; }
+	static bool IsKernelSupported(SimKernel kernel);
+	static SimKernel GetBestKernel();
+	static const char* GetKernelName(SimKernel kernel);
+
+	void SetRandomSeed(unsigned match, unsigned seed);
+	void StartGame(unsigned match);
+	void StopGame(unsigned match);
+	void SetInput(unsigned match, const SimInput& input);
+	void Step(float timeStep);
+
+	bool IsRunning(unsigned match) const { return running_[match] != 0; }
+	float GetMatchTime(unsigned match) const { return matchTime_[match]; }
+	/// The SimEvent flags of the last step for a match.
+	unsigned GetEvents(unsigned match) const { return events_[match]; }
+	void GetState(unsigned match, SimState& state) const;
+
+	/// Direct access to the arrays, for driving the bats of every match
+	/// without going through SetInput.
+	const float* GetBallY() const { return &ballY_[0]; }
+	const float* GetBatY(SimPlayer player) const { return &batY_[player][0]; }
+	float* GetBatDirections(SimPlayer player) { return &batDirection_[player][0]; }
+
+	/// Step the same seeded matches with every supported kernel and with
+	/// PongSim, and compare the complete state bit for bit after every step.
+	/// Returns the number of mismatching match steps.
+	static unsigned CompareKernels(unsigned numMatches, unsigned numSteps, float timeStep, unsigned seed);
+
+private:
+
+	SimParams params_;
+	SimKernel kernel_;
+	unsigned numMatches_;
+	unsigned numLanes_;
+
+	std::vector<float> ballX_;
+	std::vector<float> ballY_;
+	std::vector<float> ballVelocityX_;
+	std::vector<float> ballVelocityY_;
+	std::vector<float> batY_[NUM_PLAYERS];
+	std::vector<float> batVelocity_[NUM_PLAYERS];
+	std::vector<float> batDirection_[NUM_PLAYERS];
+	std::vector<float> matchTime_;
+	// Flags are all bits set for true, so they can be used as vector masks.
+	std::vector<unsigned> ballActive_;
+	std::vector<unsigned> running_;
+	std::vector<unsigned> rallyLength_;
+	std::vector<unsigned> winner_;
+	std::vector<unsigned> events_;
+	std::vector<unsigned> randomSeed_;
+};
+
+#endif
@@ -0,0 +1,54 @@
+// This file is compiled with AVX2 enabled. BatchSim only calls into it after
+// checking that the CPU supports AVX2.
+#ifdef __AVX2__
+
+#include <immintrin.h>
+
+#include "BatchSimKernel.h"
+
+namespace
+{
+
+/// Eight lanes at a time.
+struct Avx2Ops
+{
+	typedef __m256 Float;
+	typedef __m256 Mask;
+	typedef __m256i Int;
+	static const unsigned WIDTH = 8;
+
+	static Float Load(const float* source) { return _mm256_loadu_ps(source); }
+	static void Store(float* dest, Float value) { _mm256_storeu_ps(dest, value); }
+	static Float Set(float value) { return _mm256_set1_ps(value); }
+	static Mask LoadMask(const unsigned* source) { return _mm256_castsi256_ps(LoadInt(source)); }
+	static void StoreMask(unsigned* dest, Mask value) { StoreInt(dest, _mm256_castps_si256(value)); }
+	static Int LoadInt(const unsigned* source) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source)); }
+	static void StoreInt(unsigned* dest, Int value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(dest), value); }
+	static Int SetInt(unsigned value) { return _mm256_set1_epi32((int)value); }
+
+	static Float Add(Float a, Float b) { return _mm256_add_ps(a, b); }
+	static Float Sub(Float a, Float b) { return _mm256_sub_ps(a, b); }
+	static Float Mul(Float a, Float b) { return _mm256_mul_ps(a, b); }
+	static Float Max(Float a, Float b) { return _mm256_max_ps(a, b); }
+	static Float Abs(Float a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+	static Float Negate(Float a) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+	static Mask Less(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static Mask Greater(Float a, Float b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+	static Mask And(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+	static Mask Or(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+	static Mask AndNot(Mask a, Mask b) { return _mm256_andnot_ps(b, a); }
+	static Float Select(Mask mask, Float a, Float b) { return _mm256_blendv_ps(b, a, mask); }
+	static Int SelectInt(Mask mask, Int a, Int b) { return _mm256_castps_si256(Select(mask, _mm256_castsi256_ps(a), _mm256_castsi256_ps(b))); }
+	static Int MaskBits(Mask mask, unsigned bits) { return _mm256_and_si256(_mm256_castps_si256(mask), SetInt(bits)); }
+	static Int IntOr(Int a, Int b) { return _mm256_or_si256(a, b); }
+	static Int IntAdd(Int a, Int b) { return _mm256_add_epi32(a, b); }
+};
+
+}
+
+void StepBatchAvx2(const BatchArrays& arrays, const SimParams& params, float timeStep, unsigned numLanes)
+{
+	StepLanes<Avx2Ops>(arrays, params, timeStep, numLanes);
+}
+
+#endif
@@ -0,0 +1,172 @@
+#pragma once
+
+#ifndef PONG_BATCH_SIM_KERNEL_H
+#define PONG_BATCH_SIM_KERNEL_H
+
+#include <cmath>
+
+#include "BatchSim.h"
+
+/// Pointers to BatchSim's arrays, handed to the stepping kernels.
+struct BatchArrays
+{
+	float* ballX_;
+	float* ballY_;
+	float* ballVelocityX_;
+	float* ballVelocityY_;
+	float* batY_[NUM_PLAYERS];
+	float* batVelocity_[NUM_PLAYERS];
+	const float* batDirection_[NUM_PLAYERS];
+	float* matchTime_;
+	unsigned* ballActive_;
+	unsigned* running_;
+	unsigned* rallyLength_;
+	unsigned* winner_;
+	unsigned* events_;
+};
+
+void StepBatchScalar(const BatchArrays& arrays, const SimParams& params, float timeStep, unsigned numLanes);
+void StepBatchSse2(const BatchArrays& arrays, const SimParams& params, float timeStep, unsigned numLanes);
+void StepBatchAvx2(const BatchArrays& arrays, const SimParams& params, float timeStep, unsigned numLanes);
+
+// Everything below is compiled separately into each kernel's translation
+// unit, with that unit's instruction set, so it must not have external
+// linkage.
+namespace
+{
+
+/// A box in the arena, with the values the overlap test needs broadcast.
+template <class Ops> struct KernelBox
+{
+	typename Ops::Float halfWidth_;
+	typename Ops::Float halfHeight_;
+};
+
+/// Circle against axis aligned box, exactly as PongSim::BodiesOverlap.
+template <class Ops> inline typename Ops::Mask BallOverlapsBox(typename Ops::Float ballX, typename Ops::Float ballY,
+	typename Ops::Float centreX, typename Ops::Float centreY, const KernelBox<Ops>& box, typename Ops::Float radiusSquared)
+{
+	typename Ops::Float zero = Ops::Set(0.0f);
+	typename Ops::Float dx = Ops::Sub(Ops::Abs(Ops::Sub(ballX, centreX)), box.halfWidth_);
+	typename Ops::Float dy = Ops::Sub(Ops::Abs(Ops::Sub(ballY, centreY)), box.halfHeight_);
+	dx = Ops::Max(dx, zero);
+	dy = Ops::Max(dy, zero);
+	return Ops::Less(Ops::Add(Ops::Mul(dx, dx), Ops::Mul(dy, dy)), radiusSquared);
+}
+
+/// Step every lane, Ops::WIDTH lanes at a time. Performs the same floating
+/// point operations in the same order as PongSim::Step, with the branches
+/// replaced by selects, so that every kernel gives identical results.
+template <class Ops> void StepLanes(const BatchArrays& arrays, const SimParams& params, float timeStep, unsigned numLanes)
+{
+	typedef typename Ops::Float Float;
+	typedef typename Ops::Mask Mask;
+	typedef typename Ops::Int Int;
+
+	const Float zero = Ops::Set(0.0f);
+	const Float dt = Ops::Set(timeStep);
+	const Float wallOffset = Ops::Set(params.wallOffset_);
+	const Float wallOffsetNegative = Ops::Set(-params.wallOffset_);
+	const Float batSpeed = Ops::Set(params.batSpeed_);
+	// Bats only ever touch walls vertically; whether they overlap them
+	// horizontally is the same for every lane.
+	const bool batsReachWalls = std::fabs(params.batOffset_ - 0.0f) < params.batHalfWidth_ + params.wallHalfWidth_;
+	const Float batWallReach = Ops::Set(params.batHalfHeight_ + params.wallHalfHeight_);
+	const float batWallOffset = params.batHalfHeight_ + params.wallHalfHeight_ + params.batWallGap_;
+	const Float batStoppedY = Ops::Set(params.wallOffset_ - batWallOffset);
+	const Float batStoppedYNegative = Ops::Set(-params.wallOffset_ + batWallOffset);
+	const Float batOffset = Ops::Set(params.batOffset_);
+	const Float batOffsetNegative = Ops::Set(-params.batOffset_);
+	const Float speedUp = Ops::Set(params.batSpeedUp_);
+	const Float speedUpNegative = Ops::Set(-params.batSpeedUp_);
+	const Float endZoneOffset = Ops::Set(params.endZoneOffset_);
+	const Float endZoneOffsetNegative = Ops::Set(-params.endZoneOffset_);
+	const Float radiusSquared = Ops::Set(params.ballRadius_ * params.ballRadius_);
+	const KernelBox<Ops> batBox = { Ops::Set(params.batHalfWidth_), Ops::Set(params.batHalfHeight_) };
+	const KernelBox<Ops> wallBox = { Ops::Set(params.wallHalfWidth_), Ops::Set(params.wallHalfHeight_) };
+	const KernelBox<Ops> endZoneBox = { Ops::Set(params.endZoneHalfWidth_), Ops::Set(params.endZoneHalfHeight_) };
+
+	for (unsigned i = 0; i < numLanes; i += Ops::WIDTH)
+	{
+		Int events = Ops::SetInt(SIM_EVENT_NONE);
+
+		// Bats, stopped just short of the walls. Bottom wall first, then top,
+		// as PongSim resolves contacts in body order.
+		Float batY[NUM_PLAYERS];
+		for (int player = 0; player < NUM_PLAYERS; ++player)
+		{
+			Float velocity = Ops::Mul(Ops::Load(arrays.batDirection_[player] + i), batSpeed);
+			Float y = Ops::Add(Ops::Load(arrays.batY_[player] + i), Ops::Mul(velocity, dt));
+			Mask stopped = Ops::Less(zero, zero); // No lanes
+			if (batsReachWalls)
+			{
+				Mask bottom = Ops::Less(Ops::Abs(Ops::Sub(y, wallOffsetNegative)), batWallReach);
+				y = Ops::Select(bottom, Ops::Select(Ops::Greater(y, wallOffsetNegative), batStoppedYNegative,
+					Ops::Set(-params.wallOffset_ - batWallOffset)), y);
+				Mask top = Ops::Less(Ops::Abs(Ops::Sub(y, wallOffset)), batWallReach);
+				y = Ops::Select(top, Ops::Select(Ops::Greater(y, wallOffset), Ops::Set(params.wallOffset_ + batWallOffset),
+					batStoppedY), y);
+				stopped = Ops::Or(bottom, top);
+			}
+			velocity = Ops::Select(stopped, zero, velocity);
+			events = Ops::IntOr(events, Ops::MaskBits(stopped, SIM_EVENT_BAT_STOPPED));
+			Ops::Store(arrays.batY_[player] + i, y);
+			Ops::Store(arrays.batVelocity_[player] + i, velocity);
+			batY[player] = y;
+		}
+
+		// Ball, in the lanes where it is in play.
+		Mask active = Ops::LoadMask(arrays.ballActive_ + i);
+		Mask running = Ops::LoadMask(arrays.running_ + i);
+		Float x = Ops::Load(arrays.ballX_ + i);
+		Float y = Ops::Load(arrays.ballY_ + i);
+		Float velocityX = Ops::Load(arrays.ballVelocityX_ + i);
+		Float velocityY = Ops::Load(arrays.ballVelocityY_ + i);
+		x = Ops::Select(active, Ops::Add(x, Ops::Mul(velocityX, dt)), x);
+		y = Ops::Select(active, Ops::Add(y, Ops::Mul(velocityY, dt)), y);
+
+		// Bats: reflect horizontally, and speed up slightly.
+		Mask movingLeft = Ops::Less(velocityX, zero);
+		Float batX = Ops::Select(movingLeft, batOffsetNegative, batOffset);
+		Float nearBatY = Ops::Select(movingLeft, batY[PLAYER_ONE], batY[PLAYER_TWO]);
+		Mask batHit = Ops::And(active, BallOverlapsBox<Ops>(x, y, batX, nearBatY, batBox, radiusSquared));
+		velocityX = Ops::Select(batHit, Ops::Mul(velocityX, speedUpNegative), velocityX);
+		velocityY = Ops::Select(batHit, Ops::Mul(velocityY, speedUp), velocityY);
+		Int rallyLength = Ops::IntAdd(Ops::LoadInt(arrays.rallyLength_ + i), Ops::MaskBits(batHit, 1));
+		events = Ops::IntOr(events, Ops::MaskBits(batHit, SIM_EVENT_BAT_HIT));
+
+		// Walls: reflect vertically.
+		Float wallY = Ops::Select(Ops::Less(velocityY, zero), wallOffsetNegative, wallOffset);
+		Mask wallHit = Ops::And(active, BallOverlapsBox<Ops>(x, y, zero, wallY, wallBox, radiusSquared));
+		velocityY = Ops::Select(wallHit, Ops::Negate(velocityY), velocityY);
+		events = Ops::IntOr(events, Ops::MaskBits(wallHit, SIM_EVENT_WALL_HIT));
+
+		// End zones: the player at the other end wins.
+		Mask left = Ops::Less(x, zero);
+		Float endZoneX = Ops::Select(left, endZoneOffsetNegative, endZoneOffset);
+		Mask gameEnd = Ops::And(active, BallOverlapsBox<Ops>(x, y, endZoneX, zero, endZoneBox, radiusSquared));
+		Int winner = Ops::SelectInt(left, Ops::SetInt(PLAYER_TWO), Ops::SetInt(PLAYER_ONE));
+		winner = Ops::SelectInt(gameEnd, winner, Ops::LoadInt(arrays.winner_ + i));
+		active = Ops::AndNot(active, gameEnd);
+		running = Ops::AndNot(running, gameEnd);
+		events = Ops::IntOr(events, Ops::MaskBits(gameEnd, SIM_EVENT_GAME_END));
+
+		Float matchTime = Ops::Load(arrays.matchTime_ + i);
+		matchTime = Ops::Select(running, Ops::Add(matchTime, dt), matchTime);
+
+		Ops::Store(arrays.ballX_ + i, x);
+		Ops::Store(arrays.ballY_ + i, y);
+		Ops::Store(arrays.ballVelocityX_ + i, velocityX);
+		Ops::Store(arrays.ballVelocityY_ + i, velocityY);
+		Ops::Store(arrays.matchTime_ + i, matchTime);
+		Ops::StoreMask(arrays.ballActive_ + i, active);
+		Ops::StoreMask(arrays.running_ + i, running);
+		Ops::StoreInt(arrays.rallyLength_ + i, rallyLength);
+		Ops::StoreInt(arrays.winner_ + i, winner);
+		Ops::StoreInt(arrays.events_ + i, events);
+	}
+}
+
+}
+
+#endif
@@ -0,0 +1,120 @@
+#include "EndpointMap.h"
+
+EndpointMap::EndpointMap() :
+	mask_(0),
+	size_(0),
+	capacity_(0)
+{
+}
+
+void EndpointMap::Reserve(unsigned capacity)
+{
+	// At most half full, so that probes stay short.
+	unsigned slots = 2;
+	while (slots < capacity * 2)
+	{
+		slots <<= 1;
+	}
+	Entry empty;
+	empty.endpoint_ = 0;
+	empty.value_ = 0;
+	empty.used_ = false;
+	entries_.assign(slots, empty);
+	mask_ = slots - 1;
+	size_ = 0;
+	capacity_ = capacity;
+}
+
+void EndpointMap::Clear()
+{
+	for (unsigned i = 0; i < entries_.size(); ++i)
+	{
+		entries_[i].used_ = false;
+	}
+	size_ = 0;
+}
+
+/// Ports and addresses are far from random, so the bits are mixed before
+/// the slot is taken from them.
+unsigned EndpointMap::GetHome(UdpEndpoint endpoint) const
+{
+	endpoint ^= endpoint >> 33;
+	endpoint *= 0xff51afd7ed558ccdULL;
+	endpoint ^= endpoint >> 33;
+	return (unsigned)endpoint & mask_;
+}
+
+bool EndpointMap::Find(UdpEndpoint endpoint, unsigned& value) const
+{
+	if (entries_.empty())
+	{
+		return false;
+	}
+	for (unsigned i = GetHome(endpoint); entries_[i].used_; i = (i + 1) & mask_)
+	{
+		if (entries_[i].endpoint_ == endpoint)
+		{
+			value = entries_[i].value_;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool EndpointMap::Insert(UdpEndpoint endpoint, unsigned value)
+{
+	if (entries_.empty())
+	{
+		return false;
+	}
+	unsigned i = GetHome(endpoint);
+	for (; entries_[i].used_; i = (i + 1) & mask_)
+	{
+		if (entries_[i].endpoint_ == endpoint)
+		{
+			entries_[i].value_ = value;
+			return true;
+		}
+	}
+	if (size_ == capacity_)
+	{
+		return false;
+	}
+	entries_[i].endpoint_ = endpoint;
+	entries_[i].value_ = value;
+	entries_[i].used_ = true;
+	++size_;
+	return true;
+}
+
+void EndpointMap::Erase(UdpEndpoint endpoint)
+{
+	if (entries_.empty())
+	{
+		return;
+	}
+	unsigned gap = GetHome(endpoint);
+	while (entries_[gap].used_ && entries_[gap].endpoint_ != endpoint)
+	{
+		gap = (gap + 1) & mask_;
+	}
+	if (!entries_[gap].used_)
+	{
+		return;
+	}
+	entries_[gap].used_ = false;
+	--size_;
+
+	// Move back each following entry whose home is not between the gap and
+	// where it is, which would no longer be found past the gap.
+	for (unsigned i = (gap + 1) & mask_; entries_[i].used_; i = (i + 1) & mask_)
+	{
+		unsigned home = GetHome(entries_[i].endpoint_);
+		if (((i - home) & mask_) >= ((i - gap) & mask_))
+		{
+			entries_[gap] = entries_[i];
+			entries_[i].used_ = false;
+			gap = i;
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef PONG_ENDPOINT_MAP_H
+#define PONG_ENDPOINT_MAP_H
+
+#include <vector>
+
+#include "UdpSocket.h"
+
+/// Maps endpoints to indices in a table allocated up front, so that adding
+/// and removing entries never allocates. Open addressing with linear
+/// probing; removing an entry shifts those after it back into the gap
+/// rather than leaving a marker.
+class EndpointMap
+{
+public:
+
+	EndpointMap();
+
+	/// Size the table for up to capacity entries, emptying it.
+	void Reserve(unsigned capacity);
+	void Clear();
+	/// Returns false if the endpoint is not in the map.
+	bool Find(UdpEndpoint endpoint, unsigned& value) const;
+	/// Add an entry or replace its value. Returns false if the map is full.
+	bool Insert(UdpEndpoint endpoint, unsigned value);
+	void Erase(UdpEndpoint endpoint);
+	unsigned Size() const { return size_; }
+
+private:
+
+	struct Entry
+	{
+		UdpEndpoint endpoint_;
+		unsigned value_;
+		bool used_;
+	};
+
+	std::vector<Entry> entries_;
+	unsigned mask_;
+	unsigned size_;
+	unsigned capacity_;
+
+	unsigned GetHome(UdpEndpoint endpoint) const;
+};
+
+#endif
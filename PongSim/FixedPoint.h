@@ -0,0 +1,83 @@
+#pragma once
+
+#ifndef PONG_FIXED_POINT_H
+#define PONG_FIXED_POINT_H
+
+#include <climits>
+#include <cmath>
+
+/// Q16.16 fixed point: 16 integer bits, including the sign, and 16 fraction
+/// bits. Only integer operations are used on it, so results are the same on
+/// every compiler and CPU. Any value under 256 in magnitude converts to a
+/// float exactly, so a fixed point state can be held in floats.
+typedef int Fixed;
+
+const int FIXED_SHIFT = 16;
+const Fixed FIXED_ONE = 1 << FIXED_SHIFT;
+
+/// Round to the nearest fixed point value. The double product is exact, so
+/// this is the same everywhere too.
+inline Fixed ToFixed(float value)
+{
+	return (Fixed)std::floor((double)value * FIXED_ONE + 0.5);
+}
+
+inline float FixedToFloat(Fixed value)
+{
+	return (float)value * (1.0f / FIXED_ONE);
+}
+
+/// Rounds towards negative infinity. Right shifts of negative numbers are
+/// arithmetic on every compiler the game is built with.
+inline Fixed FixedMultiply(Fixed a, Fixed b)
+{
+	return (Fixed)(((long long)a * b) >> FIXED_SHIFT);
+}
+
+/// Rounds towards zero, and saturates rather than overflowing. The divisor
+/// must not be zero.
+inline Fixed FixedDivide(long long a, long long b)
+{
+	long long quotient = a * FIXED_ONE / b;
+	return (Fixed)(quotient > INT_MAX ? INT_MAX : (quotient < INT_MIN ? INT_MIN : quotient));
+}
+
+inline Fixed FixedAbs(Fixed value)
+{
+	return value < 0 ? -value : value;
+}
+
+/// Square root of a value with twice the fraction bits, such as the product
+/// of two fixed point values, as a fixed point value. Bit by bit, so there is
+/// no floating point anywhere in it.
+inline Fixed FixedSqrtWide(long long value)
+{
+	if (value <= 0)
+	{
+		return 0;
+	}
+
+	unsigned long long remainder = (unsigned long long)value;
+	unsigned long long root = 0;
+	unsigned long long bit = 1ULL << 62;
+	while (bit > remainder)
+	{
+		bit >>= 2;
+	}
+	while (bit)
+	{
+		if (remainder >= root + bit)
+		{
+			remainder -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else
+		{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return (Fixed)root;
+}
+
+#endif
@@ -0,0 +1,342 @@
+#include <cstdio>
+#include <cstring>
+
+#include "InputRecording.h"
+
+// Identifies a recording file, followed by the format version.
+const char RECORDING_MAGIC[4] = { 'P', 'R', 'E', 'C' };
+const unsigned RECORDING_VERSION = 1;
+
+// Bits of the byte of SimParams flags. Recordings from before fixed point
+// only ever set the first.
+const unsigned char FLAG_CONTINUOUS_COLLISION = 1;
+const unsigned char FLAG_FIXED_POINT = 2;
+
+// Layout of a packed tick: two bits per bat direction, a bit for a game
+// starting, and the serve it got.
+const unsigned char INPUT_BAT_UP = 1;
+const unsigned char INPUT_BAT_DOWN = 2;
+const unsigned INPUT_BAT_BITS = 2;
+const unsigned char INPUT_START = 1 << 4;
+const unsigned INPUT_SERVE_SHIFT = 5;
+
+// Runs reserved when recording begins. Played by hand, input changes a few
+// times a second, so this is hours of play before a run has to allocate.
+const unsigned RESERVED_RUNS = 65536;
+
+static unsigned char PackInput(const SimInput& input, bool startGame, unsigned serveDirection)
+{
+	unsigned char packed = 0;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		unsigned char direction = input.batDirection_[i] > 0 ? INPUT_BAT_UP : (input.batDirection_[i] < 0 ? INPUT_BAT_DOWN : 0);
+		packed |= direction << (i * INPUT_BAT_BITS);
+	}
+	if (startGame)
+	{
+		packed |= INPUT_START | (serveDirection & 3) << INPUT_SERVE_SHIFT;
+	}
+	return packed;
+}
+
+static SimInput UnpackInput(unsigned char packed)
+{
+	SimInput input;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		unsigned char direction = (packed >> (i * INPUT_BAT_BITS)) & 3;
+		input.batDirection_[i] = direction == INPUT_BAT_UP ? 1 : (direction == INPUT_BAT_DOWN ? -1 : 0);
+	}
+	return input;
+}
+
+/// Little endian writes into a byte buffer.
+static void WriteUInt(std::vector<unsigned char>& buffer, unsigned value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		buffer.push_back((unsigned char)(value >> (i * 8)));
+	}
+}
+
+static void WriteFloat(std::vector<unsigned char>& buffer, float value)
+{
+	unsigned bits;
+	memcpy(&bits, &value, sizeof bits);
+	WriteUInt(buffer, bits);
+}
+
+/// Seven bits at a time, with the top bit set on all but the last byte.
+static void WriteVarUInt(std::vector<unsigned char>& buffer, unsigned value)
+{
+	while (value >= 0x80)
+	{
+		buffer.push_back((unsigned char)(value | 0x80));
+		value >>= 7;
+	}
+	buffer.push_back((unsigned char)value);
+}
+
+/// Reads back what the writes above wrote, failing rather than reading past
+/// the end.
+class RecordingReader
+{
+public:
+
+	RecordingReader(const std::vector<unsigned char>& buffer) : buffer_(buffer), position_(0), failed_(false) {}
+
+	unsigned char ReadByte()
+	{
+		if (position_ >= buffer_.size())
+		{
+			failed_ = true;
+			return 0;
+		}
+		return buffer_[position_++];
+	}
+
+	unsigned ReadUInt()
+	{
+		unsigned value = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			value |= (unsigned)ReadByte() << (i * 8);
+		}
+		return value;
+	}
+
+	float ReadFloat()
+	{
+		unsigned bits = ReadUInt();
+		float value;
+		memcpy(&value, &bits, sizeof value);
+		return value;
+	}
+
+	unsigned ReadVarUInt()
+	{
+		unsigned value = 0;
+		for (unsigned shift = 0; shift < 35; shift += 7)
+		{
+			unsigned char byte = ReadByte();
+			value |= (unsigned)(byte & 0x7f) << shift;
+			if (!(byte & 0x80))
+			{
+				return value;
+			}
+		}
+		failed_ = true;
+		return 0;
+	}
+
+	bool Failed() const { return failed_; }
+
+private:
+
+	const std::vector<unsigned char>& buffer_;
+	size_t position_;
+	bool failed_;
+};
+
+InputRecording::InputRecording() :
+	randomSeed_(1),
+	timeStep_(1.0f / 60.0f),
+	numTicks_(0),
+	finalStateHash_(0)
+{
+}
+
+void InputRecording::Begin(const PongSim& sim, float timeStep)
+{
+	params_ = sim.GetParams();
+	randomSeed_ = sim.GetState().randomSeed_;
+	timeStep_ = timeStep;
+	numTicks_ = 0;
+	finalStateHash_ = 0;
+	runs_.clear();
+	runs_.reserve(RESERVED_RUNS);
+}
+
+void InputRecording::AddTick(const SimInput& input, bool startGame, unsigned serveDirection)
+{
+	unsigned char packed = PackInput(input, startGame, serveDirection);
+	if (runs_.empty() || runs_.back().input_ != packed)
+	{
+		InputRun run = { packed, 0 };
+		runs_.push_back(run);
+	}
+	++runs_.back().count_;
+	++numTicks_;
+}
+
+void InputRecording::End(const PongSim& sim)
+{
+	finalStateHash_ = HashState(sim.GetState());
+}
+
+bool InputRecording::Save(const std::string& path) const
+{
+	std::vector<unsigned char> buffer(RECORDING_MAGIC, RECORDING_MAGIC + sizeof RECORDING_MAGIC);
+	WriteUInt(buffer, RECORDING_VERSION);
+
+	const float params[] =
+	{
+		params_.batSpeed_, params_.batOffset_, params_.batHalfWidth_, params_.batHalfHeight_, params_.batWallGap_,
+		params_.ballRadius_, params_.initialBallSpeed_, params_.batSpeedUp_, params_.wallOffset_, params_.wallHalfWidth_,
+		params_.wallHalfHeight_, params_.endZoneOffset_, params_.endZoneHalfWidth_, params_.endZoneHalfHeight_
+	};
+	for (unsigned i = 0; i < sizeof params / sizeof params[0]; ++i)
+	{
+		WriteFloat(buffer, params[i]);
+	}
+	buffer.push_back((params_.continuousCollision_ ? FLAG_CONTINUOUS_COLLISION : 0) | (params_.fixedPoint_ ? FLAG_FIXED_POINT : 0));
+
+	WriteUInt(buffer, randomSeed_);
+	WriteFloat(buffer, timeStep_);
+	WriteUInt(buffer, numTicks_);
+	WriteUInt(buffer, finalStateHash_);
+	WriteVarUInt(buffer, (unsigned)runs_.size());
+	for (unsigned i = 0; i < runs_.size(); ++i)
+	{
+		buffer.push_back(runs_[i].input_);
+		WriteVarUInt(buffer, runs_[i].count_);
+	}
+
+	FILE* file = fopen(path.c_str(), "wb");
+	if (!file)
+	{
+		return false;
+	}
+	bool written = fwrite(&buffer[0], 1, buffer.size(), file) == buffer.size();
+	return fclose(file) == 0 && written;
+}
+
+bool InputRecording::Load(const std::string& path)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		return false;
+	}
+	std::vector<unsigned char> buffer;
+	unsigned char chunk[4096];
+	size_t read;
+	while ((read = fread(chunk, 1, sizeof chunk, file)) > 0)
+	{
+		buffer.insert(buffer.end(), chunk, chunk + read);
+	}
+	fclose(file);
+
+	RecordingReader reader(buffer);
+	for (unsigned i = 0; i < sizeof RECORDING_MAGIC; ++i)
+	{
+		if (reader.ReadByte() != (unsigned char)RECORDING_MAGIC[i])
+		{
+			return false;
+		}
+	}
+	if (reader.ReadUInt() != RECORDING_VERSION)
+	{
+		return false;
+	}
+
+	float* params[] =
+	{
+		&params_.batSpeed_, &params_.batOffset_, &params_.batHalfWidth_, &params_.batHalfHeight_, &params_.batWallGap_,
+		&params_.ballRadius_, &params_.initialBallSpeed_, &params_.batSpeedUp_, &params_.wallOffset_, &params_.wallHalfWidth_,
+		&params_.wallHalfHeight_, &params_.endZoneOffset_, &params_.endZoneHalfWidth_, &params_.endZoneHalfHeight_
+	};
+	for (unsigned i = 0; i < sizeof params / sizeof params[0]; ++i)
+	{
+		*params[i] = reader.ReadFloat();
+	}
+	unsigned char flags = reader.ReadByte();
+	params_.continuousCollision_ = (flags & FLAG_CONTINUOUS_COLLISION) != 0;
+	params_.fixedPoint_ = (flags & FLAG_FIXED_POINT) != 0;
+
+	randomSeed_ = reader.ReadUInt();
+	timeStep_ = reader.ReadFloat();
+	numTicks_ = reader.ReadUInt();
+	finalStateHash_ = reader.ReadUInt();
+	unsigned numRuns = reader.ReadVarUInt();
+	runs_.clear();
+	unsigned numRunTicks = 0;
+	for (unsigned i = 0; i < numRuns && !reader.Failed(); ++i)
+	{
+		InputRun run;
+		run.input_ = reader.ReadByte();
+		run.count_ = reader.ReadVarUInt();
+		numRunTicks += run.count_;
+		runs_.push_back(run);
+	}
+
+	return !reader.Failed() && numRunTicks == numTicks_;
+}
+
+ReplayResult InputRecording::Replay() const
+{
+	PongSim sim(params_);
+	sim.SetRandomSeed(randomSeed_);
+
+	ReplayResult result;
+	result.ticks_ = numTicks_;
+	result.firstBadServe_ = numTicks_;
+	unsigned tick = 0;
+
+	for (unsigned i = 0; i < runs_.size(); ++i)
+	{
+		const InputRun& run = runs_[i];
+		SimInput input = UnpackInput(run.input_);
+
+		for (unsigned j = 0; j < run.count_; ++j, ++tick)
+		{
+			if (run.input_ & INPUT_START)
+			{
+				unsigned serveDirection = sim.GetNextServeDirection();
+				if (serveDirection != (unsigned)(run.input_ >> INPUT_SERVE_SHIFT) && result.firstBadServe_ == numTicks_)
+				{
+					result.firstBadServe_ = tick;
+				}
+				sim.StartGame();
+			}
+			sim.Step(timeStep_, input);
+		}
+	}
+
+	result.stateHash_ = HashState(sim.GetState());
+	result.stateMatches_ = result.stateHash_ == finalStateHash_;
+	return result;
+}
+
+/// FNV-1a over each field's bytes, so that padding never takes part.
+unsigned InputRecording::HashState(const SimState& state)
+{
+	struct Hasher
+	{
+		unsigned hash_;
+
+		void Add(const void* data, unsigned size)
+		{
+			const unsigned char* bytes = (const unsigned char*)data;
+			for (unsigned i = 0; i < size; ++i)
+			{
+				hash_ = (hash_ ^ bytes[i]) * 16777619u;
+			}
+		}
+	};
+
+	Hasher hasher = { 2166136261u };
+	hasher.Add(&state.ballX_, sizeof state.ballX_);
+	hasher.Add(&state.ballY_, sizeof state.ballY_);
+	hasher.Add(&state.ballVelocityX_, sizeof state.ballVelocityX_);
+	hasher.Add(&state.ballVelocityY_, sizeof state.ballVelocityY_);
+	hasher.Add(state.batY_, sizeof state.batY_);
+	hasher.Add(state.batVelocity_, sizeof state.batVelocity_);
+	hasher.Add(&state.matchTime_, sizeof state.matchTime_);
+	hasher.Add(&state.randomSeed_, sizeof state.randomSeed_);
+	hasher.Add(&state.rallyLength_, sizeof state.rallyLength_);
+	hasher.Add(&state.ballActive_, sizeof state.ballActive_);
+	hasher.Add(&state.gameRunning_, sizeof state.gameRunning_);
+	hasher.Add(&state.winner_, sizeof state.winner_);
+	return hasher.hash_;
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef PONG_INPUT_RECORDING_H
+#define PONG_INPUT_RECORDING_H
+
+#include <string>
+#include <vector>
+
+#include "PongSim.h"
+
+/// Outcome of replaying a recording.
+struct ReplayResult
+{
+	unsigned ticks_;
+	unsigned stateHash_;
+	// The first tick whose serve differed from the recorded one, or the
+	// number of ticks if every serve matched.
+	unsigned firstBadServe_;
+	bool stateMatches_;
+
+	bool Succeeded() const { return stateMatches_ && firstBadServe_ == ticks_; }
+};
+
+/// Everything needed to play a session again exactly: the arena, the seed,
+/// the fixed tick length and the input of every tick, with a hash of the
+/// state it finished in. Each tick's input packs into a byte, and runs of
+/// identical ticks are stored once with a count, so held or idle keys cost
+/// almost nothing.
+class InputRecording
+{
+public:
+
+	InputRecording();
+
+	/// Start recording from a simulation's current parameters and seed. The
+	/// simulation must be freshly reset, as replays start from a reset one.
+	void Begin(const PongSim& sim, float timeStep);
+	/// Record a tick's input. A game started this tick is recorded with the
+	/// serve it got, so that a replay can tell exactly where it diverged.
+	void AddTick(const SimInput& input, bool startGame, unsigned serveDirection);
+	/// Stop recording, keeping a hash of the simulation's final state.
+	void End(const PongSim& sim);
+
+	bool Save(const std::string& path) const;
+	bool Load(const std::string& path);
+
+	/// Play the recording back on a new simulation as fast as it will go.
+	ReplayResult Replay() const;
+
+	unsigned GetNumTicks() const { return numTicks_; }
+	unsigned GetNumRuns() const { return (unsigned)runs_.size(); }
+
+	/// Hash of every field of a state, bit for bit.
+	static unsigned HashState(const SimState& state);
+
+private:
+
+	/// A number of consecutive ticks with the same packed input.
+	struct InputRun
+	{
+		unsigned char input_;
+		unsigned count_;
+	};
+
+	SimParams params_;
+	unsigned randomSeed_;
+	float timeStep_;
+	unsigned numTicks_;
+	unsigned finalStateHash_;
+	std::vector<InputRun> runs_;
+};
+
+#endif
@@ -0,0 +1,142 @@
+#include <cmath>
+
+#include "InterceptAi.h"
+
+// The default opponent reacts about as fast as a person, and usually hits the
+// ball with the middle half of the bat.
+AiParams::AiParams() :
+	reactionTime_(0.15f),
+	noise_(0.2f),
+	deadZone_(0.05f)
+{
+}
+
+InterceptAi::InterceptAi(SimPlayer player, const AiParams& params, unsigned seed) :
+	player_(player),
+	params_(params),
+	randomSeed_(seed),
+	ballDirection_(0),
+	reactionTimer_(0.0f),
+	planned_(true),
+	targetY_(0.0f)
+{
+}
+
+signed char InterceptAi::Update(const PongSim& sim, float timeStep)
+{
+	const SimState& state = sim.GetState();
+	bool fixedPoint = sim.GetParams().fixedPoint_;
+
+	int ballDirection = state.ballActive_ ? (state.ballVelocityX_ < 0.0f ? -1 : 1) : 0;
+	if (ballDirection != ballDirection_)
+	{
+		ballDirection_ = ballDirection;
+		reactionTimer_ = params_.reactionTime_;
+		planned_ = false;
+	}
+
+	// Until the new course has been seen, keep going for the old target.
+	if (!planned_)
+	{
+		if (fixedPoint)
+		{
+			reactionTimer_ = FixedToFloat(ToFixed(reactionTimer_) - ToFixed(timeStep));
+		}
+		else
+		{
+			reactionTimer_ -= timeStep;
+		}
+		if (reactionTimer_ <= 0.0f)
+		{
+			planned_ = true;
+			targetY_ = fixedPoint ? PlanTargetFixed(sim) : PlanTarget(sim);
+		}
+	}
+
+	if (fixedPoint)
+	{
+		Fixed offset = ToFixed(targetY_) - ToFixed(state.batY_[player_]);
+		Fixed deadZone = ToFixed(params_.deadZone_);
+		return offset > deadZone ? 1 : (offset < -deadZone ? -1 : 0);
+	}
+	float offset = targetY_ - state.batY_[player_];
+	return offset > params_.deadZone_ ? 1 : (offset < -params_.deadZone_ ? -1 : 0);
+}
+
+float InterceptAi::PlanTarget(const PongSim& sim)
+{
+	float interceptY;
+	if (!PredictIntercept(sim.GetParams(), sim.GetState(), player_, interceptY))
+	{
+		return 0.0f;
+	}
+	// Random numbers are from 0 to 32767.
+	float error = (float)PongSim::NextRandom(randomSeed_) / 16383.5f - 1.0f;
+	return interceptY + error * params_.noise_;
+}
+
+float InterceptAi::PlanTargetFixed(const PongSim& sim)
+{
+	Fixed interceptY;
+	if (!PredictInterceptFixed(sim.GetParams(), sim.GetState(), player_, interceptY))
+	{
+		return 0.0f;
+	}
+	// The same error from -1 to 1 as in floating point, as 2r / 32767 - 1.
+	Fixed error = FixedDivide(2 * (long long)PongSim::NextRandom(randomSeed_) - 32767, 32767);
+	return FixedToFloat(interceptY + FixedMultiply(error, ToFixed(params_.noise_)));
+}
+
+bool InterceptAi::PredictIntercept(const SimParams& params, const SimState& state, SimPlayer player, float& y)
+{
+	// The ball's centre meets the bat's face short of the bat by the radius.
+	float side = player == PLAYER_ONE ? -1.0f : 1.0f;
+	float faceX = side * (params.batOffset_ - params.batHalfWidth_ - params.ballRadius_);
+	float distance = faceX - state.ballX_;
+	if (!state.ballActive_ || distance * state.ballVelocityX_ <= 0.0f)
+	{
+		return false;
+	}
+
+	// Between the walls the centre moves within [-limit, limit]. On the
+	// unfolded line each span of 2 * limit is one crossing of the arena, in
+	// alternating directions.
+	float limit = params.wallOffset_ - params.wallHalfHeight_ - params.ballRadius_;
+	float period = 4.0f * limit;
+	float unfoldedY = state.ballY_ + state.ballVelocityY_ * (distance / state.ballVelocityX_);
+	float phase = std::fmod(unfoldedY + limit, period);
+	if (phase < 0.0f)
+	{
+		phase += period;
+	}
+	y = phase <= 2.0f * limit ? phase - limit : 3.0f * limit - phase;
+	return true;
+}
+
+bool InterceptAi::PredictInterceptFixed(const SimParams& params, const SimState& state, SimPlayer player, Fixed& y)
+{
+	Fixed faceX = ToFixed(params.batOffset_) - ToFixed(params.batHalfWidth_) - ToFixed(params.ballRadius_);
+	if (player == PLAYER_ONE)
+	{
+		faceX = -faceX;
+	}
+	Fixed velocityX = ToFixed(state.ballVelocityX_);
+	Fixed distance = faceX - ToFixed(state.ballX_);
+	if (!state.ballActive_ || (long long)distance * velocityX <= 0)
+	{
+		return false;
+	}
+
+	// Integer division truncates the same everywhere, so the unfolded line is
+	// worked out at full precision before it is rounded.
+	long long limit = ToFixed(params.wallOffset_) - ToFixed(params.wallHalfHeight_) - ToFixed(params.ballRadius_);
+	long long period = 4 * limit;
+	long long unfoldedY = ToFixed(state.ballY_) + (long long)ToFixed(state.ballVelocityY_) * distance / velocityX;
+	long long phase = (unfoldedY + limit) % period;
+	if (phase < 0)
+	{
+		phase += period;
+	}
+	y = (Fixed)(phase <= 2 * limit ? phase - limit : 3 * limit - phase);
+	return true;
+}
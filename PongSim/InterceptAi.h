@@ -0,0 +1,65 @@
+#pragma once
+
+#ifndef PONG_INTERCEPT_AI_H
+#define PONG_INTERCEPT_AI_H
+
+#include "PongSim.h"
+
+/// How well an InterceptAi plays.
+struct AiParams
+{
+	AiParams();
+
+	// Seconds after the ball changes course before the new course is seen.
+	float reactionTime_;
+	// Most the aim can be off by, in world units, chosen at random for every
+	// course the ball takes.
+	float noise_;
+	// The bat stops within this distance of where it is aiming.
+	float deadZone_;
+};
+
+/// Computer player that moves its bat to where the ball will cross the
+/// bat's face. The crossing is predicted in closed form: the reflections
+/// off the walls are unfolded into a straight line, whose end is folded back
+/// between the walls. The ball only changes course at a serve or a bat hit,
+/// so the prediction is made once per course, after the reaction time. While
+/// the ball is moving away, the bat waits in the centre. Deterministic for a
+/// given seed. Against a fixed point simulation the AI works in fixed point
+/// too, so that its matches play the same with any compiler and CPU.
+class InterceptAi
+{
+public:
+
+	explicit InterceptAi(SimPlayer player = PLAYER_ONE, const AiParams& params = AiParams(), unsigned seed = 1);
+	SimPlayer GetPlayer() const { return player_; }
+	const AiParams& GetParams() const { return params_; }
+
+	/// Look at the simulation once per step and return the direction to move
+	/// the bat in for the step.
+	signed char Update(const PongSim& sim, float timeStep);
+
+	/// The height at which the ball's centre will reach the player's bat
+	/// face, if it is moving towards it.
+	static bool PredictIntercept(const SimParams& params, const SimState& state, SimPlayer player, float& y);
+	/// The same in fixed point, from a state holding fixed point values.
+	static bool PredictInterceptFixed(const SimParams& params, const SimState& state, SimPlayer player, Fixed& y);
+
+private:
+
+	SimPlayer player_;
+	AiParams params_;
+	unsigned randomSeed_;
+	// -1 or 1 for the ball's horizontal direction, or 0 when it is not in play.
+	int ballDirection_;
+	// Against a fixed point simulation these hold fixed point values.
+	float reactionTimer_;
+	bool planned_;
+	float targetY_;
+
+	/// The target the bat aims for on seeing the ball's new course.
+	float PlanTarget(const PongSim& sim);
+	float PlanTargetFixed(const PongSim& sim);
+};
+
+#endif
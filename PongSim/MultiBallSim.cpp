@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <cmath>
+
+#include "MultiBallSim.h"
+
+// Width of a grid cell in ball radii. Smaller cells give fewer false
+// candidates near the bats, at the cost of sweeps crossing more cells.
+const float CELL_SIZE_IN_RADII = 4.0f;
+
+// Most contacts a ball can make in one step, as in PongSim.
+const unsigned MAX_BALL_BOUNCES = 8;
+
+// Served balls start at most this fraction of the way from the centre line
+// to the walls.
+const float SERVE_SPREAD = 0.9f;
+
+MultiBallSim::MultiBallSim(unsigned capacity, const SimParams& params) :
+	params_(params),
+	capacity_(capacity),
+	numBalls_(0),
+	randomSeed_(1),
+	batHits_(0)
+{
+	ballX_.resize(capacity_);
+	ballY_.resize(capacity_);
+	ballVelocityX_.resize(capacity_);
+	ballVelocityY_.resize(capacity_);
+
+	// Lay the arena out exactly as PongSim does.
+	PongSim layout(params_);
+	for (int i = 0; i < NUM_ARENA_BODIES; ++i)
+	{
+		arena_[i] = layout.GetBody((SimBodyIndex)(BODY_PLAYER_ONE_BAT + i));
+	}
+
+	CreateGrid();
+	Reset();
+}
+
+/// Size the grid to the arena grown by a ball's radius, and draw the bodies
+/// that never move into it.
+void MultiBallSim::CreateGrid()
+{
+	float radius = params_.ballRadius_;
+	float minX = 0.0f;
+	float maxX = 0.0f;
+	float minY = 0.0f;
+	float maxY = 0.0f;
+	for (int i = 0; i < NUM_ARENA_BODIES; ++i)
+	{
+		const SimBody& body = arena_[i];
+		minX = std::min(minX, body.x_ - body.halfWidth_ - radius);
+		maxX = std::max(maxX, body.x_ + body.halfWidth_ + radius);
+		minY = std::min(minY, body.y_ - body.halfHeight_ - radius);
+		maxY = std::max(maxY, body.y_ + body.halfHeight_ + radius);
+	}
+
+	float cellSize = radius * CELL_SIZE_IN_RADII;
+	gridMinX_ = minX;
+	gridMaxX_ = maxX;
+	gridMinY_ = minY;
+	inverseCellSize_ = 1.0f / cellSize;
+	gridWidth_ = std::max((int)std::ceil((maxX - minX) * inverseCellSize_), 1);
+	gridHeight_ = std::max((int)std::ceil((maxY - minY) * inverseCellSize_), 1);
+
+	staticCells_.assign(gridWidth_ * gridHeight_, 0);
+	for (unsigned i = ARENA_BOTTOM_WALL; i < NUM_ARENA_BODIES; ++i)
+	{
+		DrawIntoGrid(staticCells_, i);
+	}
+	cells_ = staticCells_;
+}
+
+/// Set the body's bit in every cell that a ball touching it could be centred
+/// in.
+void MultiBallSim::DrawIntoGrid(std::vector<unsigned char>& cells, unsigned index) const
+{
+	const SimBody& body = arena_[index];
+	float extentX = body.halfWidth_ + params_.ballRadius_;
+	float extentY = body.halfHeight_ + params_.ballRadius_;
+	int firstX = GetCellX(body.x_ - extentX);
+	int lastX = GetCellX(body.x_ + extentX);
+	int firstY = GetCellY(body.y_ - extentY);
+	int lastY = GetCellY(body.y_ + extentY);
+
+	for (int y = firstY; y <= lastY; ++y)
+	{
+		for (int x = firstX; x <= lastX; ++x)
+		{
+			cells[y * gridWidth_ + x] |= (unsigned char)(1 << index);
+		}
+	}
+}
+
+inline int MultiBallSim::GetCellX(float x) const
+{
+	float cell = (x - gridMinX_) * inverseCellSize_;
+	if (cell < 0.0f)
+	{
+		return 0;
+	}
+	return std::min((int)cell, gridWidth_ - 1);
+}
+
+inline int MultiBallSim::GetCellY(float y) const
+{
+	float cell = (y - gridMinY_) * inverseCellSize_;
+	if (cell < 0.0f)
+	{
+		return 0;
+	}
+	return std::min((int)cell, gridHeight_ - 1);
+}
+
+/// The bodies in every cell the box around a ball's path overlaps.
+inline unsigned MultiBallSim::GetCandidates(float x, float y, float endX, float endY) const
+{
+	int firstX = GetCellX(std::min(x, endX));
+	int lastX = GetCellX(std::max(x, endX));
+	int firstY = GetCellY(std::min(y, endY));
+	int lastY = GetCellY(std::max(y, endY));
+
+	unsigned candidates = 0;
+	for (int cellY = firstY; cellY <= lastY; ++cellY)
+	{
+		const unsigned char* row = &cells_[cellY * gridWidth_];
+		for (int cellX = firstX; cellX <= lastX; ++cellX)
+		{
+			candidates |= row[cellX];
+		}
+	}
+	return candidates;
+}
+
+void MultiBallSim::Reset()
+{
+	numBalls_ = 0;
+	batHits_ = 0;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		score_[i] = 0;
+		arena_[ARENA_PLAYER_ONE_BAT + i].y_ = 0.0f;
+	}
+
+	std::copy(staticCells_.begin(), staticCells_.end(), cells_.begin());
+	DrawIntoGrid(cells_, ARENA_PLAYER_ONE_BAT);
+	DrawIntoGrid(cells_, ARENA_PLAYER_TWO_BAT);
+}
+
+bool MultiBallSim::Serve()
+{
+	if (numBalls_ == capacity_)
+	{
+		return false;
+	}
+
+	// Random numbers are from 0 to 32767.
+	float range = (params_.wallOffset_ - params_.wallHalfHeight_ - params_.ballRadius_) * SERVE_SPREAD;
+	unsigned ball = numBalls_++;
+	ballX_[ball] = 0.0f;
+	ballY_[ball] = range * ((float)PongSim::NextRandom(randomSeed_) / 16383.5f - 1.0f);
+	PongSim::GetServeVelocity(PongSim::RandomServeDirection(randomSeed_), params_.initialBallSpeed_, ballVelocityX_[ball],
+		ballVelocityY_[ball]);
+	return true;
+}
+
+unsigned MultiBallSim::Step(float timeStep, const SimInput& input)
+{
+	MoveBats(timeStep, input);
+
+	// Redraw the grid with the bats where they are now.
+	std::copy(staticCells_.begin(), staticCells_.end(), cells_.begin());
+	DrawIntoGrid(cells_, ARENA_PLAYER_ONE_BAT);
+	DrawIntoGrid(cells_, ARENA_PLAYER_TWO_BAT);
+
+	unsigned events = SIM_EVENT_NONE;
+	for (unsigned i = 0; i < numBalls_;)
+	{
+		bool removed = false;
+		events |= MoveBall(i, timeStep, removed);
+		// The ball moved into this slot has not been stepped yet.
+		if (removed)
+		{
+			RemoveBall(i);
+		}
+		else
+		{
+			++i;
+		}
+	}
+
+	return events;
+}
+
+/// Move the bats, stopping them just short of the walls as PongSim does.
+void MultiBallSim::MoveBats(float timeStep, const SimInput& input)
+{
+	const SimBody& bottomWall = arena_[ARENA_BOTTOM_WALL];
+	const SimBody& topWall = arena_[ARENA_TOP_WALL];
+
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		SimBody& bat = arena_[ARENA_PLAYER_ONE_BAT + i];
+		bat.y_ += input.batDirection_[i] * params_.batSpeed_ * timeStep;
+
+		float reach = bat.halfHeight_ + topWall.halfHeight_;
+		if (bat.y_ > topWall.y_ - reach)
+		{
+			bat.y_ = topWall.y_ - reach - params_.batWallGap_;
+		}
+		else if (bat.y_ < bottomWall.y_ + reach)
+		{
+			bat.y_ = bottomWall.y_ + reach + params_.batWallGap_;
+		}
+	}
+}
+
+/// Sweep one ball through the step against the bodies in the cells along
+/// its path. Sets removed if the ball reached an end zone or left the arena.
+unsigned MultiBallSim::MoveBall(unsigned ball, float timeStep, bool& removed)
+{
+	float x = ballX_[ball];
+	float y = ballY_[ball];
+	float velocityX = ballVelocityX_[ball];
+	float velocityY = ballVelocityY_[ball];
+	unsigned events = SIM_EVENT_NONE;
+	// Bodies whose contact was ignored this step, as in PongSim::SweepBall.
+	unsigned ignored = 0;
+	float remaining = timeStep;
+
+	SimBody circle;
+	circle.halfWidth_ = params_.ballRadius_;
+	circle.halfHeight_ = params_.ballRadius_;
+
+	for (unsigned bounce = 0; bounce < MAX_BALL_BOUNCES; ++bounce)
+	{
+		unsigned candidates = GetCandidates(x, y, x + velocityX * remaining, y + velocityY * remaining) & ~ignored;
+		int contact = -1;
+		float contactTime = remaining;
+
+		circle.x_ = x;
+		circle.y_ = y;
+		for (int i = 0; candidates; ++i, candidates >>= 1)
+		{
+			float time;
+			if ((candidates & 1) && PongSim::SweepCircleAgainstBox(circle, velocityX, velocityY, arena_[i], contactTime, time) &&
+				(contact < 0 || time < contactTime))
+			{
+				contact = i;
+				contactTime = time;
+			}
+		}
+
+		x += velocityX * contactTime;
+		y += velocityY * contactTime;
+		remaining -= contactTime;
+
+		if (contact < 0)
+		{
+			break;
+		}
+
+		const SimBody& body = arena_[contact];
+		unsigned contactEvents = SIM_EVENT_NONE;
+		if (body.category_ == CATEGORY_BAT)
+		{
+			if ((velocityX < 0.0f) == (body.x_ < 0.0f))
+			{
+				velocityX *= -params_.batSpeedUp_;
+				velocityY *= params_.batSpeedUp_;
+				++batHits_;
+				contactEvents = SIM_EVENT_BAT_HIT;
+			}
+		}
+		else if (body.category_ == CATEGORY_WALL)
+		{
+			if ((velocityY < 0.0f) == (body.y_ < 0.0f))
+			{
+				velocityY = -velocityY;
+				contactEvents = SIM_EVENT_WALL_HIT;
+			}
+		}
+		else
+		{
+			// The player at the other end scores.
+			++score_[body.player_ == PLAYER_TWO ? PLAYER_ONE : PLAYER_TWO];
+			removed = true;
+			return events | SIM_EVENT_POINT_SCORED;
+		}
+
+		if (contactEvents == SIM_EVENT_NONE)
+		{
+			ignored |= 1 << contact;
+		}
+		events |= contactEvents;
+	}
+
+	ballX_[ball] = x;
+	ballY_[ball] = y;
+	ballVelocityX_[ball] = velocityX;
+	ballVelocityY_[ball] = velocityY;
+	removed = x < gridMinX_ || x > gridMaxX_;
+	return events;
+}
+
+/// Fill the gap with the last ball in play.
+void MultiBallSim::RemoveBall(unsigned ball)
+{
+	unsigned last = --numBalls_;
+	ballX_[ball] = ballX_[last];
+	ballY_[ball] = ballY_[last];
+	ballVelocityX_[ball] = ballVelocityX_[last];
+	ballVelocityY_[ball] = ballVelocityY_[last];
+}
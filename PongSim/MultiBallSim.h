@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef PONG_MULTI_BALL_SIM_H
+#define PONG_MULTI_BALL_SIM_H
+
+#include <vector>
+
+#include "PongSim.h"
+
+/// The bodies of the arena a ball can touch, in the order of SimBodyIndex
+/// without the ball.
+enum ArenaBodyIndex
+{
+	ARENA_PLAYER_ONE_BAT = 0,
+	ARENA_PLAYER_TWO_BAT,
+	ARENA_BOTTOM_WALL,
+	ARENA_TOP_WALL,
+	ARENA_PLAYER_ONE_END_ZONE,
+	ARENA_PLAYER_TWO_END_ZONE,
+	NUM_ARENA_BODIES
+};
+
+/// Any number of balls, up to a capacity fixed at construction, in one arena
+/// with one pair of bats. Every ball is swept through each step against the
+/// bats and walls as PongSim's ball is, and scores a point for the player at
+/// the other end when it reaches an end zone, going back to the pool. Balls
+/// pass through each other.
+///
+/// Balls are held as a structure of arrays, with those in play packed at the
+/// front; a ball leaving play is replaced by the last one. Which arena bodies
+/// a ball might touch is looked up in a uniform grid over the arena, in which
+/// each cell has a bit for every body within a ball's radius of it. The walls
+/// and end zones are drawn into the grid once, and the bats again every step.
+/// Most balls are in cells with no bodies at all, and are simply moved.
+/// Stepping never allocates.
+class MultiBallSim
+{
+public:
+
+	explicit MultiBallSim(unsigned capacity, const SimParams& params = SimParams());
+	const SimParams& GetParams() const { return params_; }
+	unsigned GetCapacity() const { return capacity_; }
+	unsigned GetNumBalls() const { return numBalls_; }
+
+	void SetRandomSeed(unsigned seed) { randomSeed_ = seed; }
+	/// Return every ball to the pool, centre the bats and clear the score.
+	void Reset();
+	/// Put a ball from the pool in play on the centre line, at a random
+	/// height and in a random one of the four diagonals. Returns false if
+	/// every ball is already in play.
+	bool Serve();
+	/// Returns the SimEvent flags of everything that happened to any ball.
+	unsigned Step(float timeStep, const SimInput& input);
+
+	const float* GetBallX() const { return &ballX_[0]; }
+	const float* GetBallY() const { return &ballY_[0]; }
+	float GetBatY(SimPlayer player) const { return arena_[ARENA_PLAYER_ONE_BAT + player].y_; }
+	unsigned GetScore(SimPlayer player) const { return score_[player]; }
+	/// Bat hits since the last reset.
+	unsigned GetBatHits() const { return batHits_; }
+
+private:
+
+	SimParams params_;
+	unsigned capacity_;
+	unsigned numBalls_;
+	unsigned randomSeed_;
+	unsigned score_[NUM_PLAYERS];
+	unsigned batHits_;
+	SimBody arena_[NUM_ARENA_BODIES];
+
+	std::vector<float> ballX_;
+	std::vector<float> ballY_;
+	std::vector<float> ballVelocityX_;
+	std::vector<float> ballVelocityY_;
+
+	// The grid covers the arena's bounds; balls outside it use the nearest
+	// cell, and balls past either end are taken out of play.
+	float gridMinX_;
+	float gridMaxX_;
+	float gridMinY_;
+	float inverseCellSize_;
+	int gridWidth_;
+	int gridHeight_;
+	// Bit per ArenaBodyIndex, for the walls and end zones only, and then with
+	// the bats drawn in for the current step.
+	std::vector<unsigned char> staticCells_;
+	std::vector<unsigned char> cells_;
+
+	void CreateGrid();
+	void DrawIntoGrid(std::vector<unsigned char>& cells, unsigned index) const;
+	int GetCellX(float x) const;
+	int GetCellY(float y) const;
+	unsigned GetCandidates(float x, float y, float endX, float endY) const;
+	void MoveBats(float timeStep, const SimInput& input);
+	unsigned MoveBall(unsigned ball, float timeStep, bool& removed);
+	void RemoveBall(unsigned ball);
+};
+
+#endif
@@ -0,0 +1,515 @@
+#include <cmath>
+
+#include "PongSim.h"
+
+// The default arena matches what the Urho3D scene builds on a 1024x768
+// screen, with 100 pixels to a world unit.
+SimParams::SimParams() :
+	batSpeed_(4.0f),
+	batOffset_(4.0f),
+	batHalfWidth_(0.06144f),
+	batHalfHeight_(0.384f),
+	batWallGap_(0.025f),
+	ballRadius_(0.16f),
+	initialBallSpeed_(4.0f),
+	batSpeedUp_(1.03f),
+	wallOffset_(3.0f),
+	wallHalfWidth_(4.608f),
+	wallHalfHeight_(0.0768f),
+	endZoneOffset_(4.1f),
+	endZoneHalfWidth_(0.04096f),
+	endZoneHalfHeight_(3.456f),
+	continuousCollision_(true),
+	fixedPoint_(false)
+{
+}
+
+// sin(45) and cos(45), for the diagonal serves.
+const float DIAGONAL = 0.70710678f;
+
+// Most contacts the swept ball can make in one step; any time left after
+// that is dropped rather than risk the ball passing through something.
+const unsigned MAX_BOUNCES = 8;
+
+// Which categories each category collides with. Bats and walls are the
+// only things that move or stop something, so nothing else has a mask.
+const unsigned char CATEGORY_MASKS[NUM_CATEGORIES] =
+{
+	(1 << CATEGORY_BAT) | (1 << CATEGORY_WALL) | (1 << CATEGORY_END_ZONE),
+	1 << CATEGORY_WALL,
+	0,
+	0
+};
+
+const PongSim::ContactHandler PongSim::contactHandlers_[NUM_CATEGORIES][NUM_CATEGORIES] =
+{
+	{ 0, &PongSim::BallHitsBat, &PongSim::BallHitsWall, &PongSim::BallReachesEndZone },
+	{ 0, 0, &PongSim::BatHitsWall, 0 },
+	{ 0, 0, 0, 0 },
+	{ 0, 0, 0, 0 }
+};
+
+PongSim::PongSim()
+{
+	state_.randomSeed_ = 1;
+	CreateBodies();
+	Reset();
+}
+
+PongSim::PongSim(const SimParams& params) : params_(params)
+{
+	state_.randomSeed_ = 1;
+	CreateBodies();
+	Reset();
+}
+
+void PongSim::SetParams(const SimParams& params)
+{
+	params_ = params;
+	CreateBodies();
+}
+
+/// Lay out the bodies from the parameters. The ball's and bats' positions
+/// are copied from the state whenever they move.
+void PongSim::CreateBodies()
+{
+	static const SimCategory categories[NUM_BODIES] =
+	{
+		CATEGORY_BALL, CATEGORY_BAT, CATEGORY_BAT, CATEGORY_WALL, CATEGORY_WALL, CATEGORY_END_ZONE, CATEGORY_END_ZONE
+	};
+	const float positions[NUM_BODIES][2] =
+	{
+		{ 0.0f, 0.0f },
+		{ -params_.batOffset_, 0.0f },
+		{ params_.batOffset_, 0.0f },
+		{ 0.0f, -params_.wallOffset_ },
+		{ 0.0f, params_.wallOffset_ },
+		{ -params_.endZoneOffset_, 0.0f },
+		{ params_.endZoneOffset_, 0.0f }
+	};
+	const float halfSizes[NUM_BODIES][2] =
+	{
+		{ params_.ballRadius_, params_.ballRadius_ },
+		{ params_.batHalfWidth_, params_.batHalfHeight_ },
+		{ params_.batHalfWidth_, params_.batHalfHeight_ },
+		{ params_.wallHalfWidth_, params_.wallHalfHeight_ },
+		{ params_.wallHalfWidth_, params_.wallHalfHeight_ },
+		{ params_.endZoneHalfWidth_, params_.endZoneHalfHeight_ },
+		{ params_.endZoneHalfWidth_, params_.endZoneHalfHeight_ }
+	};
+
+	for (int i = 0; i < NUM_BODIES; ++i)
+	{
+		SimBody& body = bodies_[i];
+		body.x_ = positions[i][0];
+		body.y_ = positions[i][1];
+		body.halfWidth_ = halfSizes[i][0];
+		body.halfHeight_ = halfSizes[i][1];
+		body.category_ = (unsigned char)categories[i];
+		body.mask_ = CATEGORY_MASKS[categories[i]];
+		body.player_ = (unsigned char)(i == BODY_PLAYER_TWO_BAT || i == BODY_PLAYER_TWO_END_ZONE ? PLAYER_TWO : PLAYER_ONE);
+	}
+
+	CreateRoutes();
+	CreateFixedBodies();
+}
+
+/// Filter each body's mask against every other body once, rather than on
+/// every step.
+void PongSim::CreateRoutes()
+{
+	for (int i = 0; i < NUM_BODIES; ++i)
+	{
+		SimBody& body = bodies_[i];
+		numRoutes_[i] = 0;
+
+		for (int j = 0; j < NUM_BODIES; ++j)
+		{
+			SimBody& other = bodies_[j];
+			if (i != j && (body.mask_ & (1 << other.category_)))
+			{
+				ContactRoute& route = routes_[i][numRoutes_[i]++];
+				route.other_ = j;
+				route.handler_ = contactHandlers_[body.category_][other.category_];
+			}
+		}
+	}
+}
+
+void PongSim::SetRandomSeed(unsigned seed)
+{
+	state_.randomSeed_ = seed;
+}
+
+/// Put the ball and bats back in the centre with no game running.
+void PongSim::Reset()
+{
+	state_.ballX_ = 0.0f;
+	state_.ballY_ = 0.0f;
+	state_.ballVelocityX_ = 0.0f;
+	state_.ballVelocityY_ = 0.0f;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		state_.batY_[i] = 0.0f;
+		state_.batVelocity_[i] = 0.0f;
+	}
+	state_.matchTime_ = 0.0f;
+	state_.rallyLength_ = 0;
+	state_.ballActive_ = false;
+	state_.gameRunning_ = false;
+	state_.winner_ = -1;
+}
+
+unsigned PongSim::NextRandom(unsigned& seed)
+{
+	seed = seed * 214013 + 2531011;
+	return (seed >> 16) & 32767;
+}
+
+unsigned PongSim::MixSeed(unsigned seed, unsigned index)
+{
+	// The index is spread by the golden ratio, then the bits are mixed by
+	// MurmurHash3's finalizer.
+	unsigned hash = seed ^ (index * 0x9e3779b9u);
+	hash ^= hash >> 16;
+	hash *= 0x85ebca6bu;
+	hash ^= hash >> 13;
+	hash *= 0xc2b2ae35u;
+	hash ^= hash >> 16;
+	return hash;
+}
+
+void PongSim::GetServeVelocity(unsigned direction, float speed, float& velocityX, float& velocityY)
+{
+	// Rotating straight up by 45 + direction * 90 degrees anticlockwise.
+	static const float signX[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+	static const float signY[4] = { 1.0f, -1.0f, -1.0f, 1.0f };
+	velocityX = signX[direction & 3] * DIAGONAL * speed;
+	velocityY = signY[direction & 3] * DIAGONAL * speed;
+}
+
+void PongSim::StartGame()
+{
+	state_.matchTime_ = 0.0f;
+	state_.rallyLength_ = 0;
+	state_.winner_ = -1;
+	state_.gameRunning_ = true;
+	Serve();
+}
+
+void PongSim::StopGame()
+{
+	state_.ballActive_ = false;
+	state_.gameRunning_ = false;
+}
+
+/// Move the ball to the centre and set it moving in a random one of the four
+/// diagonals.
+void PongSim::Serve()
+{
+	state_.ballX_ = 0.0f;
+	state_.ballY_ = 0.0f;
+	unsigned direction = RandomServeDirection(state_.randomSeed_);
+	if (params_.fixedPoint_)
+	{
+		GetFixedServeVelocity(direction, state_.ballVelocityX_, state_.ballVelocityY_);
+	}
+	else
+	{
+		GetServeVelocity(direction, params_.initialBallSpeed_, state_.ballVelocityX_, state_.ballVelocityY_);
+	}
+	state_.ballActive_ = true;
+}
+
+unsigned PongSim::Step(float timeStep, const SimInput& input)
+{
+	if (params_.fixedPoint_)
+	{
+		return StepFixed(timeStep, input);
+	}
+
+	unsigned events = MoveBats(timeStep, input);
+
+	if (state_.ballActive_)
+	{
+		events |= MoveBall(timeStep);
+	}
+	if (state_.gameRunning_)
+	{
+		state_.matchTime_ += timeStep;
+	}
+
+	return events;
+}
+
+signed char PongSim::TrackBall(SimPlayer player) const
+{
+	if (state_.ballY_ > state_.batY_[player] + TRACKING_DEAD_ZONE)
+	{
+		return 1;
+	}
+	else if (state_.ballY_ < state_.batY_[player] - TRACKING_DEAD_ZONE)
+	{
+		return -1;
+	}
+	return 0;
+}
+
+/// Move the bats, stopping them just short of a wall they run into.
+unsigned PongSim::MoveBats(float timeStep, const SimInput& input)
+{
+	unsigned events = SIM_EVENT_NONE;
+
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		SimBody& bat = bodies_[BODY_PLAYER_ONE_BAT + i];
+		state_.batVelocity_[i] = input.batDirection_[i] * params_.batSpeed_;
+		bat.y_ = state_.batY_[i] + state_.batVelocity_[i] * timeStep;
+		events |= ResolveContacts(bat);
+		state_.batY_[i] = bat.y_;
+	}
+
+	return events;
+}
+
+/// Move the ball and resolve its contacts.
+unsigned PongSim::MoveBall(float timeStep)
+{
+	if (params_.continuousCollision_)
+	{
+		return SweepBall(timeStep);
+	}
+
+	SimBody& ball = bodies_[BODY_BALL];
+	state_.ballX_ += state_.ballVelocityX_ * timeStep;
+	state_.ballY_ += state_.ballVelocityY_ * timeStep;
+	ball.x_ = state_.ballX_;
+	ball.y_ = state_.ballY_;
+	return ResolveContacts(ball);
+}
+
+/// Move the ball to its first contact in the step, handle it, and carry on
+/// from there with whatever time is left, until the step is used up.
+unsigned PongSim::SweepBall(float timeStep)
+{
+	SimBody& ball = bodies_[BODY_BALL];
+	unsigned events = SIM_EVENT_NONE;
+	// Bodies whose handler ignored a contact this step, e.g. a bat the ball
+	// is already moving away from. They are skipped so the ball cannot stick.
+	unsigned ignored = 0;
+	float remaining = timeStep;
+	ball.x_ = state_.ballX_;
+	ball.y_ = state_.ballY_;
+
+	for (unsigned bounce = 0; bounce < MAX_BOUNCES && state_.ballActive_; ++bounce)
+	{
+		const ContactRoute* contact = 0;
+		float contactTime = remaining;
+
+		for (unsigned i = 0; i < numRoutes_[BODY_BALL]; ++i)
+		{
+			const ContactRoute& route = routes_[BODY_BALL][i];
+			float time;
+			if (!(ignored & (1 << route.other_)) &&
+				SweepCircleAgainstBox(ball, state_.ballVelocityX_, state_.ballVelocityY_, bodies_[route.other_], contactTime, time) &&
+				(!contact || time < contactTime))
+			{
+				contact = &route;
+				contactTime = time;
+			}
+		}
+
+		state_.ballX_ += state_.ballVelocityX_ * contactTime;
+		state_.ballY_ += state_.ballVelocityY_ * contactTime;
+		ball.x_ = state_.ballX_;
+		ball.y_ = state_.ballY_;
+		remaining -= contactTime;
+
+		if (!contact)
+		{
+			break;
+		}
+
+		unsigned contactEvents = (this->*contact->handler_)(ball, bodies_[contact->other_]);
+		if (contactEvents == SIM_EVENT_NONE)
+		{
+			ignored |= 1 << contact->other_;
+		}
+		events |= contactEvents;
+	}
+
+	return events;
+}
+
+/// Narrow one axis of the interval in which the moving ball's centre is
+/// inside the box grown by the ball's radius.
+static bool SweepAxis(float position, float velocity, float extent, float& enter, float& exit)
+{
+	if (velocity == 0.0f)
+	{
+		return std::fabs(position) < extent;
+	}
+
+	float first = (-extent - position) / velocity;
+	float last = (extent - position) / velocity;
+	if (first > last)
+	{
+		float swap = first;
+		first = last;
+		last = swap;
+	}
+	enter = first > enter ? first : enter;
+	exit = last < exit ? last : exit;
+	return enter <= exit;
+}
+
+bool PongSim::CircleOverlapsBox(const SimBody& circle, const SimBody& box)
+{
+	// Most boxes are far away horizontally; rejecting them early gives the
+	// same answer as the full test.
+	float dx = std::fabs(circle.x_ - box.x_) - box.halfWidth_;
+	if (dx >= circle.halfWidth_)
+	{
+		return false;
+	}
+	float dy = std::fabs(circle.y_ - box.y_) - box.halfHeight_;
+	dx = dx > 0.0f ? dx : 0.0f;
+	dy = dy > 0.0f ? dy : 0.0f;
+	return dx * dx + dy * dy < circle.halfWidth_ * circle.halfWidth_;
+}
+
+/// The circle's centre is traced against the box grown by the radius, with
+/// the corners rounded off.
+bool PongSim::SweepCircleAgainstBox(const SimBody& circle, float velocityX, float velocityY, const SimBody& box, float maxTime,
+	float& time)
+{
+	float relativeX = circle.x_ - box.x_;
+	float relativeY = circle.y_ - box.y_;
+	float radius = circle.halfWidth_;
+
+	// Already touching: a contact now, unless the circle is moving away.
+	if (CircleOverlapsBox(circle, box))
+	{
+		float closestX = relativeX < -box.halfWidth_ ? -box.halfWidth_ : (relativeX > box.halfWidth_ ? box.halfWidth_ : relativeX);
+		float closestY = relativeY < -box.halfHeight_ ? -box.halfHeight_ : (relativeY > box.halfHeight_ ? box.halfHeight_ : relativeY);
+		bool inside = closestX == relativeX && closestY == relativeY;
+		time = 0.0f;
+		return inside || velocityX * (closestX - relativeX) + velocityY * (closestY - relativeY) > 0.0f;
+	}
+
+	float enter = 0.0f;
+	float exit = maxTime;
+	if (!SweepAxis(relativeX, velocityX, box.halfWidth_ + radius, enter, exit) ||
+		!SweepAxis(relativeY, velocityY, box.halfHeight_ + radius, enter, exit))
+	{
+		return false;
+	}
+
+	// Entering the grown box beside a face is a contact; entering it beside a
+	// corner is only one if the path also crosses the circle around the corner.
+	float hitX = relativeX + velocityX * enter;
+	float hitY = relativeY + velocityY * enter;
+	if (std::fabs(hitX) <= box.halfWidth_ || std::fabs(hitY) <= box.halfHeight_)
+	{
+		time = enter;
+		return true;
+	}
+
+	float toCornerX = relativeX - (hitX < 0.0f ? -box.halfWidth_ : box.halfWidth_);
+	float toCornerY = relativeY - (hitY < 0.0f ? -box.halfHeight_ : box.halfHeight_);
+	float a = velocityX * velocityX + velocityY * velocityY;
+	float b = toCornerX * velocityX + toCornerY * velocityY;
+	float c = toCornerX * toCornerX + toCornerY * toCornerY - radius * radius;
+	float discriminant = b * b - a * c;
+	if (discriminant < 0.0f)
+	{
+		return false;
+	}
+
+	time = (-b - std::sqrt(discriminant)) / a;
+	time = time > 0.0f ? time : 0.0f;
+	return time <= exit;
+}
+
+/// Circle against box if the body is the ball, otherwise box against box.
+inline bool PongSim::BodiesOverlap(const SimBody& body, const SimBody& other) const
+{
+	if (body.category_ == CATEGORY_BALL)
+	{
+		return CircleOverlapsBox(body, other);
+	}
+
+	return std::fabs(body.x_ - other.x_) < body.halfWidth_ + other.halfWidth_ &&
+		std::fabs(body.y_ - other.y_) < body.halfHeight_ + other.halfHeight_;
+}
+
+/// Run the handler for every body overlapping this one that its mask
+/// selects.
+unsigned PongSim::ResolveContacts(SimBody& body)
+{
+	unsigned events = SIM_EVENT_NONE;
+	unsigned index = (unsigned)(&body - bodies_);
+
+	for (unsigned i = 0; i < numRoutes_[index]; ++i)
+	{
+		const ContactRoute& route = routes_[index][i];
+		SimBody& other = bodies_[route.other_];
+		if (BodiesOverlap(body, other))
+		{
+			events |= (this->*route.handler_)(body, other);
+		}
+	}
+
+	return events;
+}
+
+// A contact only takes effect while the ball is moving into the object, so
+// it is handled once per touch like a trigger collider's begin contact.
+
+/// Reflect horizontally, and speed up slightly.
+unsigned PongSim::BallHitsBat(SimBody&, SimBody& bat)
+{
+	if ((state_.ballVelocityX_ < 0.0f) != (bat.x_ < 0.0f))
+	{
+		return SIM_EVENT_NONE;
+	}
+
+	state_.ballVelocityX_ *= -params_.batSpeedUp_;
+	state_.ballVelocityY_ *= params_.batSpeedUp_;
+	++state_.rallyLength_;
+	return SIM_EVENT_BAT_HIT;
+}
+
+/// Reflect vertically.
+unsigned PongSim::BallHitsWall(SimBody&, SimBody& wall)
+{
+	if ((state_.ballVelocityY_ < 0.0f) != (wall.y_ < 0.0f))
+	{
+		return SIM_EVENT_NONE;
+	}
+
+	state_.ballVelocityY_ = -state_.ballVelocityY_;
+	return SIM_EVENT_WALL_HIT;
+}
+
+/// The player at the other end wins.
+unsigned PongSim::BallReachesEndZone(SimBody&, SimBody& endZone)
+{
+	if (!state_.ballActive_)
+	{
+		return SIM_EVENT_NONE;
+	}
+
+	state_.winner_ = endZone.player_ == PLAYER_TWO ? PLAYER_ONE : PLAYER_TWO;
+	StopGame();
+	return SIM_EVENT_GAME_END;
+}
+
+/// Move the bat just away from the wall so that it is not quite touching it.
+unsigned PongSim::BatHitsWall(SimBody& bat, SimBody& wall)
+{
+	float offset = bat.halfHeight_ + wall.halfHeight_ + params_.batWallGap_;
+	bat.y_ = bat.y_ > wall.y_ ? wall.y_ + offset : wall.y_ - offset;
+	state_.batVelocity_[bat.player_] = 0.0f;
+	return SIM_EVENT_BAT_STOPPED;
+}
@@ -0,0 +1,242 @@
+#pragma once
+
+#ifndef PONG_SIM_H
+#define PONG_SIM_H
+
+#include "FixedPoint.h"
+
+/// Dimensions, speeds and rules of the arena, in world units. The arena is
+/// centred on the origin, with the bats either side of it on the x axis and
+/// the walls above and below. The defaults are the arena the game ships
+/// with, bin/Data/Arena.params.
+struct SimParams
+{
+	SimParams();
+
+	float batSpeed_;
+	float batOffset_;
+	float batHalfWidth_;
+	float batHalfHeight_;
+	// Gap left between a bat and a wall it has been stopped by.
+	float batWallGap_;
+	float ballRadius_;
+	float initialBallSpeed_;
+	// Multiplier applied to the ball's velocity on every bat hit.
+	float batSpeedUp_;
+	float wallOffset_;
+	float wallHalfWidth_;
+	float wallHalfHeight_;
+	float endZoneOffset_;
+	float endZoneHalfWidth_;
+	float endZoneHalfHeight_;
+	// Sweep the ball through each step so that it cannot pass through the
+	// thin bats and walls however fast it moves or however long the step.
+	// When false, contacts are only found where bodies overlap at the end of
+	// a step.
+	bool continuousCollision_;
+	// Step the ball and bats in Q16.16 fixed point, which gives the same
+	// result on every compiler and CPU, for lockstep play and replays between
+	// machines. The ball is always swept. The state's floats then only ever
+	// hold values exactly representable in Q16.16.
+	bool fixedPoint_;
+};
+
+enum SimPlayer
+{
+	PLAYER_ONE = 0,
+	PLAYER_TWO = 1,
+	NUM_PLAYERS = 2
+};
+
+/// Per step input: the direction each bat is being moved in, 1 for up, -1 for
+/// down and 0 for stationary.
+struct SimInput
+{
+	signed char batDirection_[NUM_PLAYERS];
+};
+
+/// A bat moved by PongSim::TrackBall stops within this distance of the ball.
+const float TRACKING_DEAD_ZONE = 0.05f;
+
+/// The complete state of a match. Plain data, so it can be copied freely.
+struct SimState
+{
+	float ballX_;
+	float ballY_;
+	float ballVelocityX_;
+	float ballVelocityY_;
+	float batY_[NUM_PLAYERS];
+	float batVelocity_[NUM_PLAYERS];
+	float matchTime_;
+	unsigned randomSeed_;
+	// Number of bat hits in the current match.
+	unsigned rallyLength_;
+	bool ballActive_;
+	bool gameRunning_;
+	// The winning SimPlayer of the last match, or -1 if there is none yet.
+	signed char winner_;
+};
+
+/// Collision categories. A body only generates contacts with bodies whose
+/// category bit is set in its mask, and each pair of categories has exactly
+/// one contact handler.
+enum SimCategory
+{
+	CATEGORY_BALL = 0,
+	CATEGORY_BAT,
+	CATEGORY_WALL,
+	CATEGORY_END_ZONE,
+	NUM_CATEGORIES
+};
+
+/// Bodies in the arena, in the order their contacts are resolved.
+enum SimBodyIndex
+{
+	BODY_BALL = 0,
+	BODY_PLAYER_ONE_BAT,
+	BODY_PLAYER_TWO_BAT,
+	BODY_BOTTOM_WALL,
+	BODY_TOP_WALL,
+	BODY_PLAYER_ONE_END_ZONE,
+	BODY_PLAYER_TWO_END_ZONE,
+	NUM_BODIES
+};
+
+/// Collision shape of a body. The ball is a circle with a radius of
+/// halfWidth_; everything else is an axis aligned box.
+struct SimBody
+{
+	float x_;
+	float y_;
+	float halfWidth_;
+	float halfHeight_;
+	unsigned char category_;
+	// Bit per SimCategory this body collides with.
+	unsigned char mask_;
+	// The SimPlayer a bat or end zone belongs to.
+	unsigned char player_;
+};
+
+/// Flags returned by PongSim::Step describing what happened during the step.
+enum SimEvent
+{
+	SIM_EVENT_NONE = 0,
+	SIM_EVENT_BAT_HIT = 1 << 0,
+	SIM_EVENT_WALL_HIT = 1 << 1,
+	SIM_EVENT_GAME_END = 1 << 2,
+	SIM_EVENT_BAT_STOPPED = 1 << 3,
+	// Only from MultiBallSim, which plays on after a ball reaches an end zone.
+	SIM_EVENT_POINT_SCORED = 1 << 4
+};
+
+/// The streams of random numbers a match's seed is split into with
+/// PongSim::MixSeed, so that the serves and each player draw from their own.
+enum SeedStream
+{
+	SEED_SERVES = 0,
+	SEED_PLAYER_ONE,
+	SEED_PLAYER_TWO
+};
+
+/// Engine independent Pong simulation. Collisions are resolved analytically,
+/// by default at the exact time of impact within a step: the ball reflects
+/// horizontally and speeds up off the bats, reflects vertically off the
+/// walls, and ends the game when it reaches an end zone. Bats stop short of
+/// the walls. Stepping never allocates.
+class PongSim
+{
+public:
+
+	PongSim();
+	explicit PongSim(const SimParams& params);
+	void SetParams(const SimParams& params);
+	const SimParams& GetParams() const { return params_; }
+	const SimBody& GetBody(SimBodyIndex index) const { return bodies_[index]; }
+	void SetRandomSeed(unsigned seed);
+	void Reset();
+	SimState& GetState() { return state_; }
+	const SimState& GetState() const { return state_; }
+	void StartGame();
+	void StopGame();
+	unsigned Step(float timeStep, const SimInput& input);
+	/// Direction that moves the player's bat towards the ball's height.
+	signed char TrackBall(SimPlayer player) const;
+
+	/// Same linear congruential generator as Urho3D's Rand(), so that a seed
+	/// produces the same serves as it did with the engine's generator.
+	static unsigned NextRandom(unsigned& seed);
+	/// A seed of its own for each index, e.g. each match of a run, from one
+	/// seed. The generator's first numbers hardly differ between consecutive
+	/// seeds, so seeds are hashed apart rather than counted up.
+	static unsigned MixSeed(unsigned seed, unsigned index);
+	/// Pick a serve direction from the generator.
+	static unsigned RandomServeDirection(unsigned& seed) { return NextRandom(seed) >> 13; }
+	/// The direction the next serve will take, without using up the number.
+	unsigned GetNextServeDirection() const { unsigned seed = state_.randomSeed_; return RandomServeDirection(seed); }
+	/// The serve direction, 0 to 3, is one of the four diagonals.
+	static void GetServeVelocity(unsigned direction, float speed, float& velocityX, float& velocityY);
+	/// Whether a circle, with a radius of its halfWidth_, overlaps a box.
+	static bool CircleOverlapsBox(const SimBody& circle, const SimBody& box);
+	/// Find the earliest time within maxTime at which a moving circle touches
+	/// a box. A circle already touching the box touches it at time 0, unless
+	/// it is moving away.
+	static bool SweepCircleAgainstBox(const SimBody& circle, float velocityX, float velocityY, const SimBody& box, float maxTime,
+		float& time);
+
+private:
+
+	typedef unsigned (PongSim::*ContactHandler)(SimBody& body, SimBody& other);
+
+	/// A body's shape in fixed point, for the fixed point step.
+	struct FixedBody
+	{
+		Fixed x_;
+		Fixed y_;
+		Fixed halfWidth_;
+		Fixed halfHeight_;
+	};
+
+	/// A body another body's mask selects, with the handler for the pair
+	/// already looked up.
+	struct ContactRoute
+	{
+		unsigned other_;
+		ContactHandler handler_;
+	};
+
+	SimParams params_;
+	SimState state_;
+	SimBody bodies_[NUM_BODIES];
+	ContactRoute routes_[NUM_BODIES][NUM_BODIES];
+	unsigned numRoutes_[NUM_BODIES];
+	static const ContactHandler contactHandlers_[NUM_CATEGORIES][NUM_CATEGORIES];
+	// The parameters the fixed point step uses, converted once.
+	FixedBody fixedBodies_[NUM_BODIES];
+	Fixed fixedBatSpeed_;
+	Fixed fixedBatSpeedUp_;
+	Fixed fixedBatWallGap_;
+	Fixed fixedServeSpeed_;
+
+	void CreateBodies();
+	void CreateRoutes();
+	void Serve();
+	unsigned MoveBats(float timeStep, const SimInput& input);
+	unsigned MoveBall(float timeStep);
+	unsigned SweepBall(float timeStep);
+	unsigned ResolveContacts(SimBody& body);
+	bool BodiesOverlap(const SimBody& body, const SimBody& other) const;
+	unsigned BallHitsBat(SimBody& ball, SimBody& bat);
+	unsigned BallHitsWall(SimBody& ball, SimBody& wall);
+	unsigned BallReachesEndZone(SimBody& ball, SimBody& endZone);
+	unsigned BatHitsWall(SimBody& bat, SimBody& wall);
+
+	void CreateFixedBodies();
+	void GetFixedServeVelocity(unsigned direction, float& velocityX, float& velocityY) const;
+	unsigned StepFixed(float timeStep, const SimInput& input);
+	unsigned MoveBatsFixed(Fixed timeStep, const SimInput& input);
+	unsigned SweepBallFixed(Fixed timeStep);
+	bool SweepBallAgainstBodyFixed(const FixedBody& ball, Fixed velocityX, Fixed velocityY, const FixedBody& box, Fixed maxTime,
+		Fixed& time) const;
+};
+
+#endif
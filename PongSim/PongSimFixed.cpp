@@ -0,0 +1,251 @@
+#include "PongSim.h"
+
+// sin(45) and cos(45) in Q16.16, for the diagonal serves.
+const Fixed FIXED_DIAGONAL = 46341;
+
+// Most contacts the ball can make in one step, as in the floating point
+// sweep.
+const unsigned MAX_FIXED_BOUNCES = 8;
+
+/// Convert the parameters once. Conversion rounds to the nearest value, so
+/// the same parameters give the same fixed point arena everywhere.
+void PongSim::CreateFixedBodies()
+{
+	for (int i = 0; i < NUM_BODIES; ++i)
+	{
+		const SimBody& body = bodies_[i];
+		FixedBody& fixedBody = fixedBodies_[i];
+		fixedBody.x_ = ToFixed(body.x_);
+		fixedBody.y_ = ToFixed(body.y_);
+		fixedBody.halfWidth_ = ToFixed(body.halfWidth_);
+		fixedBody.halfHeight_ = ToFixed(body.halfHeight_);
+	}
+	fixedBatSpeed_ = ToFixed(params_.batSpeed_);
+	fixedBatSpeedUp_ = ToFixed(params_.batSpeedUp_);
+	fixedBatWallGap_ = ToFixed(params_.batWallGap_);
+	fixedServeSpeed_ = ToFixed(params_.initialBallSpeed_);
+}
+
+void PongSim::GetFixedServeVelocity(unsigned direction, float& velocityX, float& velocityY) const
+{
+	static const Fixed signX[4] = { -1, -1, 1, 1 };
+	static const Fixed signY[4] = { 1, -1, -1, 1 };
+	Fixed speed = FixedMultiply(FIXED_DIAGONAL, fixedServeSpeed_);
+	velocityX = FixedToFloat(signX[direction & 3] * speed);
+	velocityY = FixedToFloat(signY[direction & 3] * speed);
+}
+
+/// The same rules as the floating point step, in Q16.16. The state is read
+/// from and written back to the floats, which hold fixed point values
+/// exactly. The match time is a plain float sum of the time steps, which
+/// rounds the same everywhere as it is a single addition.
+unsigned PongSim::StepFixed(float timeStep, const SimInput& input)
+{
+	Fixed step = ToFixed(timeStep);
+	unsigned events = MoveBatsFixed(step, input);
+
+	if (state_.ballActive_)
+	{
+		events |= SweepBallFixed(step);
+	}
+	if (state_.gameRunning_)
+	{
+		state_.matchTime_ += timeStep;
+	}
+
+	return events;
+}
+
+/// Move the bats, stopping them just short of a wall they run into.
+unsigned PongSim::MoveBatsFixed(Fixed timeStep, const SimInput& input)
+{
+	unsigned events = SIM_EVENT_NONE;
+
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		SimBody& bat = bodies_[BODY_PLAYER_ONE_BAT + i];
+		FixedBody& fixedBat = fixedBodies_[BODY_PLAYER_ONE_BAT + i];
+		Fixed velocity = input.batDirection_[i] * fixedBatSpeed_;
+		fixedBat.y_ = ToFixed(state_.batY_[i]) + FixedMultiply(velocity, timeStep);
+
+		for (int j = BODY_BOTTOM_WALL; j <= BODY_TOP_WALL; ++j)
+		{
+			const FixedBody& wall = fixedBodies_[j];
+			if (FixedAbs(fixedBat.x_ - wall.x_) < fixedBat.halfWidth_ + wall.halfWidth_ &&
+				FixedAbs(fixedBat.y_ - wall.y_) < fixedBat.halfHeight_ + wall.halfHeight_)
+			{
+				Fixed offset = fixedBat.halfHeight_ + wall.halfHeight_ + fixedBatWallGap_;
+				fixedBat.y_ = fixedBat.y_ > wall.y_ ? wall.y_ + offset : wall.y_ - offset;
+				velocity = 0;
+				events |= SIM_EVENT_BAT_STOPPED;
+			}
+		}
+
+		state_.batY_[i] = FixedToFloat(fixedBat.y_);
+		state_.batVelocity_[i] = FixedToFloat(velocity);
+		bat.y_ = state_.batY_[i];
+	}
+
+	return events;
+}
+
+/// Move the ball to its first contact in the step, handle it, and carry on
+/// with whatever time is left, as SweepBall does.
+unsigned PongSim::SweepBallFixed(Fixed timeStep)
+{
+	FixedBody ball = fixedBodies_[BODY_BALL];
+	ball.x_ = ToFixed(state_.ballX_);
+	ball.y_ = ToFixed(state_.ballY_);
+	Fixed velocityX = ToFixed(state_.ballVelocityX_);
+	Fixed velocityY = ToFixed(state_.ballVelocityY_);
+	unsigned events = SIM_EVENT_NONE;
+	unsigned ignored = 0;
+	Fixed remaining = timeStep;
+
+	for (unsigned bounce = 0; bounce < MAX_FIXED_BOUNCES && state_.ballActive_; ++bounce)
+	{
+		int contact = -1;
+		Fixed contactTime = remaining;
+
+		for (unsigned i = 0; i < numRoutes_[BODY_BALL]; ++i)
+		{
+			unsigned other = routes_[BODY_BALL][i].other_;
+			Fixed time;
+			if (!(ignored & (1 << other)) &&
+				SweepBallAgainstBodyFixed(ball, velocityX, velocityY, fixedBodies_[other], contactTime, time) &&
+				(contact < 0 || time < contactTime))
+			{
+				contact = (int)other;
+				contactTime = time;
+			}
+		}
+
+		ball.x_ += FixedMultiply(velocityX, contactTime);
+		ball.y_ += FixedMultiply(velocityY, contactTime);
+		remaining -= contactTime;
+
+		if (contact < 0)
+		{
+			break;
+		}
+
+		// The same responses as the contact handlers.
+		const SimBody& body = bodies_[contact];
+		unsigned contactEvents = SIM_EVENT_NONE;
+		if (body.category_ == CATEGORY_BAT)
+		{
+			if ((velocityX < 0) == (body.x_ < 0.0f))
+			{
+				velocityX = FixedMultiply(-velocityX, fixedBatSpeedUp_);
+				velocityY = FixedMultiply(velocityY, fixedBatSpeedUp_);
+				++state_.rallyLength_;
+				contactEvents = SIM_EVENT_BAT_HIT;
+			}
+		}
+		else if (body.category_ == CATEGORY_WALL)
+		{
+			if ((velocityY < 0) == (body.y_ < 0.0f))
+			{
+				velocityY = -velocityY;
+				contactEvents = SIM_EVENT_WALL_HIT;
+			}
+		}
+		else
+		{
+			state_.winner_ = body.player_ == PLAYER_TWO ? PLAYER_ONE : PLAYER_TWO;
+			StopGame();
+			contactEvents = SIM_EVENT_GAME_END;
+		}
+
+		if (contactEvents == SIM_EVENT_NONE)
+		{
+			ignored |= 1 << contact;
+		}
+		events |= contactEvents;
+	}
+
+	state_.ballX_ = FixedToFloat(ball.x_);
+	state_.ballY_ = FixedToFloat(ball.y_);
+	state_.ballVelocityX_ = FixedToFloat(velocityX);
+	state_.ballVelocityY_ = FixedToFloat(velocityY);
+	bodies_[BODY_BALL].x_ = state_.ballX_;
+	bodies_[BODY_BALL].y_ = state_.ballY_;
+	return events;
+}
+
+/// Narrow one axis of the interval in which the ball's centre is inside the
+/// box grown by the ball's radius, as SweepAxis does.
+static bool SweepAxisFixed(Fixed position, Fixed velocity, Fixed extent, Fixed& enter, Fixed& exit)
+{
+	if (velocity == 0)
+	{
+		return FixedAbs(position) < extent;
+	}
+
+	Fixed first = FixedDivide(-extent - position, velocity);
+	Fixed last = FixedDivide(extent - position, velocity);
+	if (first > last)
+	{
+		Fixed swap = first;
+		first = last;
+		last = swap;
+	}
+	enter = first > enter ? first : enter;
+	exit = last < exit ? last : exit;
+	return enter <= exit;
+}
+
+/// SweepCircleAgainstBox in fixed point. Squared distances are kept with
+/// 32 fraction bits, so nothing is lost before the comparisons.
+bool PongSim::SweepBallAgainstBodyFixed(const FixedBody& ball, Fixed velocityX, Fixed velocityY, const FixedBody& box,
+	Fixed maxTime, Fixed& time) const
+{
+	Fixed relativeX = ball.x_ - box.x_;
+	Fixed relativeY = ball.y_ - box.y_;
+	Fixed radius = ball.halfWidth_;
+
+	Fixed closestX = relativeX < -box.halfWidth_ ? -box.halfWidth_ : (relativeX > box.halfWidth_ ? box.halfWidth_ : relativeX);
+	Fixed closestY = relativeY < -box.halfHeight_ ? -box.halfHeight_ : (relativeY > box.halfHeight_ ? box.halfHeight_ : relativeY);
+	long long distanceX = closestX - relativeX;
+	long long distanceY = closestY - relativeY;
+	if (distanceX * distanceX + distanceY * distanceY < (long long)radius * radius)
+	{
+		bool inside = distanceX == 0 && distanceY == 0;
+		time = 0;
+		return inside || (long long)velocityX * distanceX + (long long)velocityY * distanceY > 0;
+	}
+
+	Fixed enter = 0;
+	Fixed exit = maxTime;
+	if (!SweepAxisFixed(relativeX, velocityX, box.halfWidth_ + radius, enter, exit) ||
+		!SweepAxisFixed(relativeY, velocityY, box.halfHeight_ + radius, enter, exit))
+	{
+		return false;
+	}
+
+	Fixed hitX = relativeX + FixedMultiply(velocityX, enter);
+	Fixed hitY = relativeY + FixedMultiply(velocityY, enter);
+	if (FixedAbs(hitX) <= box.halfWidth_ || FixedAbs(hitY) <= box.halfHeight_)
+	{
+		time = enter;
+		return true;
+	}
+
+	// Solve for the time the path crosses the circle around the corner, with
+	// the quadratic's terms in Q16.16 and the discriminant in Q32.32, all 64
+	// bit so that a very fast ball cannot overflow them.
+	long long toCornerX = relativeX - (hitX < 0 ? -box.halfWidth_ : box.halfWidth_);
+	long long toCornerY = relativeY - (hitY < 0 ? -box.halfHeight_ : box.halfHeight_);
+	long long a = ((long long)velocityX * velocityX + (long long)velocityY * velocityY) >> FIXED_SHIFT;
+	long long b = (toCornerX * velocityX + toCornerY * velocityY) >> FIXED_SHIFT;
+	long long c = (toCornerX * toCornerX + toCornerY * toCornerY - (long long)radius * radius) >> FIXED_SHIFT;
+	long long discriminant = b * b - a * c;
+	if (a <= 0 || discriminant < 0)
+	{
+		return false;
+	}
+
+	time = FixedDivide(-b - FixedSqrtWide(discriminant), a);
+	time = time > 0 ? time : 0;
+	return time <= exit;
+}
@@ -0,0 +1,71 @@
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+#ifdef __APPLE__
+#include <mach/mach.h>
+#endif
+
+#include "ProcessStats.h"
+
+double GetProcessCpuTime()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+	{
+		return 0.0;
+	}
+	// In units of 100 ns.
+	unsigned long long total = ((unsigned long long)kernel.dwHighDateTime << 32 | kernel.dwLowDateTime) +
+		((unsigned long long)user.dwHighDateTime << 32 | user.dwLowDateTime);
+	return total * 1e-7;
+#else
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage))
+	{
+		return 0.0;
+	}
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+#endif
+}
+
+unsigned long long GetResidentMemory()
+{
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof counters))
+	{
+		return 0;
+	}
+	return counters.WorkingSetSize;
+#elif defined(__APPLE__)
+	mach_task_basic_info info;
+	mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+	if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS)
+	{
+		return 0;
+	}
+	return info.resident_size;
+#else
+	// The second field is the resident set in pages.
+	FILE* file = fopen("/proc/self/statm", "r");
+	if (!file)
+	{
+		return 0;
+	}
+	unsigned long long size = 0;
+	unsigned long long resident = 0;
+	int fields = fscanf(file, "%llu %llu", &size, &resident);
+	fclose(file);
+	if (fields != 2)
+	{
+		return 0;
+	}
+	return resident * (unsigned long long)sysconf(_SC_PAGESIZE);
+#endif
+}
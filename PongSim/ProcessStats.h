@@ -0,0 +1,13 @@
+#pragma once
+
+#ifndef PONG_PROCESS_STATS_H
+#define PONG_PROCESS_STATS_H
+
+/// Seconds of CPU time, user and system, used by every thread of the
+/// process so far.
+double GetProcessCpuTime();
+/// Bytes of the process's memory resident in RAM, or 0 where it cannot be
+/// told.
+unsigned long long GetResidentMemory();
+
+#endif
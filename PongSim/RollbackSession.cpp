@@ -0,0 +1,225 @@
+#include <algorithm>
+
+#include "RollbackSession.h"
+
+// Identifies a packet, followed by the seed so that peers which do not share
+// a match ignore each other.
+const unsigned ROLLBACK_PACKET_MAGIC = 0x50524231;
+
+// Magic, seed, acknowledgement, first frame and input count.
+const unsigned ROLLBACK_PACKET_HEADER = 17;
+
+// Most inputs in a packet. The peers never get this far apart.
+const unsigned ROLLBACK_MAX_PACKET_INPUTS = 255;
+
+// Layout of a packed input: the bat direction in two bits and a start bit.
+const unsigned char NET_INPUT_UP = 1;
+const unsigned char NET_INPUT_DOWN = 2;
+const unsigned char NET_INPUT_DIRECTION = 3;
+const unsigned char NET_INPUT_START = 4;
+
+RollbackStats::RollbackStats() :
+	rollbacks_(0),
+	resimulatedFrames_(0),
+	maxRollbackFrames_(0),
+	rejectedPackets_(0)
+{
+}
+
+static void WriteInt(unsigned char* buffer, unsigned value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		buffer[i] = (unsigned char)(value >> (i * 8));
+	}
+}
+
+static unsigned ReadInt(const unsigned char* buffer)
+{
+	unsigned value = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		value |= (unsigned)buffer[i] << (i * 8);
+	}
+	return value;
+}
+
+static signed char UnpackDirection(unsigned char input)
+{
+	input &= NET_INPUT_DIRECTION;
+	return input == NET_INPUT_UP ? 1 : (input == NET_INPUT_DOWN ? -1 : 0);
+}
+
+RollbackSession::RollbackSession(PongSim& sim, unsigned seed, SimPlayer localPlayer, unsigned inputDelay, unsigned maxRollback,
+	float timeStep) :
+	sim_(sim),
+	seed_(seed),
+	localPlayer_(localPlayer),
+	remotePlayer_(localPlayer == PLAYER_ONE ? PLAYER_TWO : PLAYER_ONE),
+	inputDelay_((int)inputDelay),
+	maxRollback_(std::max((int)maxRollback, 1)),
+	timeStep_(timeStep),
+	ringSize_(2 * (maxRollback_ + 2 * inputDelay_) + 2),
+	frame_(0),
+	// The first inputDelay frames have no input from either player.
+	lastLocalFrame_(inputDelay_ - 1),
+	lastRemoteFrame_(inputDelay_ - 1),
+	remoteAck_(inputDelay_ - 1),
+	firstMispredicted_(-1)
+{
+	states_.resize(ringSize_);
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		inputs_[i].resize(ringSize_, 0);
+	}
+	usedRemoteInputs_.resize(ringSize_, 0);
+
+	sim_.Reset();
+	sim_.SetRandomSeed(seed_);
+}
+
+bool RollbackSession::CanAdvance() const
+{
+	return frame_ - lastRemoteFrame_ <= maxRollback_;
+}
+
+void RollbackSession::AddLocalInput(signed char batDirection, bool start)
+{
+	unsigned char input = batDirection > 0 ? NET_INPUT_UP : (batDirection < 0 ? NET_INPUT_DOWN : 0);
+	if (start)
+	{
+		input |= NET_INPUT_START;
+	}
+
+	// Input is only ever scheduled up to inputDelay frames ahead.
+	if (lastLocalFrame_ < frame_ + inputDelay_)
+	{
+		++lastLocalFrame_;
+		inputs_[localPlayer_][Slot(lastLocalFrame_)] = input;
+	}
+}
+
+unsigned RollbackSession::AdvanceFrame()
+{
+	unsigned events = SIM_EVENT_NONE;
+
+	if (firstMispredicted_ >= 0)
+	{
+		int rollbackFrames = frame_ - firstMispredicted_;
+		++stats_.rollbacks_;
+		stats_.resimulatedFrames_ += rollbackFrames;
+		stats_.maxRollbackFrames_ = std::max(stats_.maxRollbackFrames_, (unsigned)rollbackFrames);
+
+		sim_.GetState() = states_[Slot(firstMispredicted_)];
+		for (int frame = firstMispredicted_; frame < frame_; ++frame)
+		{
+			events |= StepFrame(frame);
+		}
+		firstMispredicted_ = -1;
+	}
+
+	events |= StepFrame(frame_);
+	++frame_;
+	return events;
+}
+
+/// Save the state before the frame, then step it with the local input and
+/// the remote input, predicted if it has not arrived: the last known
+/// direction, never a start.
+unsigned RollbackSession::StepFrame(int frame)
+{
+	int slot = Slot(frame);
+	states_[slot] = sim_.GetState();
+
+	unsigned char remoteInput;
+	if (frame <= lastRemoteFrame_)
+	{
+		remoteInput = inputs_[remotePlayer_][slot];
+	}
+	else
+	{
+		remoteInput = inputs_[remotePlayer_][Slot(lastRemoteFrame_ + ringSize_)] & NET_INPUT_DIRECTION;
+	}
+	usedRemoteInputs_[slot] = remoteInput;
+	unsigned char localInput = inputs_[localPlayer_][slot];
+
+	if (((localInput | remoteInput) & NET_INPUT_START) && !sim_.GetState().gameRunning_)
+	{
+		sim_.StartGame();
+	}
+
+	SimInput input;
+	input.batDirection_[localPlayer_] = UnpackDirection(localInput);
+	input.batDirection_[remotePlayer_] = UnpackDirection(remoteInput);
+	return sim_.Step(timeStep_, input);
+}
+
+/// Remote input must arrive in order; anything else is resent until it is
+/// acknowledged, so gaps fill themselves in.
+void RollbackSession::AddRemoteInput(int frame, unsigned char input)
+{
+	if (frame != lastRemoteFrame_ + 1 || frame >= frame_ + ringSize_ / 2)
+	{
+		return;
+	}
+
+	int slot = Slot(frame);
+	inputs_[remotePlayer_][slot] = input;
+	lastRemoteFrame_ = frame;
+
+	if (frame < frame_ && usedRemoteInputs_[slot] != input && (firstMispredicted_ < 0 || frame < firstMispredicted_))
+	{
+		firstMispredicted_ = frame;
+	}
+}
+
+unsigned RollbackSession::WritePacket(unsigned char* buffer, unsigned size) const
+{
+	if (size < ROLLBACK_PACKET_HEADER)
+	{
+		return 0;
+	}
+
+	int firstFrame = remoteAck_ + 1;
+	unsigned count = (unsigned)std::max(lastLocalFrame_ - remoteAck_, 0);
+	count = std::min(count, std::min(ROLLBACK_MAX_PACKET_INPUTS, size - ROLLBACK_PACKET_HEADER));
+
+	WriteInt(buffer, ROLLBACK_PACKET_MAGIC);
+	WriteInt(buffer + 4, seed_);
+	WriteInt(buffer + 8, (unsigned)lastRemoteFrame_);
+	WriteInt(buffer + 12, (unsigned)firstFrame);
+	buffer[16] = (unsigned char)count;
+	for (unsigned i = 0; i < count; ++i)
+	{
+		buffer[ROLLBACK_PACKET_HEADER + i] = inputs_[localPlayer_][Slot(firstFrame + (int)i)];
+	}
+
+	return ROLLBACK_PACKET_HEADER + count;
+}
+
+bool RollbackSession::ReadPacket(const unsigned char* buffer, unsigned size)
+{
+	if (size < ROLLBACK_PACKET_HEADER || ReadInt(buffer) != ROLLBACK_PACKET_MAGIC || ReadInt(buffer + 4) != seed_ ||
+		size < ROLLBACK_PACKET_HEADER + buffer[16])
+	{
+		++stats_.rejectedPackets_;
+		return false;
+	}
+
+	// Acknowledgements only ever move forward, and never past what has been
+	// sent.
+	int ack = (int)ReadInt(buffer + 8);
+	if (ack > remoteAck_ && ack <= lastLocalFrame_)
+	{
+		remoteAck_ = ack;
+	}
+
+	int firstFrame = (int)ReadInt(buffer + 12);
+	unsigned count = buffer[16];
+	for (unsigned i = 0; i < count; ++i)
+	{
+		AddRemoteInput(firstFrame + (int)i, buffer[ROLLBACK_PACKET_HEADER + i]);
+	}
+
+	return true;
+}
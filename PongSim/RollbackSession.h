@@ -0,0 +1,94 @@
+#pragma once
+
+#ifndef PONG_ROLLBACK_SESSION_H
+#define PONG_ROLLBACK_SESSION_H
+
+#include <vector>
+
+#include "PongSim.h"
+
+struct RollbackStats
+{
+	RollbackStats();
+
+	unsigned rollbacks_;
+	unsigned resimulatedFrames_;
+	unsigned maxRollbackFrames_;
+	// Packets ignored for being malformed or from a different session.
+	unsigned rejectedPackets_;
+};
+
+/// Peer to peer rollback for a match between a local and a remote player.
+/// Local input is delayed by a few frames to hide some of the latency; the
+/// rest is hidden by predicting the remote player's input, and when their
+/// real input turns out different, restoring the state saved before that
+/// frame and simulating forward again. SimState is plain data, so saving and
+/// restoring a frame is a copy into a buffer allocated up front.
+///
+/// The session steps the simulation it is given, which starts a game on any
+/// frame where either player pressed start and none is running.
+class RollbackSession
+{
+public:
+
+	/// Both peers must use the same parameters, seed and time step.
+	RollbackSession(PongSim& sim, unsigned seed, SimPlayer localPlayer, unsigned inputDelay, unsigned maxRollback, float timeStep);
+
+	/// The frame AdvanceFrame will step next.
+	int GetFrame() const { return frame_; }
+	/// False while the remote player is further behind than a rollback could
+	/// make up; the caller should wait rather than step.
+	bool CanAdvance() const;
+	/// Schedule the local player's input inputDelay frames ahead. Call once
+	/// before each AdvanceFrame.
+	void AddLocalInput(signed char batDirection, bool start);
+	/// Roll back and simulate forward again if remote input has arrived that
+	/// differs from what was predicted, then step the current frame. Returns
+	/// the SimEvent flags of every frame stepped.
+	unsigned AdvanceFrame();
+
+	/// Build a packet of every local input the remote player has not yet
+	/// acknowledged, and the acknowledgement of theirs. Returns its size.
+	unsigned WritePacket(unsigned char* buffer, unsigned size) const;
+	/// Take in a packet from the remote player. Returns false if it was
+	/// rejected.
+	bool ReadPacket(const unsigned char* buffer, unsigned size);
+
+	/// The last frame the remote player's input is known for.
+	int GetLastRemoteFrame() const { return lastRemoteFrame_; }
+	const RollbackStats& GetStats() const { return stats_; }
+
+	/// Largest packet WritePacket can produce.
+	static const unsigned MAX_PACKET_SIZE = 272;
+
+private:
+
+	PongSim& sim_;
+	unsigned seed_;
+	SimPlayer localPlayer_;
+	SimPlayer remotePlayer_;
+	int inputDelay_;
+	int maxRollback_;
+	float timeStep_;
+	// Frames of history kept; enough for the furthest the peers can drift
+	// apart, both ways.
+	int ringSize_;
+	// Indexed by frame modulo ringSize_.
+	std::vector<SimState> states_;
+	std::vector<unsigned char> inputs_[NUM_PLAYERS];
+	std::vector<unsigned char> usedRemoteInputs_;
+	int frame_;
+	int lastLocalFrame_;
+	int lastRemoteFrame_;
+	// The last of our frames the remote player has acknowledged.
+	int remoteAck_;
+	// The earliest stepped frame whose remote input was mispredicted, or -1.
+	int firstMispredicted_;
+	RollbackStats stats_;
+
+	void AddRemoteInput(int frame, unsigned char input);
+	unsigned StepFrame(int frame);
+	int Slot(int frame) const { return frame % ringSize_; }
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include <cstring>
+
+#include "ServerProtocol.h"
+
+// Identify each kind of packet, so that stray datagrams are ignored.
+const unsigned SERVER_INPUT_MAGIC = 0x50534931;
+const unsigned SERVER_UPDATE_MAGIC = 0x50535531;
+
+const unsigned char UPDATE_BALL_ACTIVE = 1;
+const unsigned char UPDATE_GAME_RUNNING = 2;
+
+static unsigned char* WriteInt(unsigned char* buffer, unsigned value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		buffer[i] = (unsigned char)(value >> (i * 8));
+	}
+	return buffer + 4;
+}
+
+static unsigned char* WriteFloat(unsigned char* buffer, float value)
+{
+	unsigned bits;
+	memcpy(&bits, &value, sizeof bits);
+	return WriteInt(buffer, bits);
+}
+
+static const unsigned char* ReadInt(const unsigned char* buffer, unsigned& value)
+{
+	value = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		value |= (unsigned)buffer[i] << (i * 8);
+	}
+	return buffer + 4;
+}
+
+static const unsigned char* ReadFloat(const unsigned char* buffer, float& value)
+{
+	unsigned bits;
+	buffer = ReadInt(buffer, bits);
+	memcpy(&value, &bits, sizeof value);
+	return buffer;
+}
+
+unsigned WriteServerInput(unsigned char* buffer, const ServerInput& input)
+{
+	unsigned char* end = WriteInt(buffer, SERVER_INPUT_MAGIC);
+	end = WriteInt(end, input.sequence_);
+	*end++ = (unsigned char)input.batDirection_;
+	*end++ = input.start_ ? 1 : 0;
+	return (unsigned)(end - buffer);
+}
+
+bool ReadServerInput(const unsigned char* buffer, unsigned size, ServerInput& input)
+{
+	unsigned magic = 0;
+	if (size == SERVER_INPUT_PACKET_SIZE)
+	{
+		buffer = ReadInt(buffer, magic);
+	}
+	if (magic != SERVER_INPUT_MAGIC)
+	{
+		return false;
+	}
+
+	buffer = ReadInt(buffer, input.sequence_);
+	signed char direction = (signed char)*buffer++;
+	input.batDirection_ = direction > 0 ? 1 : (direction < 0 ? -1 : 0);
+	input.start_ = *buffer != 0;
+	return true;
+}
+
+unsigned WriteServerUpdate(unsigned char* buffer, const ServerUpdate& update)
+{
+	const SimState& state = update.state_;
+	unsigned char* end = WriteInt(buffer, SERVER_UPDATE_MAGIC);
+	*end++ = (unsigned char)update.match_;
+	*end++ = (unsigned char)(update.match_ >> 8);
+	*end++ = update.player_;
+	end = WriteInt(end, update.tick_);
+	end = WriteFloat(end, state.ballX_);
+	end = WriteFloat(end, state.ballY_);
+	end = WriteFloat(end, state.ballVelocityX_);
+	end = WriteFloat(end, state.ballVelocityY_);
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		end = WriteFloat(end, state.batY_[i]);
+		end = WriteFloat(end, state.batVelocity_[i]);
+	}
+	end = WriteFloat(end, state.matchTime_);
+	end = WriteInt(end, state.randomSeed_);
+	end = WriteInt(end, state.rallyLength_);
+	*end++ = (state.ballActive_ ? UPDATE_BALL_ACTIVE : 0) | (state.gameRunning_ ? UPDATE_GAME_RUNNING : 0);
+	*end++ = (unsigned char)state.winner_;
+	return (unsigned)(end - buffer);
+}
+
+bool ReadServerUpdate(const unsigned char* buffer, unsigned size, ServerUpdate& update)
+{
+	unsigned magic = 0;
+	if (size == SERVER_UPDATE_PACKET_SIZE)
+	{
+		buffer = ReadInt(buffer, magic);
+	}
+	if (magic != SERVER_UPDATE_MAGIC || buffer[2] >= NUM_PLAYERS)
+	{
+		return false;
+	}
+
+	SimState& state = update.state_;
+	update.match_ = (unsigned short)(buffer[0] | buffer[1] << 8);
+	update.player_ = buffer[2];
+	buffer = ReadInt(buffer + 3, update.tick_);
+	buffer = ReadFloat(buffer, state.ballX_);
+	buffer = ReadFloat(buffer, state.ballY_);
+	buffer = ReadFloat(buffer, state.ballVelocityX_);
+	buffer = ReadFloat(buffer, state.ballVelocityY_);
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		buffer = ReadFloat(buffer, state.batY_[i]);
+		buffer = ReadFloat(buffer, state.batVelocity_[i]);
+	}
+	buffer = ReadFloat(buffer, state.matchTime_);
+	buffer = ReadInt(buffer, state.randomSeed_);
+	buffer = ReadInt(buffer, state.rallyLength_);
+	state.ballActive_ = (*buffer & UPDATE_BALL_ACTIVE) != 0;
+	state.gameRunning_ = (*buffer & UPDATE_GAME_RUNNING) != 0;
+	state.winner_ = (signed char)buffer[1];
+	return true;
+}
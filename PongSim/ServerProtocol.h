@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef PONG_SERVER_PROTOCOL_H
+#define PONG_SERVER_PROTOCOL_H
+
+#include "PongSim.h"
+
+// Packets between PongServer and the clients playing on it. Unlike rollback
+// play, only the server runs the simulation: clients send their input every
+// tick, and draw the states they are sent back. Little endian throughout.
+
+const unsigned short DEFAULT_SERVER_PORT = 27910;
+const unsigned SERVER_INPUT_PACKET_SIZE = 10;
+const unsigned SERVER_UPDATE_PACKET_SIZE = 57;
+
+/// A client's input to the match it plays. The first input from an address
+/// seats it in a match.
+struct ServerInput
+{
+	// Increases with every packet, so that late ones are ignored.
+	unsigned sequence_;
+	signed char batDirection_;
+	bool start_;
+};
+
+/// The state of a match after a server tick, as sent to one of its players.
+struct ServerUpdate
+{
+	unsigned short match_;
+	// The SimPlayer the receiving client plays.
+	unsigned char player_;
+	unsigned tick_;
+	SimState state_;
+};
+
+/// Each write needs a buffer of at least the packet's size, and returns the
+/// size written. Reads return false for anything that is not such a packet.
+unsigned WriteServerInput(unsigned char* buffer, const ServerInput& input);
+bool ReadServerInput(const unsigned char* buffer, unsigned size, ServerInput& input);
+unsigned WriteServerUpdate(unsigned char* buffer, const ServerUpdate& update);
+bool ReadServerUpdate(const unsigned char* buffer, unsigned size, ServerUpdate& update);
+
+#endif
@@ -0,0 +1,146 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "SimParamsFile.h"
+
+struct SimParamField
+{
+	const char* name_;
+	float SimParams::* member_;
+};
+
+// Every float field, in the order SimParams declares them. The flags are
+// handled on their own.
+static const SimParamField SIM_PARAM_FIELDS[] =
+{
+	{ "batSpeed", &SimParams::batSpeed_ },
+	{ "batOffset", &SimParams::batOffset_ },
+	{ "batHalfWidth", &SimParams::batHalfWidth_ },
+	{ "batHalfHeight", &SimParams::batHalfHeight_ },
+	{ "batWallGap", &SimParams::batWallGap_ },
+	{ "ballRadius", &SimParams::ballRadius_ },
+	{ "initialBallSpeed", &SimParams::initialBallSpeed_ },
+	{ "batSpeedUp", &SimParams::batSpeedUp_ },
+	{ "wallOffset", &SimParams::wallOffset_ },
+	{ "wallHalfWidth", &SimParams::wallHalfWidth_ },
+	{ "wallHalfHeight", &SimParams::wallHalfHeight_ },
+	{ "endZoneOffset", &SimParams::endZoneOffset_ },
+	{ "endZoneHalfWidth", &SimParams::endZoneHalfWidth_ },
+	{ "endZoneHalfHeight", &SimParams::endZoneHalfHeight_ }
+};
+
+const unsigned NUM_SIM_PARAM_FIELDS = sizeof SIM_PARAM_FIELDS / sizeof SIM_PARAM_FIELDS[0];
+
+const char* CONTINUOUS_COLLISION_FIELD = "continuousCollision";
+const char* FIXED_POINT_FIELD = "fixedPoint";
+
+static bool SetSimParam(SimParams& params, const char* name, const char* value)
+{
+	char* end;
+	double number = strtod(value, &end);
+	if (end == value)
+	{
+		return false;
+	}
+
+	if (!strcmp(name, CONTINUOUS_COLLISION_FIELD))
+	{
+		params.continuousCollision_ = number != 0.0;
+		return true;
+	}
+	if (!strcmp(name, FIXED_POINT_FIELD))
+	{
+		params.fixedPoint_ = number != 0.0;
+		return true;
+	}
+	for (unsigned i = 0; i < NUM_SIM_PARAM_FIELDS; ++i)
+	{
+		if (!strcmp(name, SIM_PARAM_FIELDS[i].name_))
+		{
+			params.*SIM_PARAM_FIELDS[i].member_ = (float)number;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool ParseSimParams(const std::string& text, SimParams& params)
+{
+	SimParams parsed = params;
+	size_t start = 0;
+	while (start < text.size())
+	{
+		size_t end = text.find('\n', start);
+		if (end == std::string::npos)
+		{
+			end = text.size();
+		}
+		std::string line = text.substr(start, end - start);
+		start = end + 1;
+
+		char name[64];
+		char value[64];
+		int fields = sscanf(line.c_str(), " %63s %63s", name, value);
+		if (fields <= 0 || name[0] == '#')
+		{
+			continue;
+		}
+		if (fields != 2 || !SetSimParam(parsed, name, value))
+		{
+			return false;
+		}
+	}
+
+	params = parsed;
+	return true;
+}
+
+bool LoadSimParams(const std::string& path, SimParams& params)
+{
+	FILE* file = fopen(path.c_str(), "rb");
+	if (!file)
+	{
+		return false;
+	}
+
+	std::string text;
+	char buffer[1024];
+	size_t size;
+	while ((size = fread(buffer, 1, sizeof buffer, file)) > 0)
+	{
+		text.append(buffer, size);
+	}
+	bool read = !ferror(file);
+	fclose(file);
+
+	return read && ParseSimParams(text, params);
+}
+
+bool SaveSimParams(const std::string& path, const SimParams& params, const std::string& comment)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (!file)
+	{
+		return false;
+	}
+
+	const char* start = comment.c_str();
+	while (*start)
+	{
+		const char* end = strchr(start, '\n');
+		int length = end ? (int)(end - start) : (int)strlen(start);
+		fprintf(file, "# %.*s\n", length, start);
+		start += length + (end ? 1 : 0);
+	}
+
+	// Nine significant digits read back as the same float.
+	for (unsigned i = 0; i < NUM_SIM_PARAM_FIELDS; ++i)
+	{
+		fprintf(file, "%s %.9g\n", SIM_PARAM_FIELDS[i].name_, params.*SIM_PARAM_FIELDS[i].member_);
+	}
+	fprintf(file, "%s %d\n", CONTINUOUS_COLLISION_FIELD, params.continuousCollision_ ? 1 : 0);
+	fprintf(file, "%s %d\n", FIXED_POINT_FIELD, params.fixedPoint_ ? 1 : 0);
+
+	return fclose(file) == 0;
+}
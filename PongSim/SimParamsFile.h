@@ -0,0 +1,23 @@
+#pragma once
+
+#ifndef PONG_SIM_PARAMS_FILE_H
+#define PONG_SIM_PARAMS_FILE_H
+
+#include <string>
+
+#include "PongSim.h"
+
+/// A parameter set is a text file of SimParams fields, one "name value" pair
+/// to a line, named as the members are without the trailing underscore, e.g.
+/// "batSpeed 4.5". Lines starting with # are comments. Fields a file leaves
+/// out keep the value they had, so a set can change just a few of them.
+
+/// Returns false, leaving params untouched, if the text has a line that is
+/// not a known field and a number.
+bool ParseSimParams(const std::string& text, SimParams& params);
+/// As ParseSimParams, and also false if the file cannot be read.
+bool LoadSimParams(const std::string& path, SimParams& params);
+/// Write every field, after the comment, which may span several lines.
+bool SaveSimParams(const std::string& path, const SimParams& params, const std::string& comment = std::string());
+
+#endif
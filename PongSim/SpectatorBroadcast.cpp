@@ -0,0 +1,113 @@
+#include <algorithm>
+
+#include "SpectatorBroadcast.h"
+
+// Spectators renew their subscription every second; one not heard from for
+// this long has gone.
+const unsigned SUBSCRIPTION_TIMEOUT = 5000;
+
+// Thousands of subscribers are sent each packet in a burst.
+const unsigned BROADCAST_BUFFER_SIZE = 4 << 20;
+
+BroadcastStats::BroadcastStats() :
+	packets_(0),
+	keyframes_(0),
+	sends_(0),
+	bytes_(0),
+	maxSubscribers_(0),
+	refused_(0)
+{
+}
+
+SpectatorBroadcast::SpectatorBroadcast() :
+	maxSubscribers_(0)
+{
+}
+
+bool SpectatorBroadcast::Open(unsigned short port, unsigned maxSubscribers)
+{
+	if (!socket_.Open(port, BROADCAST_BUFFER_SIZE))
+	{
+		return false;
+	}
+
+	maxSubscribers_ = maxSubscribers;
+	endpoints_.reserve(maxSubscribers_);
+	lastHeard_.reserve(maxSubscribers_);
+	subscriberIndices_.Reserve(maxSubscribers_);
+	return true;
+}
+
+void SpectatorBroadcast::Close()
+{
+	socket_.Close();
+	endpoints_.clear();
+	lastHeard_.clear();
+	subscriberIndices_.Clear();
+}
+
+void SpectatorBroadcast::Update(unsigned now)
+{
+	unsigned char packet[SPECTATOR_SUBSCRIBE_PACKET_SIZE + 1];
+	UdpEndpoint endpoint;
+	unsigned size;
+	while ((size = socket_.Receive(packet, sizeof packet, endpoint)) > 0)
+	{
+		if (!ReadSpectatorSubscribe(packet, size))
+		{
+			continue;
+		}
+
+		unsigned known;
+		if (subscriberIndices_.Find(endpoint, known))
+		{
+			lastHeard_[known] = now;
+		}
+		else if (endpoints_.size() < maxSubscribers_)
+		{
+			subscriberIndices_.Insert(endpoint, (unsigned)endpoints_.size());
+			endpoints_.push_back(endpoint);
+			lastHeard_.push_back(now);
+		}
+		else
+		{
+			++stats_.refused_;
+		}
+	}
+
+	// Fill each gap with the last subscriber.
+	for (unsigned i = 0; i < endpoints_.size();)
+	{
+		if (now - lastHeard_[i] < SUBSCRIPTION_TIMEOUT)
+		{
+			++i;
+			continue;
+		}
+		subscriberIndices_.Erase(endpoints_[i]);
+		endpoints_[i] = endpoints_.back();
+		lastHeard_[i] = lastHeard_.back();
+		endpoints_.pop_back();
+		lastHeard_.pop_back();
+		if (i < endpoints_.size())
+		{
+			subscriberIndices_.Insert(endpoints_[i], i);
+		}
+	}
+
+	stats_.maxSubscribers_ = std::max(stats_.maxSubscribers_, (unsigned)endpoints_.size());
+}
+
+void SpectatorBroadcast::Publish(const SpectatorState& state, unsigned now)
+{
+	unsigned char packet[SPECTATOR_MAX_PACKET_SIZE];
+	unsigned size = writer_.Write(state, now, packet);
+	++stats_.packets_;
+	stats_.keyframes_ += writer_.WroteKeyframe() ? 1 : 0;
+
+	if (!endpoints_.empty())
+	{
+		socket_.Send(packet, size, &endpoints_[0], (unsigned)endpoints_.size());
+	}
+	stats_.sends_ += endpoints_.size();
+	stats_.bytes_ += (unsigned long long)size * endpoints_.size();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#ifndef PONG_SPECTATOR_BROADCAST_H
+#define PONG_SPECTATOR_BROADCAST_H
+
+#include <vector>
+
+#include "EndpointMap.h"
+#include "StateStream.h"
+
+struct BroadcastStats
+{
+	BroadcastStats();
+
+	unsigned packets_;
+	unsigned keyframes_;
+	unsigned long long sends_;
+	unsigned long long bytes_;
+	unsigned maxSubscribers_;
+	// Subscriptions refused for want of room.
+	unsigned refused_;
+};
+
+/// Streams a match to any number of spectators over UDP. A spectator
+/// subscribes by sending a subscribe packet to the port, and keeps doing so
+/// to stay subscribed. Each published state is encoded once, and the same
+/// packet is sent to every subscriber, so the cost per spectator is a send.
+/// Subscribers' endpoints are held in one array allocated up front, which is
+/// handed to the socket whole, with a map from each endpoint to its place for
+/// renewals. Times are in milliseconds.
+class SpectatorBroadcast
+{
+public:
+
+	SpectatorBroadcast();
+
+	bool Open(unsigned short port, unsigned maxSubscribers);
+	void Close();
+	bool IsOpen() const { return socket_.IsOpen(); }
+	/// Take in subscriptions, and drop subscribers that have gone quiet.
+	void Update(unsigned now);
+	void Publish(const SpectatorState& state, unsigned now);
+
+	unsigned GetNumSubscribers() const { return (unsigned)endpoints_.size(); }
+	const BroadcastStats& GetStats() const { return stats_; }
+
+private:
+
+	UdpSocket socket_;
+	StateStreamWriter writer_;
+	unsigned maxSubscribers_;
+	std::vector<UdpEndpoint> endpoints_;
+	std::vector<unsigned> lastHeard_;
+	// Index of each subscriber in endpoints_.
+	EndpointMap subscriberIndices_;
+	BroadcastStats stats_;
+};
+
+#endif
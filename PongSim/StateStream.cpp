@@ -0,0 +1,313 @@
+#include <algorithm>
+#include <cmath>
+
+#include "StateStream.h"
+
+const unsigned STREAM_PACKET_MAGIC = 0x50535431;
+const unsigned SUBSCRIBE_PACKET_MAGIC = 0x50534231;
+
+// Magic, sequence, send time and the packets since the keyframe.
+const unsigned STREAM_HEADER_SIZE = 13;
+
+const float POSITION_SCALE = 1024.0f;
+const float VELOCITY_SCALE = 256.0f;
+
+const unsigned STREAM_BALL_ACTIVE = 1;
+const unsigned STREAM_GAME_RUNNING = 2;
+
+// A keyframe's age has to fit its byte.
+const unsigned MAX_KEYFRAME_INTERVAL = 255;
+
+static int Quantize(float value, float scale)
+{
+	return (int)std::floor(value * scale + 0.5f);
+}
+
+static void Quantize(const SpectatorState& state, int* fields)
+{
+	fields[STREAM_BALL_X] = Quantize(state.ballX_, POSITION_SCALE);
+	fields[STREAM_BALL_Y] = Quantize(state.ballY_, POSITION_SCALE);
+	fields[STREAM_BALL_VELOCITY_X] = Quantize(state.ballVelocityX_, VELOCITY_SCALE);
+	fields[STREAM_BALL_VELOCITY_Y] = Quantize(state.ballVelocityY_, VELOCITY_SCALE);
+	fields[STREAM_BAT_ONE_Y] = Quantize(state.batY_[PLAYER_ONE], POSITION_SCALE);
+	fields[STREAM_BAT_TWO_Y] = Quantize(state.batY_[PLAYER_TWO], POSITION_SCALE);
+	fields[STREAM_RALLY_LENGTH] = (int)state.rallyLength_;
+	fields[STREAM_FLAGS] = (state.ballActive_ ? STREAM_BALL_ACTIVE : 0) | (state.gameRunning_ ? STREAM_GAME_RUNNING : 0);
+	fields[STREAM_WINNER] = state.winner_;
+	fields[STREAM_EVENTS] = (int)state.events_;
+}
+
+static void Dequantize(const int* fields, SpectatorState& state)
+{
+	state.ballX_ = fields[STREAM_BALL_X] / POSITION_SCALE;
+	state.ballY_ = fields[STREAM_BALL_Y] / POSITION_SCALE;
+	state.ballVelocityX_ = fields[STREAM_BALL_VELOCITY_X] / VELOCITY_SCALE;
+	state.ballVelocityY_ = fields[STREAM_BALL_VELOCITY_Y] / VELOCITY_SCALE;
+	state.batY_[PLAYER_ONE] = fields[STREAM_BAT_ONE_Y] / POSITION_SCALE;
+	state.batY_[PLAYER_TWO] = fields[STREAM_BAT_TWO_Y] / POSITION_SCALE;
+	state.rallyLength_ = (unsigned)fields[STREAM_RALLY_LENGTH];
+	state.ballActive_ = (fields[STREAM_FLAGS] & STREAM_BALL_ACTIVE) != 0;
+	state.gameRunning_ = (fields[STREAM_FLAGS] & STREAM_GAME_RUNNING) != 0;
+	state.winner_ = (signed char)fields[STREAM_WINNER];
+	state.events_ = (unsigned)fields[STREAM_EVENTS];
+}
+
+static unsigned char* WriteInt(unsigned char* buffer, unsigned value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		buffer[i] = (unsigned char)(value >> (i * 8));
+	}
+	return buffer + 4;
+}
+
+static const unsigned char* ReadInt(const unsigned char* buffer, unsigned& value)
+{
+	value = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		value |= (unsigned)buffer[i] << (i * 8);
+	}
+	return buffer + 4;
+}
+
+/// Seven bits at a time, low first, so that small differences of either
+/// sign take one byte.
+static unsigned char* WriteVarInt(unsigned char* buffer, int value)
+{
+	unsigned zigzag = ((unsigned)value << 1) ^ (unsigned)(value >> 31);
+	while (zigzag >= 0x80)
+	{
+		*buffer++ = (unsigned char)(zigzag | 0x80);
+		zigzag >>= 7;
+	}
+	*buffer++ = (unsigned char)zigzag;
+	return buffer;
+}
+
+/// Returns 0 if the value runs past the end.
+static const unsigned char* ReadVarInt(const unsigned char* buffer, const unsigned char* end, int& value)
+{
+	unsigned zigzag = 0;
+	for (unsigned shift = 0; shift < 35; shift += 7)
+	{
+		if (buffer == end)
+		{
+			return 0;
+		}
+		unsigned char byte = *buffer++;
+		zigzag |= (unsigned)(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+		{
+			value = (int)(zigzag >> 1) ^ -(int)(zigzag & 1);
+			return buffer;
+		}
+	}
+	return 0;
+}
+
+SpectatorState::SpectatorState() :
+	ballX_(0.0f),
+	ballY_(0.0f),
+	ballVelocityX_(0.0f),
+	ballVelocityY_(0.0f),
+	rallyLength_(0),
+	ballActive_(false),
+	gameRunning_(false),
+	winner_(-1),
+	events_(SIM_EVENT_NONE)
+{
+	batY_[PLAYER_ONE] = 0.0f;
+	batY_[PLAYER_TWO] = 0.0f;
+}
+
+void SpectatorState::FromSimState(const SimState& state, unsigned events)
+{
+	ballX_ = state.ballX_;
+	ballY_ = state.ballY_;
+	ballVelocityX_ = state.ballVelocityX_;
+	ballVelocityY_ = state.ballVelocityY_;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		batY_[i] = state.batY_[i];
+	}
+	rallyLength_ = state.rallyLength_;
+	ballActive_ = state.ballActive_;
+	gameRunning_ = state.gameRunning_;
+	winner_ = state.winner_;
+	events_ = events;
+}
+
+void SpectatorState::ToSimState(SimState& state) const
+{
+	state.ballX_ = ballX_;
+	state.ballY_ = ballY_;
+	state.ballVelocityX_ = ballVelocityX_;
+	state.ballVelocityY_ = ballVelocityY_;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		state.batY_[i] = batY_[i];
+	}
+	state.rallyLength_ = rallyLength_;
+	state.ballActive_ = ballActive_;
+	state.gameRunning_ = gameRunning_;
+	state.winner_ = winner_;
+}
+
+StateStreamWriter::StateStreamWriter(unsigned keyframeInterval) :
+	keyframeInterval_(std::min(std::max(keyframeInterval, 1U), MAX_KEYFRAME_INTERVAL)),
+	sequence_(0),
+	keyframeSequence_(0)
+{
+	std::fill(keyframe_, keyframe_ + NUM_STREAM_FIELDS, 0);
+}
+
+unsigned StateStreamWriter::Write(const SpectatorState& state, unsigned sendTime, unsigned char* buffer)
+{
+	int fields[NUM_STREAM_FIELDS];
+	Quantize(state, fields);
+
+	unsigned sequence = ++sequence_;
+	bool keyframe = sequence == 1 || sequence - keyframeSequence_ >= keyframeInterval_;
+	if (keyframe)
+	{
+		keyframeSequence_ = sequence;
+		std::copy(fields, fields + NUM_STREAM_FIELDS, keyframe_);
+	}
+
+	unsigned char* end = WriteInt(buffer, STREAM_PACKET_MAGIC);
+	end = WriteInt(end, sequence);
+	end = WriteInt(end, sendTime);
+	*end++ = (unsigned char)(sequence - keyframeSequence_);
+
+	if (keyframe)
+	{
+		for (int i = 0; i < NUM_STREAM_FIELDS; ++i)
+		{
+			end = WriteVarInt(end, fields[i]);
+		}
+	}
+	else
+	{
+		unsigned char* mask = end;
+		end += 2;
+		unsigned changed = 0;
+		for (int i = 0; i < NUM_STREAM_FIELDS; ++i)
+		{
+			if (fields[i] != keyframe_[i])
+			{
+				changed |= 1 << i;
+				end = WriteVarInt(end, (int)((unsigned)fields[i] - (unsigned)keyframe_[i]));
+			}
+		}
+		mask[0] = (unsigned char)changed;
+		mask[1] = (unsigned char)(changed >> 8);
+	}
+
+	return (unsigned)(end - buffer);
+}
+
+StateStreamReader::StateStreamReader() :
+	hasKeyframe_(false),
+	keyframeSequence_(0),
+	missingKeyframes_(0)
+{
+	std::fill(keyframe_, keyframe_ + NUM_STREAM_FIELDS, 0);
+}
+
+bool StateStreamReader::Read(const unsigned char* buffer, unsigned size, SpectatorState& state, unsigned& sequence,
+	unsigned& sendTime)
+{
+	if (size < STREAM_HEADER_SIZE)
+	{
+		return false;
+	}
+
+	const unsigned char* end = buffer + size;
+	unsigned magic;
+	buffer = ReadInt(buffer, magic);
+	if (magic != STREAM_PACKET_MAGIC)
+	{
+		return false;
+	}
+	buffer = ReadInt(buffer, sequence);
+	buffer = ReadInt(buffer, sendTime);
+	unsigned keyframeAge = *buffer++;
+
+	int fields[NUM_STREAM_FIELDS];
+	if (!keyframeAge)
+	{
+		for (int i = 0; i < NUM_STREAM_FIELDS; ++i)
+		{
+			if (!(buffer = ReadVarInt(buffer, end, fields[i])))
+			{
+				return false;
+			}
+		}
+		// A late keyframe must not replace a newer one.
+		if (!hasKeyframe_ || (int)(sequence - keyframeSequence_) > 0)
+		{
+			hasKeyframe_ = true;
+			keyframeSequence_ = sequence;
+			std::copy(fields, fields + NUM_STREAM_FIELDS, keyframe_);
+		}
+	}
+	else
+	{
+		if (!hasKeyframe_ || sequence - keyframeAge != keyframeSequence_)
+		{
+			++missingKeyframes_;
+			return false;
+		}
+		if (end - buffer < 2)
+		{
+			return false;
+		}
+		unsigned changed = buffer[0] | buffer[1] << 8;
+		buffer += 2;
+		for (int i = 0; i < NUM_STREAM_FIELDS; ++i)
+		{
+			int difference = 0;
+			if ((changed & (1 << i)) && !(buffer = ReadVarInt(buffer, end, difference)))
+			{
+				return false;
+			}
+			fields[i] = (int)((unsigned)keyframe_[i] + (unsigned)difference);
+		}
+	}
+
+	Dequantize(fields, state);
+	return true;
+}
+
+unsigned WriteSpectatorSubscribe(unsigned char* buffer)
+{
+	WriteInt(buffer, SUBSCRIBE_PACKET_MAGIC);
+	return SPECTATOR_SUBSCRIBE_PACKET_SIZE;
+}
+
+bool ReadSpectatorSubscribe(const unsigned char* buffer, unsigned size)
+{
+	if (size != SPECTATOR_SUBSCRIBE_PACKET_SIZE)
+	{
+		return false;
+	}
+	unsigned magic;
+	ReadInt(buffer, magic);
+	return magic == SUBSCRIBE_PACKET_MAGIC;
+}
+
+void InterpolateSpectatorState(const SpectatorState& from, const SpectatorState& to, float t, SpectatorState& result)
+{
+	result = to;
+	for (int i = 0; i < NUM_PLAYERS; ++i)
+	{
+		result.batY_[i] = from.batY_[i] + (to.batY_[i] - from.batY_[i]) * t;
+	}
+	// A serve or a new game jumps the ball, which must not be drawn sliding.
+	if (from.ballActive_ && to.ballActive_ && from.rallyLength_ <= to.rallyLength_ && !(to.events_ & SIM_EVENT_GAME_END))
+	{
+		result.ballX_ = from.ballX_ + (to.ballX_ - from.ballX_) * t;
+		result.ballY_ = from.ballY_ + (to.ballY_ - from.ballY_) * t;
+	}
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#ifndef PONG_STATE_STREAM_H
+#define PONG_STATE_STREAM_H
+
+#include "PongSim.h"
+
+const unsigned short DEFAULT_SPECTATOR_PORT = 27920;
+const unsigned SPECTATOR_SUBSCRIBE_PACKET_SIZE = 4;
+// The header, the field mask and every field at its longest.
+const unsigned SPECTATOR_MAX_PACKET_SIZE = 72;
+// A whole state is sent this often, in packets.
+const unsigned DEFAULT_KEYFRAME_INTERVAL = 30;
+
+/// What a spectator is shown of a match at one moment, as quantized for the
+/// stream: positions to 1/1024 of a world unit and velocities to 1/256.
+struct SpectatorState
+{
+	SpectatorState();
+	void FromSimState(const SimState& state, unsigned events);
+	/// Fields that are not streamed are left as they were.
+	void ToSimState(SimState& state) const;
+
+	float ballX_;
+	float ballY_;
+	float ballVelocityX_;
+	float ballVelocityY_;
+	float batY_[NUM_PLAYERS];
+	unsigned rallyLength_;
+	bool ballActive_;
+	bool gameRunning_;
+	signed char winner_;
+	// SimEvent flags of everything since the previous packet, such as the end
+	// of a game.
+	unsigned events_;
+};
+
+/// Fields of the stream, in the order of the mask bits.
+enum StreamField
+{
+	STREAM_BALL_X = 0,
+	STREAM_BALL_Y,
+	STREAM_BALL_VELOCITY_X,
+	STREAM_BALL_VELOCITY_Y,
+	STREAM_BAT_ONE_Y,
+	STREAM_BAT_TWO_Y,
+	STREAM_RALLY_LENGTH,
+	STREAM_FLAGS,
+	STREAM_WINNER,
+	STREAM_EVENTS,
+	NUM_STREAM_FIELDS
+};
+
+/// Encodes a state per packet, the same packet for every receiver. A
+/// keyframe carries every field; the packets in between carry only the
+/// fields that differ from the last keyframe, as zigzag variable length
+/// differences. As each packet depends only on its keyframe, losing one
+/// loses just that moment, and a new receiver can start at any keyframe.
+class StateStreamWriter
+{
+public:
+
+	explicit StateStreamWriter(unsigned keyframeInterval = DEFAULT_KEYFRAME_INTERVAL);
+	/// Write the next packet into a buffer of SPECTATOR_MAX_PACKET_SIZE, with
+	/// the sender's clock in milliseconds. Returns its size.
+	unsigned Write(const SpectatorState& state, unsigned sendTime, unsigned char* buffer);
+	unsigned GetSequence() const { return sequence_; }
+	/// Whether the last packet written was a keyframe.
+	bool WroteKeyframe() const { return sequence_ && keyframeSequence_ == sequence_; }
+
+private:
+
+	unsigned keyframeInterval_;
+	unsigned sequence_;
+	unsigned keyframeSequence_;
+	int keyframe_[NUM_STREAM_FIELDS];
+};
+
+class StateStreamReader
+{
+public:
+
+	StateStreamReader();
+	/// Decode a packet into the state, with its sequence number and send
+	/// time. Returns false if it is malformed, or relative to a keyframe that
+	/// has not been received.
+	bool Read(const unsigned char* buffer, unsigned size, SpectatorState& state, unsigned& sequence, unsigned& sendTime);
+	bool HasKeyframe() const { return hasKeyframe_; }
+	/// Packets dropped for want of their keyframe.
+	unsigned GetMissingKeyframes() const { return missingKeyframes_; }
+
+private:
+
+	bool hasKeyframe_;
+	unsigned keyframeSequence_;
+	int keyframe_[NUM_STREAM_FIELDS];
+	unsigned missingKeyframes_;
+};
+
+/// Asks a broadcaster for its stream, and has to be repeated to keep it.
+unsigned WriteSpectatorSubscribe(unsigned char* buffer);
+bool ReadSpectatorSubscribe(const unsigned char* buffer, unsigned size);
+
+/// Blend positions between two states; everything else is taken from the
+/// later one.
+void InterpolateSpectatorState(const SpectatorState& from, const SpectatorState& to, float t, SpectatorState& result);
+
+#endif
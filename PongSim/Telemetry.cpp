@@ -0,0 +1,248 @@
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#include "Telemetry.h"
+
+const unsigned TELEMETRY_MAGIC = 0x314c5450;
+const unsigned TELEMETRY_VERSION = 1;
+const unsigned TELEMETRY_HEADER_SIZE = 16;
+const unsigned TELEMETRY_RECORD_SIZE = 16;
+// Where the dropped count goes in the header, filled in on closing.
+const long TELEMETRY_DROPPED_OFFSET = 12;
+
+// Records the writer takes from the ring and writes out at once.
+const unsigned WRITE_BATCH = 256;
+// How long the writer sleeps when the ring is empty. The ring has to hold
+// this long's worth of records.
+const std::chrono::milliseconds WRITER_POLL_INTERVAL(5);
+
+static unsigned char* WriteInt(unsigned char* buffer, unsigned value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		buffer[i] = (unsigned char)(value >> (i * 8));
+	}
+	return buffer + 4;
+}
+
+static unsigned char* WriteFloat(unsigned char* buffer, float value)
+{
+	unsigned bits;
+	memcpy(&bits, &value, sizeof bits);
+	return WriteInt(buffer, bits);
+}
+
+static float GetSpeed(const SimState& state)
+{
+	return std::sqrt(state.ballVelocityX_ * state.ballVelocityX_ + state.ballVelocityY_ * state.ballVelocityY_);
+}
+
+TelemetryRing::TelemetryRing(unsigned capacity)
+{
+	unsigned size = 1;
+	while (size < capacity)
+	{
+		size <<= 1;
+	}
+	mask_ = size - 1;
+	records_.reset(new TelemetryRecord[size]);
+	head_.value_ = 0;
+	tail_.value_ = 0;
+}
+
+bool TelemetryRing::Push(const TelemetryRecord& record)
+{
+	unsigned head = head_.value_.load(std::memory_order_relaxed);
+	if (head - tail_.value_.load(std::memory_order_acquire) > mask_)
+	{
+		return false;
+	}
+	records_[head & mask_] = record;
+	head_.value_.store(head + 1, std::memory_order_release);
+	return true;
+}
+
+unsigned TelemetryRing::Pop(TelemetryRecord* records, unsigned maxCount)
+{
+	unsigned tail = tail_.value_.load(std::memory_order_relaxed);
+	unsigned count = head_.value_.load(std::memory_order_acquire) - tail;
+	if (count > maxCount)
+	{
+		count = maxCount;
+	}
+	for (unsigned i = 0; i < count; ++i)
+	{
+		records[i] = records_[(tail + i) & mask_];
+	}
+	tail_.value_.store(tail + count, std::memory_order_release);
+	return count;
+}
+
+TelemetryStats::TelemetryStats() :
+	recorded_(0),
+	dropped_(0),
+	written_(0),
+	bytes_(0)
+{
+}
+
+TelemetryWriter::TelemetryWriter() :
+	file_(0),
+	closing_(false)
+{
+}
+
+TelemetryWriter::~TelemetryWriter()
+{
+	Close();
+}
+
+bool TelemetryWriter::Open(const char* fileName, unsigned capacity)
+{
+	Close();
+	file_ = fopen(fileName, "wb");
+	if (!file_)
+	{
+		return false;
+	}
+
+	unsigned char header[TELEMETRY_HEADER_SIZE];
+	unsigned char* end = WriteInt(header, TELEMETRY_MAGIC);
+	end = WriteInt(end, TELEMETRY_VERSION);
+	end = WriteInt(end, TELEMETRY_RECORD_SIZE);
+	WriteInt(end, 0);
+	fwrite(header, 1, sizeof header, file_);
+
+	stats_ = TelemetryStats();
+	stats_.bytes_ = sizeof header;
+	ring_.reset(new TelemetryRing(capacity));
+	closing_ = false;
+	thread_ = std::thread(&TelemetryWriter::WriteRecords, this);
+	return true;
+}
+
+void TelemetryWriter::Close()
+{
+	if (!file_)
+	{
+		return;
+	}
+
+	closing_.store(true, std::memory_order_release);
+	thread_.join();
+
+	unsigned char dropped[4];
+	WriteInt(dropped, stats_.dropped_);
+	fseek(file_, TELEMETRY_DROPPED_OFFSET, SEEK_SET);
+	fwrite(dropped, 1, sizeof dropped, file_);
+	fclose(file_);
+	file_ = 0;
+	ring_.reset();
+}
+
+void TelemetryWriter::Record(const TelemetryRecord& record)
+{
+	if (!file_)
+	{
+		return;
+	}
+	++stats_.recorded_;
+	if (!ring_->Push(record))
+	{
+		++stats_.dropped_;
+	}
+}
+
+/// The writer thread: drain the ring in batches until closed, then once
+/// more for whatever was recorded last.
+void TelemetryWriter::WriteRecords()
+{
+	TelemetryRecord records[WRITE_BATCH];
+	unsigned char buffer[WRITE_BATCH * TELEMETRY_RECORD_SIZE];
+
+	for (;;)
+	{
+		bool closing = closing_.load(std::memory_order_acquire);
+		unsigned count = ring_->Pop(records, WRITE_BATCH);
+		if (!count)
+		{
+			if (closing)
+			{
+				break;
+			}
+			std::this_thread::sleep_for(WRITER_POLL_INTERVAL);
+			continue;
+		}
+
+		unsigned char* end = buffer;
+		for (unsigned i = 0; i < count; ++i)
+		{
+			const TelemetryRecord& record = records[i];
+			end = WriteInt(end, record.match_);
+			end = WriteInt(end, record.tick_);
+			end = WriteFloat(end, record.value_);
+			*end++ = (unsigned char)record.count_;
+			*end++ = (unsigned char)(record.count_ >> 8);
+			*end++ = record.type_;
+			*end++ = record.player_;
+		}
+		fwrite(buffer, 1, end - buffer, file_);
+		stats_.written_ += count;
+		stats_.bytes_ += end - buffer;
+	}
+
+	fflush(file_);
+}
+
+MatchTelemetry::MatchTelemetry(TelemetryWriter& writer) :
+	writer_(writer),
+	match_(0),
+	tick_(0)
+{
+}
+
+void MatchTelemetry::Serve(const SimState& state)
+{
+	++match_;
+	// The diagonals in the order PongSim::GetServeVelocity numbers them.
+	unsigned direction = state.ballVelocityX_ < 0.0f ? (state.ballVelocityY_ > 0.0f ? 0 : 1) :
+		(state.ballVelocityY_ < 0.0f ? 2 : 3);
+	Record(TELEMETRY_SERVE, GetSpeed(state), direction, TELEMETRY_NO_WINNER);
+}
+
+void MatchTelemetry::Step(const SimState& state, unsigned events)
+{
+	++tick_;
+	if (events & SIM_EVENT_BAT_HIT)
+	{
+		// The ball has been sent back towards the other end.
+		Record(TELEMETRY_BAT_HIT, GetSpeed(state), state.rallyLength_,
+			state.ballVelocityX_ > 0.0f ? PLAYER_ONE : PLAYER_TWO);
+	}
+	if (events & SIM_EVENT_WALL_HIT)
+	{
+		Record(TELEMETRY_WALL_HIT, GetSpeed(state), state.rallyLength_, TELEMETRY_NO_WINNER);
+	}
+	if (events & SIM_EVENT_GAME_END)
+	{
+		Record(TELEMETRY_MATCH_END, state.matchTime_, state.rallyLength_, (unsigned char)state.winner_);
+	}
+}
+
+void MatchTelemetry::Abandon(const SimState& state)
+{
+	Record(TELEMETRY_MATCH_END, state.matchTime_, state.rallyLength_, TELEMETRY_NO_WINNER);
+}
+
+void MatchTelemetry::Record(TelemetryRecordType type, float value, unsigned count, unsigned char player)
+{
+	TelemetryRecord record;
+	record.match_ = match_;
+	record.tick_ = tick_;
+	record.value_ = value;
+	record.count_ = (unsigned short)(count < 0xffff ? count : 0xffff);
+	record.type_ = (unsigned char)type;
+	record.player_ = player;
+	writer_.Record(record);
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#ifndef PONG_TELEMETRY_H
+#define PONG_TELEMETRY_H
+
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <thread>
+
+#include "PongSim.h"
+
+enum TelemetryRecordType
+{
+	// value_ is the serve speed, count_ the serve direction from 0 to 3.
+	TELEMETRY_SERVE = 0,
+	// value_ is the ball's speed off the bat, count_ the rally length so far
+	// and player_ the SimPlayer who hit it.
+	TELEMETRY_BAT_HIT,
+	// value_ is the ball's speed off the wall.
+	TELEMETRY_WALL_HIT,
+	// value_ is the match time in seconds, count_ the rally length and
+	// player_ the winner, or TELEMETRY_NO_WINNER if it was given up on.
+	TELEMETRY_MATCH_END
+};
+
+const unsigned char TELEMETRY_NO_WINNER = 0xff;
+
+/// One thing that happened in a match. A match is a single rally, so the
+/// rally's records are the match's.
+struct TelemetryRecord
+{
+	unsigned match_;
+	unsigned tick_;
+	float value_;
+	unsigned short count_;
+	unsigned char type_;
+	unsigned char player_;
+};
+
+/// Records from one producer thread to one consumer thread, without locks.
+/// The storage is allocated up front; pushing into a full ring fails rather
+/// than waiting or growing.
+class TelemetryRing
+{
+public:
+
+	/// The capacity is rounded up to a power of two.
+	explicit TelemetryRing(unsigned capacity);
+
+	bool Push(const TelemetryRecord& record);
+	/// Take up to maxCount of the oldest records. Returns how many.
+	unsigned Pop(TelemetryRecord* records, unsigned maxCount);
+
+private:
+
+	// Each index is only written by one side. Padded apart, so that the
+	// producer and consumer do not share a cache line.
+	struct Index
+	{
+		std::atomic<unsigned> value_;
+		char padding_[64 - sizeof(std::atomic<unsigned>)];
+	};
+
+	unsigned mask_;
+	std::unique_ptr<TelemetryRecord[]> records_;
+	Index head_;
+	Index tail_;
+};
+
+struct TelemetryStats
+{
+	TelemetryStats();
+
+	unsigned recorded_;
+	// Records lost because the writer had fallen a whole ring behind.
+	unsigned dropped_;
+	unsigned written_;
+	unsigned long long bytes_;
+};
+
+/// Writes records to a binary file on a background thread. Record() only
+/// ever copies into the ring, so the game thread never waits on the disk or
+/// allocates; records that do not fit are counted and dropped.
+///
+/// The file is a header of four little endian 32-bit words, the magic
+/// "PTL1", the format version, the size of a record and the number of
+/// records dropped, followed by the records. Each record is 16 bytes: the
+/// match and tick as 32-bit words, the value as a 32-bit float, the count
+/// as 16 bits, then the type and player bytes.
+class TelemetryWriter
+{
+public:
+
+	TelemetryWriter();
+	~TelemetryWriter();
+
+	/// Create the file and start the writer thread. Returns false if the file
+	/// cannot be created.
+	bool Open(const char* fileName, unsigned capacity = DEFAULT_CAPACITY);
+	/// Write out everything recorded, fill in the dropped count and close
+	/// the file.
+	void Close();
+	bool IsOpen() const { return file_ != 0; }
+	void Record(const TelemetryRecord& record);
+
+	/// Written counts are only complete once closed.
+	const TelemetryStats& GetStats() const { return stats_; }
+
+	static const unsigned DEFAULT_CAPACITY = 16384;
+
+private:
+
+	FILE* file_;
+	std::unique_ptr<TelemetryRing> ring_;
+	std::thread thread_;
+	std::atomic<bool> closing_;
+	TelemetryStats stats_;
+
+	void WriteRecords();
+};
+
+/// Turns the states and events of one match after another into records.
+/// Call Serve() after starting a game and Step() after every step.
+class MatchTelemetry
+{
+public:
+
+	explicit MatchTelemetry(TelemetryWriter& writer);
+
+	void Serve(const SimState& state);
+	/// Only the last bounce of each kind in a step is recorded.
+	void Step(const SimState& state, unsigned events);
+	/// End a match that was given up on before anyone won.
+	void Abandon(const SimState& state);
+
+private:
+
+	TelemetryWriter& writer_;
+	unsigned match_;
+	unsigned tick_;
+
+	void Record(TelemetryRecordType type, float value, unsigned count, unsigned char player);
+};
+
+#endif
@@ -0,0 +1,236 @@
+#include <cstdio>
+#include <cstring>
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+typedef int socklen_t;
+typedef SOCKET SocketHandle;
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+typedef int SocketHandle;
+#endif
+
+#include "UdpSocket.h"
+
+const long long NO_SOCKET = -1;
+
+#ifdef __linux__
+// Packets handed to the kernel in one sendmmsg call.
+const unsigned SEND_BATCH = 64;
+#endif
+
+static void GetAddress(UdpEndpoint endpoint, sockaddr_in& address)
+{
+	memset(&address, 0, sizeof address);
+	address.sin_family = AF_INET;
+	address.sin_addr.s_addr = htonl((unsigned)(endpoint >> 16));
+	address.sin_port = htons((unsigned short)endpoint);
+}
+
+UdpSocket::UdpSocket() :
+	socket_(NO_SOCKET)
+{
+}
+
+UdpSocket::~UdpSocket()
+{
+	Close();
+}
+
+bool UdpSocket::Open(unsigned short port, unsigned bufferSize)
+{
+	Close();
+
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data))
+	{
+		return false;
+	}
+#endif
+
+	socket_ = (long long)socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+	if (socket_ == NO_SOCKET)
+	{
+		return false;
+	}
+
+	sockaddr_in local;
+	memset(&local, 0, sizeof local);
+	local.sin_family = AF_INET;
+	local.sin_addr.s_addr = htonl(INADDR_ANY);
+	local.sin_port = htons(port);
+	if (bind((SocketHandle)socket_, (sockaddr*)&local, sizeof local))
+	{
+		Close();
+		return false;
+	}
+
+	if (bufferSize)
+	{
+		int size = (int)bufferSize;
+		setsockopt((SocketHandle)socket_, SOL_SOCKET, SO_RCVBUF, (const char*)&size, sizeof size);
+		setsockopt((SocketHandle)socket_, SOL_SOCKET, SO_SNDBUF, (const char*)&size, sizeof size);
+	}
+
+#ifdef _WIN32
+	u_long nonBlocking = 1;
+	ioctlsocket((SocketHandle)socket_, FIONBIO, &nonBlocking);
+#else
+	fcntl((SocketHandle)socket_, F_SETFL, fcntl((SocketHandle)socket_, F_GETFL, 0) | O_NONBLOCK);
+#endif
+
+	return true;
+}
+
+void UdpSocket::Close()
+{
+	if (socket_ == NO_SOCKET)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	closesocket((SocketHandle)socket_);
+	WSACleanup();
+#else
+	close((SocketHandle)socket_);
+#endif
+	socket_ = NO_SOCKET;
+}
+
+bool UdpSocket::IsOpen() const
+{
+	return socket_ != NO_SOCKET;
+}
+
+unsigned UdpSocket::Receive(void* buffer, unsigned size, UdpEndpoint& from)
+{
+	if (socket_ == NO_SOCKET)
+	{
+		return 0;
+	}
+
+	sockaddr_in address;
+	socklen_t addressSize = sizeof address;
+	int received = (int)recvfrom((SocketHandle)socket_, (char*)buffer, (int)size, 0, (sockaddr*)&address, &addressSize);
+	if (received <= 0 || address.sin_family != AF_INET)
+	{
+		return 0;
+	}
+
+	from = (UdpEndpoint)ntohl(address.sin_addr.s_addr) << 16 | ntohs(address.sin_port);
+	return (unsigned)received;
+}
+
+void UdpSocket::Send(const void* data, unsigned size, UdpEndpoint to)
+{
+	if (socket_ == NO_SOCKET)
+	{
+		return;
+	}
+
+	sockaddr_in address;
+	GetAddress(to, address);
+	sendto((SocketHandle)socket_, (const char*)data, (int)size, 0, (const sockaddr*)&address, sizeof address);
+}
+
+void UdpSocket::Send(const void* data, unsigned size, const UdpEndpoint* to, unsigned count)
+{
+	if (socket_ == NO_SOCKET)
+	{
+		return;
+	}
+
+#ifdef __linux__
+	iovec packet;
+	packet.iov_base = const_cast<void*>(data);
+	packet.iov_len = size;
+	sockaddr_in addresses[SEND_BATCH];
+	mmsghdr messages[SEND_BATCH];
+	memset(messages, 0, sizeof messages);
+
+	for (unsigned first = 0; first < count; first += SEND_BATCH)
+	{
+		unsigned batch = count - first < SEND_BATCH ? count - first : SEND_BATCH;
+		for (unsigned i = 0; i < batch; ++i)
+		{
+			GetAddress(to[first + i], addresses[i]);
+			messages[i].msg_hdr.msg_name = &addresses[i];
+			messages[i].msg_hdr.msg_namelen = sizeof addresses[i];
+			messages[i].msg_hdr.msg_iov = &packet;
+			messages[i].msg_hdr.msg_iovlen = 1;
+		}
+		// A full send buffer drops the rest of the batch, as it would drop
+		// single packets.
+		sendmmsg((SocketHandle)socket_, messages, batch, 0);
+	}
+#else
+	for (unsigned i = 0; i < count; ++i)
+	{
+		Send(data, size, to[i]);
+	}
+#endif
+}
+
+void UdpSocket::Wait(unsigned timeout)
+{
+	if (socket_ == NO_SOCKET)
+	{
+		return;
+	}
+
+	fd_set readable;
+	FD_ZERO(&readable);
+	FD_SET((SocketHandle)socket_, &readable);
+	timeval wait;
+	wait.tv_sec = timeout / 1000;
+	wait.tv_usec = (timeout % 1000) * 1000;
+	select((int)socket_ + 1, &readable, 0, 0, &wait);
+}
+
+bool UdpSocket::Resolve(const char* host, unsigned short port, UdpEndpoint& endpoint)
+{
+#ifdef _WIN32
+	WSADATA data;
+	if (WSAStartup(MAKEWORD(2, 2), &data))
+	{
+		return false;
+	}
+#endif
+
+	addrinfo hints;
+	memset(&hints, 0, sizeof hints);
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	addrinfo* found = 0;
+	bool resolved = !getaddrinfo(host, 0, &hints, &found) && found;
+	if (resolved)
+	{
+		const sockaddr_in* address = (const sockaddr_in*)found->ai_addr;
+		endpoint = (UdpEndpoint)ntohl(address->sin_addr.s_addr) << 16 | port;
+	}
+	if (found)
+	{
+		freeaddrinfo(found);
+	}
+
+#ifdef _WIN32
+	WSACleanup();
+#endif
+	return resolved;
+}
+
+void UdpSocket::FormatEndpoint(UdpEndpoint endpoint, char* buffer, unsigned size)
+{
+	unsigned host = (unsigned)(endpoint >> 16);
+	snprintf(buffer, size, "%u.%u.%u.%u:%u", host >> 24, (host >> 16) & 0xff, (host >> 8) & 0xff, host & 0xff,
+		(unsigned)(endpoint & 0xffff));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#ifndef PONG_UDP_SOCKET_H
+#define PONG_UDP_SOCKET_H
+
+/// IPv4 address and port, packed into one value that can be compared and
+/// used as a key.
+typedef unsigned long long UdpEndpoint;
+
+/// A non-blocking UDP socket that receives from and sends to any number of
+/// endpoints, for servers and for anything talking to many of them.
+class UdpSocket
+{
+public:
+
+	UdpSocket();
+	~UdpSocket();
+
+	/// Bind the port on every interface, or any free port for 0, with the
+	/// system's buffer sizes unless given. Returns false on failure.
+	bool Open(unsigned short port, unsigned bufferSize = 0);
+	void Close();
+	bool IsOpen() const;
+
+	/// Returns the size of the next waiting packet and who sent it, or 0 if
+	/// there is none.
+	unsigned Receive(void* buffer, unsigned size, UdpEndpoint& from);
+	void Send(const void* data, unsigned size, UdpEndpoint to);
+	/// Send the same packet to every endpoint, in as few system calls as the
+	/// platform allows.
+	void Send(const void* data, unsigned size, const UdpEndpoint* to, unsigned count);
+	/// Wait until a packet arrives or the timeout in milliseconds passes.
+	void Wait(unsigned timeout);
+
+	/// Look up an IPv4 host name or address.
+	static bool Resolve(const char* host, unsigned short port, UdpEndpoint& endpoint);
+	/// "a.b.c.d:port", for reports.
+	static void FormatEndpoint(UdpEndpoint endpoint, char* buffer, unsigned size);
+
+private:
+
+	// A socket handle on every platform fits in this.
+	long long socket_;
+};
+
+#endif
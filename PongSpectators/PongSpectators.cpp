@@ -0,0 +1,412 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+#include "PongSim/InterceptAi.h"
+#include "PongSpectators.h"
+
+// Seconds between a spectator's subscriptions, as Pong sends them.
+const double SUBSCRIBE_INTERVAL = 1.0;
+
+// Seconds between passes over every spectator's socket.
+const double POLL_INTERVAL = 0.002;
+
+// Weight of each new gap between packets in a spectator's smoothed interval.
+const double INTERVAL_SMOOTHING = 0.1;
+
+typedef std::chrono::steady_clock Clock;
+
+// Shared by the hosted sender and the spectators, so that their send and
+// arrival times can be compared.
+static const Clock::time_point startTime = Clock::now();
+
+static double GetTime()
+{
+	return std::chrono::duration<double>(Clock::now() - startTime).count();
+}
+
+SpectatorOptions::SpectatorOptions() :
+	viewers_(1000),
+	target_("127.0.0.1"),
+	host_(false),
+	port_(DEFAULT_SPECTATOR_PORT),
+	tickRate_(60.0f),
+	duration_(10.0f),
+	reportInterval_(1.0f)
+{
+}
+
+ViewerTotals::ViewerTotals() :
+	receiving_(0),
+	received_(0),
+	lost_(0),
+	undecodable_(0),
+	missingKeyframes_(0),
+	bytes_(0),
+	delays_(0),
+	delay_(0.0),
+	maxDelay_(0.0)
+{
+}
+
+PongSpectators::Viewer::Viewer() :
+	lastSequence_(0),
+	nextSubscribe_(0.0),
+	latestArrival_(0.0),
+	interval_(0.0),
+	received_(0),
+	lost_(0),
+	undecodable_(0),
+	bytes_(0),
+	delays_(0),
+	delay_(0.0),
+	maxDelay_(0.0)
+{
+}
+
+PongSpectators::PongSpectators(const SpectatorOptions& options) :
+	options_(options),
+	viewers_(new Viewer[options.viewers_]),
+	target_(0),
+	drawn_(0.0f),
+	quit_(false),
+	hostSubscribers_(0),
+	publishTime_(0.0),
+	maxPublishTime_(0.0)
+{
+}
+
+PongSpectators::~PongSpectators()
+{
+	quit_ = true;
+	if (hostThread_.joinable())
+	{
+		hostThread_.join();
+	}
+}
+
+bool PongSpectators::Start()
+{
+	std::string host = options_.target_;
+	unsigned short port = options_.port_;
+	size_t colon = host.find(':');
+	if (colon != std::string::npos)
+	{
+		port = (unsigned short)strtoul(host.c_str() + colon + 1, 0, 10);
+		host.resize(colon);
+	}
+	if (options_.host_)
+	{
+		host = "127.0.0.1";
+		port = options_.port_;
+		if (!broadcast_.Open(port, options_.viewers_))
+		{
+			fprintf(stderr, "Could not open port %u to broadcast on\n", port);
+			return false;
+		}
+		hostThread_ = std::thread(&PongSpectators::HostMatch, this);
+	}
+	if (!UdpSocket::Resolve(host.c_str(), port, target_))
+	{
+		fprintf(stderr, "Could not resolve %s\n", host.c_str());
+		return false;
+	}
+
+	// Spread the subscriptions over the interval rather than sending them
+	// all at once.
+	for (unsigned i = 0; i < options_.viewers_; ++i)
+	{
+		Viewer& viewer = viewers_[i];
+		if (!viewer.socket_.Open(0))
+		{
+			fprintf(stderr, "Could only open %u sockets; raise the open file limit\n", i);
+			return false;
+		}
+		viewer.nextSubscribe_ = SUBSCRIBE_INTERVAL * i / options_.viewers_;
+		viewer.interval_ = 1.0 / options_.tickRate_;
+	}
+
+	char address[32];
+	UdpSocket::FormatEndpoint(target_, address, sizeof address);
+	printf("%u spectators watching %s%s\n", options_.viewers_, address, options_.host_ ? ", hosted here" : "");
+	return true;
+}
+
+void PongSpectators::Run()
+{
+	ViewerTotals lastTotals;
+	double lastReport = GetTime();
+	double end = lastReport + options_.duration_;
+
+	for (double now = lastReport; now < end; now = GetTime())
+	{
+		for (unsigned i = 0; i < options_.viewers_; ++i)
+		{
+			PollViewer(viewers_[i], now);
+		}
+
+		if (options_.reportInterval_ > 0.0f && now - lastReport >= options_.reportInterval_)
+		{
+			ViewerTotals totals = GetTotals();
+			PrintStatus(now, lastTotals, lastReport);
+			lastTotals = totals;
+			lastReport = now;
+		}
+
+		std::this_thread::sleep_for(std::chrono::duration<double>(POLL_INTERVAL));
+	}
+
+	quit_ = true;
+}
+
+void PongSpectators::Report() const
+{
+	ViewerTotals totals = GetTotals();
+	unsigned long long expected = totals.received_ + totals.lost_;
+	printf("%u of %u spectators received the stream\n", totals.receiving_, options_.viewers_);
+	printf("%llu packets received, %.1f bytes each, %.3f%% lost, %llu undecodable, %llu waiting for a keyframe\n",
+		totals.received_, totals.bytes_ / (double)std::max(totals.received_, 1ULL),
+		100.0 * totals.lost_ / (double)std::max(expected, 1ULL), totals.undecodable_, totals.missingKeyframes_);
+	if (totals.delays_)
+	{
+		printf("Delivered in %.3f ms on average, %.3f ms at most\n", totals.delay_ * 1000.0 / totals.delays_,
+			totals.maxDelay_ * 1000.0);
+	}
+
+	if (options_.host_)
+	{
+		std::lock_guard<std::mutex> lock(hostMutex_);
+		double packets = (double)std::max(hostStats_.packets_, 1U);
+		printf("Sent %u packets (%u keyframes) to up to %u subscribers, %llu sends, %.1f bytes per send\n", hostStats_.packets_,
+			hostStats_.keyframes_, hostStats_.maxSubscribers_, hostStats_.sends_,
+			hostStats_.bytes_ / (double)std::max(hostStats_.sends_, 1ULL));
+		printf("Publishing took %.1f us per packet on average (%.3f us per subscriber), %.1f us at most\n",
+			publishTime_ * 1e6 / packets, publishTime_ * 1e6 / (double)std::max(hostStats_.sends_, 1ULL),
+			maxPublishTime_ * 1e6);
+	}
+}
+
+/// Play an AI match at the tick rate, publishing every tick, as a Pong
+/// instance would.
+void PongSpectators::HostMatch()
+{
+	PongSim sim;
+	InterceptAi players[NUM_PLAYERS] = { InterceptAi(PLAYER_ONE), InterceptAi(PLAYER_TWO, AiParams(), 2) };
+	float timeStep = 1.0f / options_.tickRate_;
+	Clock::time_point nextTick = Clock::now();
+
+	while (!quit_)
+	{
+		unsigned now = (unsigned)(GetTime() * 1000.0);
+		broadcast_.Update(now);
+
+		if (!sim.GetState().gameRunning_)
+		{
+			sim.StartGame();
+		}
+		SimInput input;
+		for (int i = 0; i < NUM_PLAYERS; ++i)
+		{
+			input.batDirection_[i] = players[i].Update(sim, timeStep);
+		}
+		unsigned events = sim.Step(timeStep, input);
+		SpectatorState state;
+		state.FromSimState(sim.GetState(), events);
+
+		Clock::time_point start = Clock::now();
+		broadcast_.Publish(state, now);
+		double publishTime = std::chrono::duration<double>(Clock::now() - start).count();
+
+		{
+			std::lock_guard<std::mutex> lock(hostMutex_);
+			hostStats_ = broadcast_.GetStats();
+			hostSubscribers_ = broadcast_.GetNumSubscribers();
+			publishTime_ += publishTime;
+			maxPublishTime_ = std::max(maxPublishTime_, publishTime);
+		}
+
+		nextTick += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(timeStep));
+		std::this_thread::sleep_until(nextTick);
+	}
+}
+
+/// Renew the subscription when due, decode whatever has arrived, and blend
+/// the last two states for this moment as Pong would draw them.
+void PongSpectators::PollViewer(Viewer& viewer, double now)
+{
+	unsigned char packet[SPECTATOR_MAX_PACKET_SIZE];
+	if (now >= viewer.nextSubscribe_)
+	{
+		viewer.socket_.Send(packet, WriteSpectatorSubscribe(packet), target_);
+		viewer.nextSubscribe_ += SUBSCRIBE_INTERVAL;
+	}
+
+	UdpEndpoint from;
+	unsigned size;
+	while ((size = viewer.socket_.Receive(packet, sizeof packet, from)) > 0)
+	{
+		SpectatorState state;
+		unsigned sequence;
+		unsigned sendTime;
+		unsigned missingKeyframes = viewer.reader_.GetMissingKeyframes();
+		if (!viewer.reader_.Read(packet, size, state, sequence, sendTime))
+		{
+			viewer.undecodable_ += viewer.reader_.GetMissingKeyframes() == missingKeyframes ? 1 : 0;
+			continue;
+		}
+
+		viewer.bytes_ += size;
+		++viewer.received_;
+		if (viewer.lastSequence_ && (int)(sequence - viewer.lastSequence_) <= 0)
+		{
+			continue;
+		}
+		if (viewer.lastSequence_)
+		{
+			viewer.lost_ += sequence - viewer.lastSequence_ - 1;
+			viewer.interval_ += (now - viewer.latestArrival_ - viewer.interval_) * INTERVAL_SMOOTHING;
+		}
+		viewer.lastSequence_ = sequence;
+		viewer.previous_ = viewer.latest_;
+		viewer.latest_ = state;
+		viewer.latestArrival_ = now;
+
+		// Send times are only comparable to ours when sent from here.
+		if (options_.host_)
+		{
+			double delay = std::max(now - sendTime / 1000.0, 0.0);
+			viewer.delay_ += delay;
+			viewer.maxDelay_ = std::max(viewer.maxDelay_, delay);
+			++viewer.delays_;
+		}
+	}
+
+	if (viewer.lastSequence_)
+	{
+		float t = (float)std::min((now - viewer.latestArrival_) / std::max(viewer.interval_, 1e-6), 1.0);
+		SpectatorState drawn;
+		InterpolateSpectatorState(viewer.previous_, viewer.latest_, t, drawn);
+		drawn_ += drawn.ballX_ + drawn.batY_[PLAYER_ONE];
+	}
+}
+
+ViewerTotals PongSpectators::GetTotals() const
+{
+	ViewerTotals totals;
+	for (unsigned i = 0; i < options_.viewers_; ++i)
+	{
+		const Viewer& viewer = viewers_[i];
+		totals.receiving_ += viewer.received_ ? 1 : 0;
+		totals.received_ += viewer.received_;
+		totals.lost_ += viewer.lost_;
+		totals.undecodable_ += viewer.undecodable_;
+		totals.missingKeyframes_ += viewer.reader_.GetMissingKeyframes();
+		totals.bytes_ += viewer.bytes_;
+		totals.delays_ += viewer.delays_;
+		totals.delay_ += viewer.delay_;
+		totals.maxDelay_ = std::max(totals.maxDelay_, viewer.maxDelay_);
+	}
+	return totals;
+}
+
+void PongSpectators::PrintStatus(double now, const ViewerTotals& last, double lastTime) const
+{
+	ViewerTotals totals = GetTotals();
+	double elapsed = std::max(now - lastTime, 1e-9);
+	unsigned long long received = totals.received_ - last.received_;
+	unsigned long long lost = totals.lost_ - last.lost_;
+	printf("%.0f s: %u receiving, %.1f packets/s each, %.1f bytes/packet, %.3f%% lost", now, totals.receiving_,
+		received / elapsed / std::max(totals.receiving_, 1U), (totals.bytes_ - last.bytes_) / (double)std::max(received, 1ULL),
+		100.0 * lost / (double)std::max(received + lost, 1ULL));
+	if (totals.delays_ > last.delays_)
+	{
+		printf(", %.3f ms delivery", (totals.delay_ - last.delay_) * 1000.0 / (totals.delays_ - last.delays_));
+	}
+	if (options_.host_)
+	{
+		std::lock_guard<std::mutex> lock(hostMutex_);
+		printf(", %u subscribed", hostSubscribers_);
+	}
+	printf("\n");
+}
+
+static void PrintUsage()
+{
+	printf("Usage: PongSpectators [options]\n"
+		"  -viewers N       spectators to simulate\n"
+		"  -target HOST[:PORT]  the Pong instance started with -broadcast\n"
+		"  -host            broadcast an AI match from this process instead\n"
+		"  -port N          port of the hosted broadcast\n"
+		"  -tickrate HZ     ticks per second of the hosted match\n"
+		"  -duration S      seconds to watch for\n"
+		"  -report S        seconds between status lines, 0 for none\n");
+}
+
+int main(int argc, char** argv)
+{
+	SpectatorOptions options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* argument = argv[i];
+		bool hasValue = i + 1 < argc;
+
+		if (!strcmp(argument, "-viewers") && hasValue)
+		{
+			options.viewers_ = std::max((unsigned)strtoul(argv[++i], 0, 10), 1U);
+		}
+		else if (!strcmp(argument, "-target") && hasValue)
+		{
+			options.target_ = argv[++i];
+		}
+		else if (!strcmp(argument, "-host"))
+		{
+			options.host_ = true;
+		}
+		else if (!strcmp(argument, "-port") && hasValue)
+		{
+			options.port_ = (unsigned short)strtoul(argv[++i], 0, 10);
+		}
+		else if (!strcmp(argument, "-tickrate") && hasValue)
+		{
+			options.tickRate_ = std::max((float)atof(argv[++i]), 1.0f);
+		}
+		else if (!strcmp(argument, "-duration") && hasValue)
+		{
+			options.duration_ = std::max((float)atof(argv[++i]), 0.0f);
+		}
+		else if (!strcmp(argument, "-report") && hasValue)
+		{
+			options.reportInterval_ = std::max((float)atof(argv[++i]), 0.0f);
+		}
+		else
+		{
+			PrintUsage();
+			return EXIT_FAILURE;
+		}
+	}
+
+#ifndef _WIN32
+	// A socket per spectator soon passes the default open file limit.
+	rlimit files;
+	if (!getrlimit(RLIMIT_NOFILE, &files))
+	{
+		files.rlim_cur = files.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &files);
+	}
+#endif
+
+	PongSpectators spectators(options);
+	if (!spectators.Start())
+	{
+		return EXIT_FAILURE;
+	}
+	spectators.Run();
+	spectators.Report();
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#ifndef PONG_SPECTATORS_H
+#define PONG_SPECTATORS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "PongSim/SpectatorBroadcast.h"
+
+struct SpectatorOptions
+{
+	SpectatorOptions();
+
+	unsigned viewers_;
+	// HOST[:PORT] of the broadcasting Pong instance.
+	std::string target_;
+	// Broadcast an AI match from a thread of this process instead, on port_,
+	// so that the sender's cost is measured too.
+	bool host_;
+	unsigned short port_;
+	float tickRate_;
+	float duration_;
+	float reportInterval_;
+};
+
+struct ViewerTotals
+{
+	ViewerTotals();
+
+	unsigned receiving_;
+	unsigned long long received_;
+	unsigned long long lost_;
+	unsigned long long undecodable_;
+	unsigned long long missingKeyframes_;
+	unsigned long long bytes_;
+	unsigned long long delays_;
+	double delay_;
+	double maxDelay_;
+};
+
+/// Load generator for SpectatorBroadcast. Every simulated spectator has its
+/// own socket, subscribes as Pong does, decodes the stream and interpolates
+/// between the last two states as if drawing, all on one thread that polls
+/// the sockets in turn.
+class PongSpectators
+{
+public:
+
+	explicit PongSpectators(const SpectatorOptions& options);
+	~PongSpectators();
+
+	bool Start();
+	void Run();
+	void Report() const;
+
+private:
+
+	struct Viewer
+	{
+		Viewer();
+
+		UdpSocket socket_;
+		StateStreamReader reader_;
+		SpectatorState previous_;
+		SpectatorState latest_;
+		unsigned lastSequence_;
+		double nextSubscribe_;
+		double latestArrival_;
+		// Smoothed time between packets, over which states are blended.
+		double interval_;
+		unsigned long long received_;
+		unsigned long long lost_;
+		unsigned long long undecodable_;
+		unsigned long long bytes_;
+		unsigned long long delays_;
+		double delay_;
+		double maxDelay_;
+	};
+
+	SpectatorOptions options_;
+	std::unique_ptr<Viewer[]> viewers_;
+	UdpEndpoint target_;
+	// Positions drawn, summed so that drawing is not optimised away.
+	volatile float drawn_;
+
+	// The hosted match, if any, and its sender's timings.
+	SpectatorBroadcast broadcast_;
+	std::thread hostThread_;
+	std::atomic<bool> quit_;
+	mutable std::mutex hostMutex_;
+	BroadcastStats hostStats_;
+	unsigned hostSubscribers_;
+	double publishTime_;
+	double maxPublishTime_;
+
+	void HostMatch();
+	void PollViewer(Viewer& viewer, double now);
+	ViewerTotals GetTotals() const;
+	void PrintStatus(double now, const ViewerTotals& last, double lastTime) const;
+};
+
+#endif
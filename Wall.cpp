@@ -1,12 +1,8 @@
-#include <Urho3D/Graphics/AnimatedModel.h>
 #include <Urho3D/IO/Log.h>
-#include <Urho3D/Urho2D/PhysicsWorld2D.h>
-#include <Urho3D/Urho2D/PhysicsEvents2D.h>
 #include <Urho3D/Resource/ResourceCache.h>
 #include <Urho3D/Scene/Component.h>
-#include <Urho3D/Urho2D/CollisionBox2D.h>
-#include <Urho3D/Urho2D/RigidBody2D.h>
 #include <Urho3D/Urho2D/Sprite2D.h>
+#include <Urho3D/Urho2D/SpriteSheet2D.h>
 #include <Urho3D/Urho2D/StaticSprite2D.h>
 
 #include "Wall.h"
@@ -20,11 +16,12 @@ Wall::Wall(Context* context) : Component(context)
 {
 }
 
+/// Scale the node so that the sprite covers the given size in world units.
 void Wall::SetSize(Vector2 dimensions)
 {
 	if (node_)
 	{
-		node_->SetScale2D(dimensions / SPRITE_SIZE_IN_PIXELS);
+		node_->SetScale2D(dimensions / SPRITE_SIZE);
 	}
 }
 
@@ -32,29 +29,14 @@ void Wall::OnNodeSet(Node* node)
 {
 	if (node)
 	{
-		CreateBody();
 		CreateSprite();
-		CreateCollider();
 		node_->AddTag("Wall");
 	}
 }
 
-void Wall::CreateBody()
-{
-	body_ = node_->CreateComponent<RigidBody2D>();
-	body_->SetBodyType(BT_STATIC);
-}
-
-void Wall::CreateCollider()
-{
-	collider_ = node_->CreateComponent<CollisionBox2D>();
-	collider_->SetSize(SPRITE_SIZE, SPRITE_SIZE);
-	collider_->SetDensity(1.0f);
-	collider_->SetFriction(0.0f); // Frictionless
-}
-
 void Wall::CreateSprite()
 {
+	SpriteSheet2D* sheet = GetSubsystem<ResourceCache>()->GetResource<SpriteSheet2D>("Urho2D/Sprites.xml");
 	sprite_ = node_->CreateComponent<StaticSprite2D>();
-	sprite_->SetSprite(GetSubsystem<ResourceCache>()->GetResource<Sprite2D>("Urho2D/Box.png"));
+	sprite_->SetSprite(sheet->GetSprite("Box"));
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 
 using namespace Urho3D;
 
+/// Visual representation of a wall. Collisions with it are resolved by the
+/// simulation.
 class Wall : public Component
 {
 	URHO3D_OBJECT(Wall, Component);
@@ -17,14 +19,10 @@ public:
 protected:
 
 	virtual void OnNodeSet(Node* node);
-	SharedPtr<RigidBody2D> body_;
-	SharedPtr<CollisionBox2D> collider_;
 	SharedPtr<StaticSprite2D> sprite_;
 
 private:
 
-	void CreateBody();
-	void CreateCollider();
 	void CreateSprite();
 };
 